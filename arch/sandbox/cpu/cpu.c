@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <linux/libfdt.h>
 #include <os.h>
+#include <uthread.h>
 #include <asm/io.h>
 #include <asm/setjmp.h>
 #include <asm/state.h>
@@ -177,3 +178,24 @@ void longjmp(jmp_buf jmp, int ret)
 	while (1)
 		;
 }
+
+#if CONFIG_IS_ENABLED(UTHREAD)
+int arch_uthread_init(struct uthread *uthr, size_t stack_sz,
+		      void (*entry)(void))
+{
+	uthr->ctx = os_context_create(uthr->stack, stack_sz, entry);
+
+	return uthr->ctx ? 0 : -ENOMEM;
+}
+
+void arch_uthread_switch(struct uthread *from, struct uthread *to)
+{
+	os_context_switch(from->ctx, to->ctx);
+}
+
+void arch_uthread_free(struct uthread *uthr)
+{
+	os_context_free(uthr->ctx);
+	uthr->ctx = NULL;
+}
+#endif
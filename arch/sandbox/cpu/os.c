@@ -14,6 +14,7 @@
 #include <string.h>
 #include <termios.h>
 #include <time.h>
+#include <ucontext.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -651,3 +652,35 @@ void os_longjmp(ulong *jmp, int ret)
 {
 	longjmp((struct __jmp_buf_tag *)jmp, ret);
 }
+
+void *os_context_create(void *stack, size_t size, void (*func)(void))
+{
+	ucontext_t *ctx;
+
+	ctx = os_malloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	if (!stack)
+		return ctx;
+
+	if (getcontext(ctx)) {
+		os_free(ctx);
+		return NULL;
+	}
+	ctx->uc_stack.ss_sp = stack;
+	ctx->uc_stack.ss_size = size;
+	ctx->uc_link = NULL;
+	makecontext(ctx, func, 0);
+
+	return ctx;
+}
+
+void os_context_switch(void *from, void *to)
+{
+	swapcontext(from, to);
+}
+
+void os_context_free(void *ctx)
+{
+	os_free(ctx);
+}
@@ -23,11 +23,13 @@
 #include <linux/mtd/mtd.h>
 #include <command.h>
 #include <console.h>
+#include <div64.h>
 #include <watchdog.h>
 #include <malloc.h>
 #include <asm/byteorder.h>
 #include <jffs2/jffs2.h>
 #include <nand.h>
+#include <image-sparse.h>
 
 #if defined(CONFIG_CMD_MTDPARTS)
 
@@ -371,6 +373,83 @@ static void adjust_size_for_badblocks(loff_t *size, loff_t offset, int dev)
 	}
 }
 
+#ifdef CONFIG_CMD_NAND_SPARSE
+static lbaint_t nand_sparse_write(struct sparse_storage *info, lbaint_t blk,
+				  lbaint_t blkcnt, const void *buffer)
+{
+	struct mtd_info *mtd = info->priv;
+	loff_t off = (loff_t)blk * info->blksz;
+	loff_t lim = (loff_t)(info->start + info->size) * info->blksz - off;
+	size_t len = blkcnt * info->blksz;
+	size_t actual;
+
+	if (nand_write_skip_bad(mtd, off, &len, &actual, lim, (u_char *)buffer,
+				WITH_WR_VERIFY))
+		return 0;
+
+	/* Bad blocks skipped on the way count as written */
+	return actual / info->blksz;
+}
+
+static lbaint_t nand_sparse_reserve(struct sparse_storage *info, lbaint_t blk,
+				    lbaint_t blkcnt)
+{
+	struct mtd_info *mtd = info->priv;
+	loff_t off = (loff_t)blk * info->blksz;
+	loff_t end = (loff_t)(info->start + info->size) * info->blksz;
+	loff_t left = (loff_t)blkcnt * info->blksz;
+	loff_t len;
+
+	/*
+	 * Skip blkcnt blocks worth of good eraseblocks, so that the chunks
+	 * which follow land where they would have without the bad ones.
+	 */
+	while (left && off < end) {
+		if (!(off & (mtd->erasesize - 1)) && nand_block_isbad(mtd, off)) {
+			off += mtd->erasesize;
+			continue;
+		}
+		len = mtd->erasesize - (off & (mtd->erasesize - 1));
+		if (len > left)
+			len = left;
+		off += len;
+		left -= len;
+	}
+
+	return lldiv(off, info->blksz) - blk;
+}
+
+static int nand_write_sparse(struct mtd_info *mtd, ulong addr, loff_t off,
+			     loff_t maxsize, const char *name, size_t *rwsize)
+{
+	sparse_header_t *hdr = (sparse_header_t *)addr;
+	struct sparse_storage sparse;
+
+	if (!is_sparse_image(hdr)) {
+		puts("Not a sparse image\n");
+		return -EINVAL;
+	}
+
+	if (off & (mtd->writesize - 1)) {
+		puts("Offset is not page aligned\n");
+		return -EINVAL;
+	}
+
+	sparse.priv = mtd;
+	sparse.blksz = mtd->writesize;
+	sparse.start = lldiv(off, sparse.blksz);
+	sparse.size = lldiv(maxsize, sparse.blksz);
+	sparse.write = nand_sparse_write;
+	sparse.reserve = nand_sparse_reserve;
+	sparse.mssg = NULL;
+
+	*rwsize = (size_t)le32_to_cpu(hdr->total_blks) *
+		  le32_to_cpu(hdr->blk_sz);
+
+	return write_sparse_image(&sparse, name, hdr, NULL);
+}
+#endif
+
 static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	int i, ret = 0;
@@ -625,6 +704,15 @@ static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			ret = nand_write_skip_bad(mtd, off, &rwsize, NULL,
 						maxsize, (u_char *)addr,
 						WITH_DROP_FFS | WITH_WR_VERIFY);
+#endif
+#ifdef CONFIG_CMD_NAND_SPARSE
+		} else if (!strcmp(s, ".sparse")) {
+			if (read) {
+				printf("Unknown nand command suffix '%s'\n", s);
+				return 1;
+			}
+			ret = nand_write_sparse(mtd, addr, off, maxsize,
+						argv[3], &rwsize);
 #endif
 		} else if (!strcmp(s, ".oob")) {
 			/* out-of-band data */
@@ -802,6 +890,12 @@ static char nand_help_text[] =
 	"    write 'size' bytes starting at offset 'off' from memory address\n"
 	"    'addr', skipping bad blocks and dropping any pages at the end\n"
 	"    of eraseblocks that contain only 0xFF\n"
+#endif
+#ifdef CONFIG_CMD_NAND_SPARSE
+	"nand write.sparse - addr off|partition\n"
+	"    write the Android sparse image at memory address 'addr' to the\n"
+	"    erased area at offset 'off', skipping bad blocks and leaving\n"
+	"    \"don't care\" chunks untouched\n"
 #endif
 	"nand erase[.spread] [clean] off size - erase 'size' bytes "
 	"from offset 'off'\n"
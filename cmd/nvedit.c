@@ -607,6 +607,25 @@ int do_env_flags(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 }
 #endif
 
+#if defined(CONFIG_CMD_NVEDIT_INFO)
+/*
+ * Print the state of the environment hash table
+ */
+static int do_env_info(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	printf("Entries:  %u\n", env_htab.filled);
+	printf("Size:     %u slots, %u deleted\n", env_htab.size,
+	       env_htab.deleted);
+	printf("Resizes:  %u\n", env_htab.resizes);
+	printf("Lookups:  %lu\n", env_htab.lookups);
+	printf("Probes:   %lu\n", env_htab.probes);
+	printf("Inserts:  %lu\n", env_htab.inserts);
+
+	return 0;
+}
+#endif
+
 /*
  * Interactively edit an environment variable
  */
@@ -1188,6 +1207,9 @@ static cmd_tbl_t cmd_env_sub[] = {
 #endif
 #if defined(CONFIG_CMD_IMPORTENV)
 	U_BOOT_CMD_MKENT(import, 5, 0, do_env_import, "", ""),
+#endif
+#if defined(CONFIG_CMD_NVEDIT_INFO)
+	U_BOOT_CMD_MKENT(info, 1, 0, do_env_info, "", ""),
 #endif
 	U_BOOT_CMD_MKENT(print, CONFIG_SYS_MAXARGS, 1, do_env_print, "", ""),
 #if defined(CONFIG_CMD_RUN)
@@ -1260,6 +1282,9 @@ static char env_help_text[] =
 #endif
 #if defined(CONFIG_CMD_IMPORTENV)
 	"env import [-d] [-t [-r] | -b | -c] addr [size] [var ...] - import environment\n"
+#endif
+#if defined(CONFIG_CMD_NVEDIT_INFO)
+	"env info - print environment hash table statistics\n"
 #endif
 	"env print [-a | name ...] - print environment\n"
 #if defined(CONFIG_CMD_RUN)
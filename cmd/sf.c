@@ -153,46 +153,58 @@ static int do_spi_flash_probe(int argc, char * const argv[])
 }
 
 /**
- * Write a block of data to SPI flash, first checking if it is different from
- * what is already there.
+ * Check whether a buffer holds only 0xff, i.e. matches erased flash
  *
- * If the data being written is the same, then *skipped is incremented by len.
+ * @param buf		buffer to check
+ * @param len		number of bytes to check
+ * @return true if all bytes are 0xff, else false
+ */
+static bool spi_flash_is_erased(const char *buf, size_t len)
+{
+	while (len--) {
+		if (*buf++ != (char)0xff)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Erase a run of sectors and write the new data into it.
+ *
+ * The erase is issued as a single request so that the flash layer can use
+ * block erases wherever the run covers whole blocks. Pages which are left
+ * 0xff are not programmed, and consecutive pages holding data are written
+ * with a single request.
  *
  * @param flash		flash context pointer
- * @param offset	flash offset to write
- * @param len		number of bytes to write
+ * @param offset	flash offset of the run (sector-aligned)
+ * @param len		length of the run (a multiple of the sector size)
  * @param buf		buffer to write from
- * @param cmp_buf	read buffer to use to compare data
- * @param skipped	Count of skipped data (incremented by this function)
  * @return NULL if OK, else a string containing the stage which failed
  */
-static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
-		size_t len, const char *buf, char *cmp_buf, size_t *skipped)
+static const char *spi_flash_update_run(struct spi_flash *flash, u32 offset,
+		size_t len, const char *buf)
 {
-	char *ptr = (char *)buf;
-
-	debug("offset=%#x, sector_size=%#x, len=%#zx\n",
-	      offset, flash->sector_size, len);
-	/* Read the entire sector so to allow for rewriting */
-	if (spi_flash_read(flash, offset, flash->sector_size, cmp_buf))
-		return "read";
-	/* Compare only what is meaningful (len) */
-	if (memcmp(cmp_buf, buf, len) == 0) {
-		debug("Skip region %x size %zx: no change\n",
-		      offset, len);
-		*skipped += len;
-		return NULL;
-	}
-	/* Erase the entire sector */
-	if (spi_flash_erase(flash, offset, flash->sector_size))
+	size_t start = 0;	/* start of the pending data to write */
+	size_t pos, todo;
+
+	debug("offset=%#x, erase len=%#zx\n", offset, len);
+	if (spi_flash_erase(flash, offset, len))
 		return "erase";
-	/* If it's a partial sector, copy the data into the temp-buffer */
-	if (len != flash->sector_size) {
-		memcpy(cmp_buf, buf, len);
-		ptr = cmp_buf;
+
+	for (pos = 0; pos < len; pos += todo) {
+		todo = min_t(size_t, len - pos, flash->page_size);
+		if (!spi_flash_is_erased(buf + pos, todo))
+			continue;
+		if (pos > start &&
+		    spi_flash_write(flash, offset + start, pos - start,
+				    buf + start))
+			return "write";
+		start = pos + todo;
 	}
-	/* Write one complete sector */
-	if (spi_flash_write(flash, offset, flash->sector_size, ptr))
+	if (len > start &&
+	    spi_flash_write(flash, offset + start, len - start, buf + start))
 		return "write";
 
 	return NULL;
@@ -202,6 +214,9 @@ static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
  * Update an area of SPI flash by erasing and writing any blocks which need
  * to change. Existing blocks with the correct data are left unchanged.
  *
+ * Adjacent sectors which need to change are collected into a run, which is
+ * then erased and written in one go.
+ *
  * @param flash		flash context pointer
  * @param offset	flash offset to write
  * @param len		number of bytes to write
@@ -219,6 +234,10 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	const ulong start_time = get_timer(0);
 	size_t scale = 1;
 	const char *start_buf = buf;
+	const char *run_buf = NULL;	/* start of the pending changed run */
+	u32 run_offset = 0;
+	size_t run_len = 0;
+	bool changed;
 	ulong delta;
 
 	if (end - buf >= 200)
@@ -236,9 +255,46 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 							 start_time));
 				last_update = get_timer(0);
 			}
-			err_oper = spi_flash_update_block(flash, offset, todo,
-					buf, cmp_buf, &skipped);
+			/* Read the entire sector so to allow for rewriting */
+			if (spi_flash_read(flash, offset, flash->sector_size,
+					   cmp_buf)) {
+				err_oper = "read";
+				break;
+			}
+			/* Compare only what is meaningful (todo) */
+			changed = memcmp(cmp_buf, buf, todo) != 0;
+			if (!changed) {
+				debug("Skip region %x size %zx: no change\n",
+				      offset, todo);
+				skipped += todo;
+			} else if (todo == flash->sector_size) {
+				/* Add this sector to the run */
+				if (!run_len) {
+					run_offset = offset;
+					run_buf = buf;
+				}
+				run_len += todo;
+				continue;
+			}
+			if (run_len) {
+				err_oper = spi_flash_update_run(flash,
+						run_offset, run_len, run_buf);
+				run_len = 0;
+			}
+			/*
+			 * A partial sector which has changed is the last one,
+			 * so copy the data into the temp-buffer and rewrite
+			 * it on its own
+			 */
+			if (!err_oper && changed) {
+				memcpy(cmp_buf, buf, todo);
+				err_oper = spi_flash_update_run(flash, offset,
+						flash->sector_size, cmp_buf);
+			}
 		}
+		if (!err_oper && run_len)
+			err_oper = spi_flash_update_run(flash, run_offset,
+							run_len, run_buf);
 	} else {
 		err_oper = "malloc";
 	}
@@ -15,6 +15,7 @@
 #include <os.h>
 #include <serial.h>
 #include <stdio_dev.h>
+#include <uthread.h>
 #include <exports.h>
 #include <environment.h>
 #include <watchdog.h>
@@ -335,6 +336,7 @@ int fgetc(int file)
 			 */
 			 udelay(1);
 #endif
+			uthread_schedule();
 		}
 	}
 
@@ -15,6 +15,7 @@
 #include <fdt_support.h>
 #include <exports.h>
 #include <fdtdec.h>
+#include <malloc.h>
 
 /**
  * fdt_getprop_u32_default_node - Return a node's property or a default
@@ -93,9 +94,365 @@ int fdt_find_and_setprop(void *fdt, const char *node, const char *prop,
 	if ((!create) && (fdt_get_property(fdt, nodeoff, prop, NULL) == NULL))
 		return 0; /* create flag not set; so exit quietly */
 
-	return fdt_setprop(fdt, nodeoff, prop, val, len);
+	return fdt_batch_setprop(fdt, nodeoff, prop, val, len);
 }
 
+#if CONFIG_IS_ENABLED(FDT_FIXUP_BATCH)
+#define ALIGN_TAG(x)	ALIGN(x, FDT_TAGSIZE)
+#define FDT_BATCH_PATH_MAX	256
+
+/**
+ * struct fdt_batch_edit - a property change recorded in a batch
+ *
+ * @offset: Structure block offset of the property to replace or delete, or
+ *	where to add it (just after the node's FDT_BEGIN_NODE tag, as
+ *	fdt_setprop() does)
+ * @old_len: Size of the property being replaced or deleted, including its
+ *	tag, or 0 when adding one
+ * @node: Offset of the node
+ * @name: Name of the property
+ * @nameoff: Offset of @name in the strings block, set on commit
+ * @len: Length of the new value, or -1 to delete the property
+ * @seq: Order in which the edit was recorded
+ * @val: New value
+ */
+struct fdt_batch_edit {
+	int offset;
+	int old_len;
+	int node;
+	char *name;
+	int nameoff;
+	int len;
+	int seq;
+	void *val;
+};
+
+/**
+ * struct fdt_batch - the open batch, if any
+ *
+ * @fdt: Blob the batch is for, or NULL if none is open
+ * @edits: Recorded changes
+ * @count: Number of entries in @edits
+ * @size: Number of entries allocated in @edits
+ * @seq: Sequence number of the next edit
+ */
+static struct fdt_batch {
+	void *fdt;
+	struct fdt_batch_edit *edits;
+	int count;
+	int size;
+	int seq;
+} fdt_batch;
+
+static void fdt_batch_clear(void)
+{
+	int i;
+
+	for (i = 0; i < fdt_batch.count; i++)
+		free(fdt_batch.edits[i].name);
+	fdt_batch.count = 0;
+}
+
+static int fdt_batch_edit_cmp(const void *a, const void *b)
+{
+	const struct fdt_batch_edit *ea = a, *eb = b;
+
+	if (ea->offset != eb->offset)
+		return ea->offset - eb->offset;
+
+	/* Additions come before the first property, which may be replaced */
+	if (!ea->old_len != !eb->old_len)
+		return ea->old_len ? 1 : -1;
+
+	return ea->seq - eb->seq;
+}
+
+/* Find a string in the strings block, returning its offset or -1 */
+static int fdt_batch_find_string(const void *fdt, const char *name)
+{
+	const char *strtab = (const char *)fdt + fdt_off_dt_strings(fdt);
+	int size = fdt_size_dt_strings(fdt);
+	int len = strlen(name) + 1;
+	const char *p;
+
+	for (p = strtab; p + len <= strtab + size; p += strlen(p) + 1) {
+		if (!memcmp(p, name, len))
+			return p - strtab;
+	}
+
+	return -1;
+}
+
+/*
+ * Write out the recorded changes, keeping the batch open. The structure
+ * block is rebuilt in one pass, copying the unchanged runs between edits,
+ * and the strings block is moved once to make room for it. If they do not
+ * fit, the blob is not touched and the changes stay recorded, so that they
+ * are tried again, and reported by fdt_batch_commit() if they still fail.
+ */
+static int fdt_batch_apply(void *fdt)
+{
+	struct fdt_batch_edit *edits = fdt_batch.edits, *ed;
+	int struct_size = fdt_size_dt_struct(fdt);
+	int strings_size = fdt_size_dt_strings(fdt);
+	int new_struct = struct_size, new_strings = strings_size;
+	int i, j, pos;
+	char *src, *buf, *dst;
+
+	if (!fdt_batch.count)
+		return 0;
+
+	qsort(edits, fdt_batch.count, sizeof(*edits), fdt_batch_edit_cmp);
+	for (i = 0; i < fdt_batch.count; i++) {
+		ed = &edits[i];
+		new_struct -= ed->old_len;
+		if (ed->len < 0)
+			continue;
+		new_struct += sizeof(struct fdt_property) + ALIGN_TAG(ed->len);
+		ed->nameoff = fdt_batch_find_string(fdt, ed->name);
+		if (ed->nameoff >= 0)
+			continue;
+
+		/* New names are added once, after the existing strings */
+		for (j = 0; j < i; j++) {
+			if (edits[j].nameoff >= strings_size &&
+			    !strcmp(edits[j].name, ed->name))
+				break;
+		}
+		if (j < i) {
+			ed->nameoff = edits[j].nameoff;
+		} else {
+			ed->nameoff = new_strings;
+			new_strings += strlen(ed->name) + 1;
+		}
+	}
+
+	if (fdt_off_dt_struct(fdt) + new_struct + new_strings >
+	    fdt_totalsize(fdt))
+		return -FDT_ERR_NOSPACE;
+
+	buf = malloc(new_struct);
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+
+	src = (char *)fdt + fdt_off_dt_struct(fdt);
+	dst = buf;
+	for (i = 0, pos = 0; i < fdt_batch.count; i++) {
+		struct fdt_property *prop;
+
+		ed = &edits[i];
+		memcpy(dst, src + pos, ed->offset - pos);
+		dst += ed->offset - pos;
+		pos = ed->offset + ed->old_len;
+		if (ed->len < 0)
+			continue;
+
+		prop = (struct fdt_property *)dst;
+		prop->tag = cpu_to_fdt32(FDT_PROP);
+		prop->len = cpu_to_fdt32(ed->len);
+		prop->nameoff = cpu_to_fdt32(ed->nameoff);
+		memcpy(prop->data, ed->val, ed->len);
+		memset(prop->data + ed->len, '\0',
+		       ALIGN_TAG(ed->len) - ed->len);
+		dst += sizeof(*prop) + ALIGN_TAG(ed->len);
+	}
+	memcpy(dst, src + pos, struct_size - pos);
+
+	/* Move the strings block after the new structure block and extend it */
+	dst = src + new_struct;
+	memmove(dst, (char *)fdt + fdt_off_dt_strings(fdt), strings_size);
+	for (i = 0; i < fdt_batch.count; i++) {
+		ed = &edits[i];
+		if (ed->len >= 0 && ed->nameoff >= strings_size)
+			strcpy(dst + ed->nameoff, ed->name);
+	}
+	memcpy(src, buf, new_struct);
+	free(buf);
+
+	fdt_set_size_dt_struct(fdt, new_struct);
+	fdt_set_off_dt_strings(fdt, fdt_off_dt_struct(fdt) + new_struct);
+	fdt_set_size_dt_strings(fdt, new_strings);
+	fdt_batch_clear();
+
+	return 0;
+}
+
+int fdt_batch_begin(void *fdt)
+{
+	int ret;
+
+	if (fdt_batch.fdt)
+		return -FDT_ERR_BADSTATE;
+
+	/* Put the blocks in the order which fdt_batch_apply() expects */
+	ret = fdt_open_into(fdt, fdt, fdt_totalsize(fdt));
+	if (ret)
+		return ret;
+	fdt_batch.fdt = fdt;
+
+	return 0;
+}
+
+int fdt_batch_commit(void *fdt)
+{
+	int ret;
+
+	if (fdt_batch.fdt != fdt)
+		return 0;
+
+	ret = fdt_batch_apply(fdt);
+	fdt_batch_clear();
+	fdt_batch.fdt = NULL;
+	free(fdt_batch.edits);
+	fdt_batch.edits = NULL;
+	fdt_batch.size = 0;
+	fdt_batch.seq = 0;
+
+	return ret;
+}
+
+/*
+ * Find the recorded edit of a property, or where the property is in the
+ * blob. Returns the edit, or NULL with *offsetp and *lenp set to the
+ * offset and size of the property, or to where it would be added and 0.
+ */
+static struct fdt_batch_edit *fdt_batch_find(void *fdt, int nodeoffset,
+					     const char *name, int *offsetp,
+					     int *lenp)
+{
+	const char *pname;
+	int i, offset, len;
+
+	*lenp = 0;
+	for (i = 0; i < fdt_batch.count; i++) {
+		if (fdt_batch.edits[i].node == nodeoffset &&
+		    !strcmp(fdt_batch.edits[i].name, name))
+			return &fdt_batch.edits[i];
+	}
+
+	fdt_for_each_property_offset(offset, fdt, nodeoffset) {
+		if (!fdt_getprop_by_offset(fdt, offset, &pname, &len))
+			break;
+		if (!strcmp(pname, name)) {
+			*offsetp = offset;
+			*lenp = sizeof(struct fdt_property) + ALIGN_TAG(len);
+			return NULL;
+		}
+	}
+
+	/* New properties go first, just after the node's name */
+	fdt_next_tag(fdt, nodeoffset, offsetp);
+
+	return NULL;
+}
+
+static int fdt_batch_record(void *fdt, int nodeoffset, const char *name,
+			    const void *val, int len)
+{
+	struct fdt_batch_edit *ed;
+	int offset, old_len;
+	char *name_copy;
+
+	if (nodeoffset < 0 || nodeoffset % FDT_TAGSIZE ||
+	    fdt_next_tag(fdt, nodeoffset, &offset) != FDT_BEGIN_NODE)
+		return -FDT_ERR_BADOFFSET;
+
+	ed = fdt_batch_find(fdt, nodeoffset, name, &offset, &old_len);
+	if (len < 0 && (ed ? ed->len < 0 : !old_len))
+		return -FDT_ERR_NOTFOUND;
+	if (ed && len < 0 && !ed->old_len) {
+		/* Deleting a property added in this batch */
+		free(ed->name);
+		*ed = fdt_batch.edits[--fdt_batch.count];
+		return 0;
+	}
+
+	name_copy = malloc(strlen(name) + 1 + max(len, 0));
+	if (!name_copy)
+		return -FDT_ERR_NOSPACE;
+	strcpy(name_copy, name);
+
+	if (!ed) {
+		if (fdt_batch.count == fdt_batch.size) {
+			int size = fdt_batch.size ? fdt_batch.size * 2 : 32;
+
+			ed = realloc(fdt_batch.edits, size * sizeof(*ed));
+			if (!ed) {
+				free(name_copy);
+				return -FDT_ERR_NOSPACE;
+			}
+			fdt_batch.edits = ed;
+			fdt_batch.size = size;
+		}
+		ed = &fdt_batch.edits[fdt_batch.count];
+		ed->offset = offset;
+		ed->old_len = old_len;
+		ed->node = nodeoffset;
+		ed->seq = fdt_batch.seq++;
+		fdt_batch.count++;
+	} else {
+		free(ed->name);
+	}
+	ed->name = name_copy;
+	ed->nameoff = -1;
+	ed->len = len;
+	ed->val = name_copy + strlen(name) + 1;
+	if (len > 0)
+		memcpy(ed->val, val, len);
+
+	return 0;
+}
+
+int fdt_batch_setprop(void *fdt, int nodeoffset, const char *name,
+		      const void *val, int len)
+{
+	char path[FDT_BATCH_PATH_MAX];
+	int ret;
+
+	if (fdt_batch.fdt != fdt)
+		return fdt_setprop(fdt, nodeoffset, name, val, len);
+
+	ret = fdt_batch_record(fdt, nodeoffset, name, val, len);
+	if (ret != -FDT_ERR_NOSPACE)
+		return ret;
+
+	/*
+	 * If memory runs out, write out what there is and carry on. Earlier
+	 * edits may move the node, so look it up again by its path.
+	 */
+	ret = fdt_get_path(fdt, nodeoffset, path, sizeof(path));
+	if (ret)
+		return ret;
+	ret = fdt_batch_apply(fdt);
+	if (ret)
+		return ret;
+	nodeoffset = fdt_path_offset(fdt, path);
+	if (nodeoffset < 0)
+		return nodeoffset;
+
+	return fdt_setprop(fdt, nodeoffset, name, val, len);
+}
+
+int fdt_batch_delprop(void *fdt, int nodeoffset, const char *name)
+{
+	if (fdt_batch.fdt != fdt)
+		return fdt_delprop(fdt, nodeoffset, name);
+
+	return fdt_batch_record(fdt, nodeoffset, name, NULL, -1);
+}
+
+/* Write out a batch before a change which moves nodes */
+static int fdt_batch_flush(void *fdt)
+{
+	return fdt_batch.fdt == fdt ? fdt_batch_apply(fdt) : 0;
+}
+#else
+static int fdt_batch_flush(void *fdt)
+{
+	return 0;
+}
+#endif /* FDT_FIXUP_BATCH */
+
 /**
  * fdt_find_or_add_subnode() - find or possibly add a subnode of a given node
  *
@@ -112,8 +469,12 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 
 	offset = fdt_subnode_offset(fdt, parentoffset, name);
 
-	if (offset == -FDT_ERR_NOTFOUND)
-		offset = fdt_add_subnode(fdt, parentoffset, name);
+	if (offset == -FDT_ERR_NOTFOUND) {
+		/* Node offsets recorded in a batch would move */
+		offset = fdt_batch_flush(fdt);
+		if (!offset)
+			offset = fdt_add_subnode(fdt, parentoffset, name);
+	}
 
 	if (offset < 0)
 		printf("%s: %s: %s\n", __func__, name, fdt_strerror(offset));
@@ -125,8 +486,8 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 #if defined(OF_STDOUT_PATH)
 static int fdt_fixup_stdout(void *fdt, int chosenoff)
 {
-	return fdt_setprop(fdt, chosenoff, "linux,stdout-path",
-			      OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
+	return fdt_batch_setprop(fdt, chosenoff, "linux,stdout-path",
+				 OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
 }
 #elif defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
 static int fdt_fixup_stdout(void *fdt, int chosenoff)
@@ -155,7 +516,7 @@ static int fdt_fixup_stdout(void *fdt, int chosenoff)
 	/* fdt_setprop may break "path" so we copy it to tmp buffer */
 	memcpy(tmp, path, len);
 
-	err = fdt_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
+	err = fdt_batch_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
 	if (err < 0)
 		printf("WARNING: could not set linux,stdout-path %s.\n",
 		       fdt_strerror(err));
@@ -179,9 +540,10 @@ static inline int fdt_setprop_uxx(void *fdt, int nodeoffset, const char *name,
 				  uint64_t val, int is_u64)
 {
 	if (is_u64)
-		return fdt_setprop_u64(fdt, nodeoffset, name, val);
+		return fdt_batch_setprop_u64(fdt, nodeoffset, name, val);
 	else
-		return fdt_setprop_u32(fdt, nodeoffset, name, (uint32_t)val);
+		return fdt_batch_setprop_u32(fdt, nodeoffset, name,
+					     (uint32_t)val);
 }
 
 int fdt_root(void *fdt)
@@ -197,8 +559,8 @@ int fdt_root(void *fdt)
 
 	serial = env_get("serial#");
 	if (serial) {
-		err = fdt_setprop(fdt, 0, "serial-number", serial,
-				  strlen(serial) + 1);
+		err = fdt_batch_setprop(fdt, 0, "serial-number", serial,
+					strlen(serial) + 1);
 
 		if (err < 0) {
 			printf("WARNING: could not set serial-number %s.\n",
@@ -289,8 +651,8 @@ int fdt_chosen(void *fdt)
 
 	str = env_get("bootargs");
 	if (str) {
-		err = fdt_setprop(fdt, nodeoffset, "bootargs", str,
-				  strlen(str) + 1);
+		err = fdt_batch_setprop(fdt, nodeoffset, "bootargs", str,
+					strlen(str) + 1);
 		if (err < 0) {
 			printf("WARNING: could not set bootargs %s.\n",
 			       fdt_strerror(err));
@@ -340,7 +702,7 @@ void do_fixup_by_prop(void *fdt,
 	off = fdt_node_offset_by_prop_value(fdt, -1, pname, pval, plen);
 	while (off != -FDT_ERR_NOTFOUND) {
 		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+			fdt_batch_setprop(fdt, off, prop, val, len);
 		off = fdt_node_offset_by_prop_value(fdt, off, pname, pval, plen);
 	}
 }
@@ -367,7 +729,7 @@ void do_fixup_by_compat(void *fdt, const char *compat,
 	off = fdt_node_offset_by_compatible(fdt, -1, compat);
 	while (off != -FDT_ERR_NOTFOUND) {
 		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+			fdt_batch_setprop(fdt, off, prop, val, len);
 		off = fdt_node_offset_by_compatible(fdt, off, compat);
 	}
 }
@@ -437,8 +799,8 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 	if (nodeoffset < 0)
 			return nodeoffset;
 
-	err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
-			sizeof("memory"));
+	err = fdt_batch_setprop(blob, nodeoffset, "device_type", "memory",
+				sizeof("memory"));
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n", "device_type",
 				fdt_strerror(err));
@@ -463,7 +825,7 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 
 	len = fdt_pack_reg(blob, tmp, start, size, banks);
 
-	err = fdt_setprop(blob, nodeoffset, "reg", tmp, len);
+	err = fdt_batch_setprop(blob, nodeoffset, "reg", tmp, len);
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n",
 				"reg", fdt_strerror(err));
@@ -1410,17 +1772,20 @@ int fdt_set_node_status(void *fdt, int nodeoffset,
 
 	switch (status) {
 	case FDT_STATUS_OKAY:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "okay");
+		ret = fdt_batch_setprop_string(fdt, nodeoffset, "status",
+					       "okay");
 		break;
 	case FDT_STATUS_DISABLED:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "disabled");
+		ret = fdt_batch_setprop_string(fdt, nodeoffset, "status",
+					       "disabled");
 		break;
 	case FDT_STATUS_FAIL:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "fail");
+		ret = fdt_batch_setprop_string(fdt, nodeoffset, "status",
+					       "fail");
 		break;
 	case FDT_STATUS_FAIL_ERROR_CODE:
 		sprintf(buf, "fail-%d", error_code);
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", buf);
+		ret = fdt_batch_setprop_string(fdt, nodeoffset, "status", buf);
 		break;
 	default:
 		printf("Invalid fdt status: %x\n", status);
@@ -1740,7 +2105,7 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto)
 	err = fdt_path_offset(fdt, "/__symbols__");
 	has_symbols = err >= 0;
 
-	err = fdt_overlay_apply(fdt, fdto);
+	err = fdt_overlay_apply_list(fdt, &fdto, 1, NULL);
 	if (err < 0) {
 		printf("failed on fdt_overlay_apply(): %s\n",
 				fdt_strerror(err));
@@ -1751,4 +2116,390 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto)
 	}
 	return err;
 }
+
+/**
+ * struct fdt_overlay_sym - a label from /__symbols__ of the base tree
+ *
+ * @label: Name of the label
+ * @path: Path of the node it refers to
+ * @phandle: Phandle of the node, or 0 if not looked up yet
+ */
+struct fdt_overlay_sym {
+	char *label;
+	char *path;
+	u32 phandle;
+};
+
+/**
+ * struct fdt_overlay_syms - the labels of the base tree, sorted by name
+ *
+ * @syms: Labels
+ * @count: Number of entries in @syms
+ * @size: Number of entries allocated in @syms
+ * @indexed: true if the phandles have been looked up since the last change
+ */
+struct fdt_overlay_syms {
+	struct fdt_overlay_sym *syms;
+	int count;
+	int size;
+	bool indexed;
+};
+
+/* Longest path, and deepest node, which the index handles */
+#define FDT_OVERLAY_PATH_MAX	256
+#define FDT_OVERLAY_DEPTH_MAX	32
+
+static int fdt_overlay_sym_cmp(const void *a, const void *b)
+{
+	const struct fdt_overlay_sym *sa = a, *sb = b;
+
+	return strcmp(sa->label, sb->label);
+}
+
+/* Find a label among the first @count (sorted) entries */
+static struct fdt_overlay_sym *fdt_overlay_sym_find(struct fdt_overlay_syms *st,
+						    int count,
+						    const char *label)
+{
+	int lo = 0, hi = count, mid, cmp;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		cmp = strcmp(label, st->syms[mid].label);
+		if (!cmp)
+			return &st->syms[mid];
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+static int fdt_overlay_sym_set(struct fdt_overlay_sym *sym, const char *label,
+			       const char *path)
+{
+	int len = strlen(label) + 1;
+	char *buf;
+
+	buf = malloc(len + strlen(path) + 1);
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+	strcpy(buf, label);
+	strcpy(buf + len, path);
+	free(sym->label);
+	sym->label = buf;
+	sym->path = buf + len;
+	sym->phandle = 0;
+
+	return 0;
+}
+
+static int fdt_overlay_path_cmp(const void *a, const void *b)
+{
+	const struct fdt_overlay_sym *const *sa = a, *const *sb = b;
+
+	return strcmp((*sa)->path, (*sb)->path);
+}
+
+/*
+ * Look up the phandles of all the labels in one walk over the tree, rather
+ * than following the path of each label from the root, which means a walk
+ * over everything before the node.
+ */
+static int fdt_overlay_syms_index(const void *fdt, struct fdt_overlay_syms *st)
+{
+	int plen[FDT_OVERLAY_DEPTH_MAX + 1];
+	char path[FDT_OVERLAY_PATH_MAX];
+	struct fdt_overlay_sym **by_path;
+	int node, depth, len, lo, hi, mid;
+	const char *name;
+	u32 phandle;
+
+	by_path = malloc(st->count * sizeof(*by_path));
+	if (!by_path)
+		return -FDT_ERR_NOSPACE;
+	for (lo = 0; lo < st->count; lo++)
+		by_path[lo] = &st->syms[lo];
+	qsort(by_path, st->count, sizeof(*by_path), fdt_overlay_path_cmp);
+
+	strcpy(path, "/");
+	plen[0] = 0;
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		if (depth > FDT_OVERLAY_DEPTH_MAX)
+			continue;
+		if (depth) {
+			name = fdt_get_name(fdt, node, &len);
+			plen[depth] = plen[depth - 1] + 1 + len;
+			if (!name || plen[depth] >= FDT_OVERLAY_PATH_MAX) {
+				plen[depth] = FDT_OVERLAY_PATH_MAX;
+				continue;
+			}
+			path[plen[depth - 1]] = '/';
+			memcpy(path + plen[depth - 1] + 1, name, len);
+			path[plen[depth]] = '\0';
+		}
+
+		phandle = fdt_get_phandle(fdt, node);
+		if (!phandle)
+			continue;
+
+		/* Find the first label for this path; there may be several */
+		for (lo = 0, hi = st->count; lo < hi;) {
+			mid = (lo + hi) / 2;
+			if (strcmp(by_path[mid]->path, path) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (; lo < st->count && !strcmp(by_path[lo]->path, path); lo++)
+			by_path[lo]->phandle = phandle;
+	}
+	free(by_path);
+	st->indexed = true;
+
+	return 0;
+}
+
+static void fdt_overlay_syms_free(struct fdt_overlay_syms *st)
+{
+	int i;
+
+	for (i = 0; i < st->count; i++)
+		free(st->syms[i].label);
+	free(st->syms);
+}
+
+/*
+ * Bring @st up to date with /__symbols__ in @fdt. Only the names are
+ * copied: the nodes are looked up when a label is first used, since most
+ * never are.
+ */
+static int fdt_overlay_syms_update(const void *fdt,
+				   struct fdt_overlay_syms *st)
+{
+	int node, prop, len, sorted = st->count;
+	struct fdt_overlay_sym *sym;
+	const char *path, *label;
+	int ret;
+
+	node = fdt_subnode_offset(fdt, 0, "__symbols__");
+	if (node < 0)
+		return node == -FDT_ERR_NOTFOUND ? 0 : node;
+
+	fdt_for_each_property_offset(prop, fdt, node) {
+		path = fdt_getprop_by_offset(fdt, prop, &label, &len);
+		if (!path)
+			return len;
+		if (len < 1 || path[len - 1])
+			return -FDT_ERR_BADVALUE;
+
+		sym = fdt_overlay_sym_find(st, sorted, label);
+		if (sym && !strcmp(sym->path, path))
+			continue;
+		if (!sym) {
+			if (st->count == st->size) {
+				int size = st->size ? st->size * 2 : 32;
+
+				sym = realloc(st->syms, size * sizeof(*sym));
+				if (!sym)
+					return -FDT_ERR_NOSPACE;
+				st->syms = sym;
+				st->size = size;
+			}
+			sym = &st->syms[st->count++];
+			sym->label = NULL;
+		}
+		ret = fdt_overlay_sym_set(sym, label, path);
+		if (ret) {
+			if (!sym->label)
+				st->count--;
+			return ret;
+		}
+	}
+	if (st->count != sorted)
+		qsort(st->syms, st->count, sizeof(*st->syms),
+		      fdt_overlay_sym_cmp);
+
+	return 0;
+}
+
+/*
+ * Resolve the references to the base tree listed in __fixups__ of an
+ * overlay, as fdt_overlay_apply() would, then remove __fixups__ so that it
+ * has nothing left to do.
+ */
+static int fdt_overlay_fixup(const void *fdt, void *fdto,
+			     struct fdt_overlay_syms *st)
+{
+	const char *value, *label, *end, *name, *sep;
+	struct fdt_overlay_sym *sym;
+	int fixups, prop, len, node, ret;
+	fdt32_t phandle;
+	ulong poffset;
+	char *endp;
+
+	fixups = fdt_subnode_offset(fdto, 0, "__fixups__");
+	if (fixups < 0)
+		return fixups == -FDT_ERR_NOTFOUND ? 0 : fixups;
+
+	fdt_for_each_property_offset(prop, fdto, fixups) {
+		value = fdt_getprop_by_offset(fdto, prop, &label, &len);
+		if (!value)
+			return len;
+
+		sym = fdt_overlay_sym_find(st, st->count, label);
+		if (!sym)
+			return -FDT_ERR_NOTFOUND;
+		if (!sym->phandle && !st->indexed) {
+			ret = fdt_overlay_syms_index(fdt, st);
+			if (ret)
+				return ret;
+		}
+		if (!sym->phandle) {
+			node = fdt_path_offset(fdt, sym->path);
+			if (node < 0)
+				return node;
+			sym->phandle = fdt_get_phandle(fdt, node);
+			if (!sym->phandle)
+				return -FDT_ERR_NOTFOUND;
+		}
+		phandle = cpu_to_fdt32(sym->phandle);
+
+		/* Each reference is "path:property:offset" */
+		while (len > 0) {
+			end = memchr(value, '\0', len);
+			if (!end)
+				return -FDT_ERR_BADOVERLAY;
+			name = memchr(value, ':', end - value);
+			if (!name)
+				return -FDT_ERR_BADOVERLAY;
+			name++;
+			sep = memchr(name, ':', end - name);
+			if (!sep || sep == name)
+				return -FDT_ERR_BADOVERLAY;
+			poffset = simple_strtoul(sep + 1, &endp, 10);
+			if (*endp || endp == sep + 1)
+				return -FDT_ERR_BADOVERLAY;
+
+			node = fdt_path_offset_namelen(fdto, value,
+						       name - 1 - value);
+			if (node == -FDT_ERR_NOTFOUND)
+				return -FDT_ERR_BADOVERLAY;
+			if (node < 0)
+				return node;
+			ret = fdt_setprop_inplace_namelen_partial(fdto, node,
+					name, sep - name, poffset, &phandle,
+					sizeof(phandle));
+			if (ret)
+				return ret;
+
+			len -= end - value + 1;
+			value = end + 1;
+		}
+	}
+
+	return fdt_nop_node(fdto, fixups);
+}
+
+/*
+ * Give fragments which target a labelled node of the base tree by phandle
+ * the path of the node instead. fdt_overlay_apply() then finds the target
+ * by following the path rather than by searching the whole tree for the
+ * phandle, which it does again for each symbol in the fragment. This is
+ * only a shortcut, so a fragment is left alone if there is no room.
+ */
+static void fdt_overlay_target_paths(void *fdto, struct fdt_overlay_syms *st)
+{
+	const fdt32_t *target;
+	int frag, local, len, i;
+	u32 phandle;
+
+	fdt_for_each_subnode(frag, fdto, 0) {
+		target = fdt_getprop(fdto, frag, "target", &len);
+		if (!target || len != sizeof(*target))
+			continue;
+
+		/* A target within the overlay is not in the base tree */
+		local = fdt_subnode_offset(fdto, 0, "__local_fixups__");
+		if (local >= 0)
+			local = fdt_subnode_offset(fdto, local,
+						   fdt_get_name(fdto, frag,
+								NULL));
+		if (local >= 0 && fdt_getprop(fdto, local, "target", NULL))
+			continue;
+
+		phandle = fdt32_to_cpu(*target);
+		for (i = 0; i < st->count; i++) {
+			if (st->syms[i].phandle == phandle)
+				break;
+		}
+		if (i == st->count ||
+		    fdt_setprop_string(fdto, frag, "target-path",
+				       st->syms[i].path))
+			continue;
+		fdt_delprop(fdto, frag, "target");
+	}
+}
+
+int fdt_overlay_apply_list(void *fdt, void * const fdto[], int count,
+			   ulong *times)
+{
+	struct fdt_overlay_syms st = { 0 };
+	bool has_symbols = false, has_phandles = false;
+	ulong start;
+	void *copy;
+	int i, j, size, ret;
+
+	ret = fdt_overlay_syms_update(fdt, &st);
+	for (i = 0; !ret && i < count; i++) {
+		start = timer_get_us();
+		ret = fdt_check_header(fdto[i]);
+		if (ret)
+			break;
+
+		/* Leave some room for the target paths */
+		size = fdt_totalsize(fdto[i]) + 1024;
+		copy = malloc(size);
+		if (!copy) {
+			ret = -FDT_ERR_NOSPACE;
+			break;
+		}
+		ret = fdt_open_into(fdto[i], copy, size);
+		if (!ret)
+			ret = fdt_overlay_fixup(fdt, copy, &st);
+		if (!ret) {
+			fdt_overlay_target_paths(copy, &st);
+			has_symbols = fdt_subnode_offset(copy, 0,
+							 "__symbols__") >= 0;
+			has_phandles = fdt_get_max_phandle(copy) != 0;
+			ret = fdt_overlay_apply(fdt, copy);
+		}
+		free(copy);
+		if (ret)
+			break;
+
+		/* A labelled node may have been given a new phandle */
+		if (has_phandles) {
+			for (j = 0; j < st.count; j++)
+				st.syms[j].phandle = 0;
+			st.indexed = false;
+		}
+		if (has_symbols) {
+			ret = fdt_overlay_syms_update(fdt, &st);
+			st.indexed = false;
+		}
+		if (times)
+			times[i] = timer_get_us() - start;
+	}
+	fdt_overlay_syms_free(&st);
+
+	/* As fdt_overlay_apply(), do not leave a half-applied tree around */
+	if (ret)
+		fdt_set_magic(fdt, ~0);
+
+	return ret;
+}
 #endif
@@ -469,6 +469,16 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 	int ret = -EPERM;
 	int fdt_ret;
 
+	/*
+	 * The common fixups only set properties, so write them out in one
+	 * go. Other fixups may change the tree directly.
+	 */
+	fdt_ret = fdt_batch_begin(blob);
+	if (fdt_ret) {
+		printf("ERROR: fdt fixup setup failed: %s\n",
+		       fdt_strerror(fdt_ret));
+		goto err;
+	}
 	if (fdt_root(blob) < 0) {
 		printf("ERROR: root node setup failed\n");
 		goto err;
@@ -477,12 +487,17 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		printf("ERROR: /chosen node create failed\n");
 		goto err;
 	}
+	/* Update ethernet nodes */
+	fdt_fixup_ethernet(blob);
+	fdt_ret = fdt_batch_commit(blob);
+	if (fdt_ret) {
+		printf("ERROR: fdt fixup failed: %s\n", fdt_strerror(fdt_ret));
+		goto err;
+	}
 	if (arch_fixup_fdt(blob) < 0) {
 		printf("ERROR: arch-specific fdt fixup failed\n");
 		goto err;
 	}
-	/* Update ethernet nodes */
-	fdt_fixup_ethernet(blob);
 	if (IMAGE_OF_BOARD_SETUP) {
 		fdt_ret = ft_board_setup(blob, gd->bd);
 		if (fdt_ret) {
@@ -529,6 +544,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 
 	return 0;
 err:
+	fdt_batch_commit(blob);
 	printf(" - must RESET the board to recover.\n\n");
 
 	return ret;
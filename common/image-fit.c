@@ -2040,11 +2040,15 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 	ulong load, len;
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
 	ulong image_start, image_end;
-	ulong ovload, ovlen;
+	ulong ovload, ovlen, ovtotal;
 	const char *uconfig;
 	const char *uname;
-	void *base, *ov;
-	int i, err, noffset, ov_noffset;
+	const char **ovnames = NULL;
+	void **ovs = NULL;
+	ulong *ovtimes = NULL;
+	void *base;
+	char *p;
+	int i, err, noffset, ov_noffset, ovcount = 0, max;
 #endif
 
 	fit_uname = fit_unamep ? *fit_unamep : NULL;
@@ -2096,9 +2100,20 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 		goto out;
 	}
 
-	base = map_sysmem(load, len);
+	/* one overlay for each further fdt and each further config */
+	max = count;
+	for (p = next_config; p; p = strchr(p + 1, '#'))
+		max++;
+	ovs = calloc(max, sizeof(*ovs));
+	ovnames = calloc(max, sizeof(*ovnames));
+	ovtimes = calloc(max, sizeof(*ovtimes));
+	if (!ovs || !ovnames || !ovtimes) {
+		fdt_noffset = -ENOMEM;
+		goto out;
+	}
 
-	/* apply extra configs in FIT first, followed by args */
+	/* load extra configs in FIT first, followed by args */
+	ovtotal = 0;
 	for (i = 1; ; i++) {
 		if (i < count) {
 			noffset = fit_conf_get_prop_node_index(fit, cfg_noffset,
@@ -2128,24 +2143,41 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 		}
 		debug("%s loaded at 0x%08lx len=0x%08lx\n",
 				uname, ovload, ovlen);
-		ov = map_sysmem(ovload, ovlen);
 
-		base = map_sysmem(load, len + ovlen);
-		err = fdt_open_into(base, base, len + ovlen);
-		if (err < 0) {
-			printf("failed on fdt_open_into\n");
-			fdt_noffset = err;
-			goto out;
-		}
-		/* the verbose method prints out messages on error */
-		err = fdt_overlay_apply_verbose(base, ov);
-		if (err < 0) {
-			fdt_noffset = err;
+		/*
+		 * Keep a copy, as the next overlay may be loaded to the same
+		 * address before this one is applied
+		 */
+		ovs[ovcount] = malloc(ovlen);
+		if (!ovs[ovcount]) {
+			fdt_noffset = -ENOMEM;
 			goto out;
 		}
-		fdt_pack(base);
-		len = fdt_totalsize(base);
+		memcpy(ovs[ovcount], map_sysmem(ovload, ovlen), ovlen);
+		ovnames[ovcount++] = uname;
+		ovtotal += ovlen;
 	}
+
+	/* then apply them all, opening up and packing the base tree once */
+	base = map_sysmem(load, len + ovtotal);
+	err = fdt_open_into(base, base, len + ovtotal);
+	if (err < 0) {
+		printf("failed on fdt_open_into\n");
+		fdt_noffset = err;
+		goto out;
+	}
+	err = fdt_overlay_apply_list(base, ovs, ovcount, ovtimes);
+	if (err < 0) {
+		printf("failed on fdt_overlay_apply_list(): %s\n",
+		       fdt_strerror(err));
+		fdt_noffset = err;
+		goto out;
+	}
+	for (i = 0; i < ovcount; i++)
+		printf("   Applied overlay %s in %lu us\n", ovnames[i],
+		       ovtimes[i]);
+	fdt_pack(base);
+	len = fdt_totalsize(base);
 #else
 	printf("config with overlays but CONFIG_OF_LIBFDT_OVERLAY not set\n");
 	fdt_noffset = -EBADF;
@@ -2161,6 +2193,13 @@ out:
 	if (fit_uname_configp)
 		*fit_uname_configp = fit_uname_config;
 
+#ifdef CONFIG_OF_LIBFDT_OVERLAY
+	for (i = 0; ovs && i < ovcount; i++)
+		free(ovs[i]);
+	free(ovtimes);
+	free(ovnames);
+	free(ovs);
+#endif
 	if (fit_uname_config_copy)
 		free(fit_uname_config_copy);
 	return fdt_noffset;
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Cooperative threads
+ *
+ * The main thread runs each of the others in turn, from uthread_schedule().
+ * A thread runs until it yields or returns, which switches back to the main
+ * thread. There is no preemption and no locking is needed.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <uthread.h>
+
+/* Context of the thread which is not a uthread, normally the main loop */
+static struct uthread main_thread;
+static struct uthread *current = &main_thread;
+
+/* Threads which have not finished, in the order they run */
+static LIST_HEAD(uthread_list);
+
+static uint uthread_next_grp_id;
+
+static void uthread_entry(void)
+{
+	current->fn(current->arg);
+	current->done = true;
+	arch_uthread_switch(current, &main_thread);
+
+	/* finished threads are never switched to */
+	hang();
+}
+
+int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
+		   size_t stack_sz, uint grp_id)
+{
+	int ret;
+
+	if (!main_thread.ctx) {
+		ret = arch_uthread_init(&main_thread, 0, NULL);
+		if (ret)
+			return ret;
+	}
+
+	if (!stack_sz)
+		stack_sz = CONFIG_UTHREAD_STACK_SIZE;
+	memset(uthr, '\0', sizeof(*uthr));
+	uthr->fn = fn;
+	uthr->arg = arg;
+	uthr->grp_id = grp_id;
+	uthr->stack = memalign(16, stack_sz);
+	if (!uthr->stack)
+		return -ENOMEM;
+
+	ret = arch_uthread_init(uthr, stack_sz, uthread_entry);
+	if (ret) {
+		free(uthr->stack);
+		return ret;
+	}
+	list_add_tail(&uthr->list, &uthread_list);
+
+	return 0;
+}
+
+static void uthread_free(struct uthread *uthr)
+{
+	list_del(&uthr->list);
+	arch_uthread_free(uthr);
+	free(uthr->stack);
+	uthr->stack = NULL;
+}
+
+bool uthread_schedule(void)
+{
+	struct uthread *uthr;
+
+	if (current != &main_thread) {
+		arch_uthread_switch(current, &main_thread);
+		return true;
+	}
+	if (list_empty(&uthread_list))
+		return false;
+
+	uthr = list_first_entry(&uthread_list, struct uthread, list);
+	list_move_tail(&uthr->list, &uthread_list);
+	current = uthr;
+	arch_uthread_switch(&main_thread, uthr);
+	current = &main_thread;
+
+	if (uthr->done)
+		uthread_free(uthr);
+
+	return true;
+}
+
+ulong uthread_delay(ulong usec)
+{
+	ulong start, elapsed;
+
+	if (current == &main_thread && list_empty(&uthread_list)) {
+		__udelay(usec);
+		return usec;
+	}
+
+	start = timer_get_us();
+	uthread_schedule();
+	elapsed = timer_get_us() - start;
+
+	return min(elapsed, usec);
+}
+
+uint uthread_grp_new_id(void)
+{
+	return ++uthread_next_grp_id;
+}
+
+bool uthread_grp_done(uint grp_id)
+{
+	struct uthread *uthr;
+
+	list_for_each_entry(uthr, &uthread_list, list) {
+		if (uthr->grp_id == grp_id)
+			return false;
+	}
+
+	return true;
+}
@@ -23,6 +23,9 @@ struct block_cache_node {
 
 static LIST_HEAD(block_cache);
 
+/* Changed whenever the contents of a device may have changed */
+static ulong blkcache_gen;
+
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 2,
 	.max_entries = 32
@@ -130,6 +133,8 @@ void blkcache_invalidate(int iftype, int devnum)
 	struct list_head *entry, *n;
 	struct block_cache_node *node;
 
+	blkcache_gen++;
+
 	list_for_each_safe(entry, n, &block_cache) {
 		node = (struct block_cache_node *)entry;
 		if ((node->iftype == iftype) &&
@@ -142,6 +147,11 @@ void blkcache_invalidate(int iftype, int devnum)
 	}
 }
 
+ulong blkcache_get_gen(void)
+{
+	return blkcache_gen;
+}
+
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
 	struct block_cache_node *node;
@@ -373,6 +373,7 @@ int device_probe(struct udevice *dev)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_index_device(dev);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -436,6 +437,7 @@ fail:
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	dev->seq = -1;
+	uclass_index_device(dev);
 	device_free(dev);
 
 	return ret;
@@ -724,10 +726,19 @@ int device_set_name(struct udevice *dev, const char *name)
 		return -ENOMEM;
 	dev->name = name;
 	device_set_name_alloced(dev);
+	uclass_index_device(dev);
 
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	dev->node = node;
+	uclass_index_device(dev);
+}
+#endif
+
 bool device_is_compatible(struct udevice *dev, const char *compat)
 {
 	return ofnode_device_is_compatible(dev_ofnode(dev), compat);
@@ -127,6 +127,7 @@ struct property *of_find_property(const struct device_node *np,
 	if (!np)
 		return NULL;
 
+	of_node_populate(np);
 	for (pp = np->properties; pp; pp = pp->next) {
 		if (strcmp(pp->name, name) == 0) {
 			if (lenp)
@@ -144,6 +145,8 @@ struct device_node *of_find_all_nodes(struct device_node *prev)
 {
 	struct device_node *np;
 
+	if (prev)
+		of_node_populate_children(prev);
 	if (!prev) {
 		np = gd->of_root;
 	} else if (prev->child) {
@@ -266,6 +269,7 @@ static struct device_node *__of_get_next_child(const struct device_node *node,
 	if (!node)
 		return NULL;
 
+	of_node_populate_children(node);
 	next = prev ? prev->sibling : node->child;
 	/*
 	 * coverity[dead_error_line : FALSE]
@@ -305,7 +309,29 @@ static struct device_node *__of_find_node_by_path(struct device_node *parent,
 }
 
 #define for_each_property_of_node(dn, pp) \
-	for (pp = dn->properties; pp != NULL; pp = pp->next)
+	for (of_node_populate(dn), pp = dn->properties; pp != NULL; \
+	     pp = pp->next)
+
+/*
+ * Nodes found by path and by phandle, so that repeated lookups (e.g. of
+ * clocks, GPIOs and regulators shared by many devices) need not walk the
+ * tree. Entries are checked against the node, so collisions just miss.
+ */
+#define OF_PATH_CACHE_SIZE	64
+#define OF_PHANDLE_CACHE_SIZE	128
+
+static struct device_node *of_path_cache[OF_PATH_CACHE_SIZE];
+static struct device_node *of_phandle_cache[OF_PHANDLE_CACHE_SIZE];
+
+static uint of_path_hash(const char *path)
+{
+	uint hash = 0;
+
+	while (*path)
+		hash = hash * 31 + *path++;
+
+	return hash % OF_PATH_CACHE_SIZE;
+}
 
 struct device_node *of_find_node_opts_by_path(const char *path,
 					      const char **opts)
@@ -313,6 +339,7 @@ struct device_node *of_find_node_opts_by_path(const char *path,
 	struct device_node *np = NULL;
 	struct property *pp;
 	const char *separator = strchr(path, ':');
+	const char *path_start = path;
 
 	if (opts)
 		*opts = separator ? separator + 1 : NULL;
@@ -320,6 +347,13 @@ struct device_node *of_find_node_opts_by_path(const char *path,
 	if (strcmp(path, "/") == 0)
 		return of_node_get(gd->of_root);
 
+	if (*path == '/' && !separator) {
+		np = of_path_cache[of_path_hash(path)];
+		if (np && !strcmp(np->full_name, path))
+			return of_node_get(np);
+		np = NULL;
+	}
+
 	/* The path could begin with an alias */
 	if (*path != '/') {
 		int len;
@@ -359,6 +393,9 @@ struct device_node *of_find_node_opts_by_path(const char *path,
 			break;
 	}
 
+	if (np && !separator && !strcmp(np->full_name, path_start))
+		of_path_cache[of_path_hash(path_start)] = np;
+
 	return np;
 }
 
@@ -378,14 +415,25 @@ struct device_node *of_find_compatible_node(struct device_node *from,
 
 struct device_node *of_find_node_by_phandle(phandle handle)
 {
+	struct device_node **cache;
 	struct device_node *np;
 
 	if (!handle)
 		return NULL;
 
+	cache = &of_phandle_cache[handle % OF_PHANDLE_CACHE_SIZE];
+	if (*cache && (*cache)->phandle == handle)
+		return of_node_get(*cache);
+
+#if CONFIG_IS_ENABLED(OF_LIVE_LAZY)
+	np = of_live_find_node_by_phandle(handle);
+#else
 	for_each_of_allnodes(np)
 		if (np->phandle == handle)
 			break;
+#endif
+	if (np)
+		*cache = np;
 	(void)of_node_get(np);
 
 	return np;
@@ -144,6 +144,7 @@ ofnode ofnode_find_subnode(ofnode node, const char *subnode_name)
 	if (ofnode_is_np(node)) {
 		const struct device_node *np = ofnode_to_np(node);
 
+		of_node_populate_children(np);
 		for (np = np->child; np; np = np->sibling) {
 			if (!strcmp(subnode_name, np->name))
 				break;
@@ -179,8 +180,10 @@ int ofnode_read_u32_array(ofnode node, const char *propname,
 ofnode ofnode_first_subnode(ofnode node)
 {
 	assert(ofnode_valid(node));
-	if (ofnode_is_np(node))
+	if (ofnode_is_np(node)) {
+		of_node_populate_children(node.np);
 		return np_to_ofnode(node.np->child);
+	}
 
 	return offset_to_ofnode(
 		fdt_first_subnode(gd->fdt_blob, ofnode_to_offset(node)));
@@ -226,8 +229,8 @@ ofnode ofnode_get_by_phandle(uint phandle)
 	if (of_live_active())
 		node = np_to_ofnode(of_find_node_by_phandle(phandle));
 	else
-		node.of_offset = fdt_node_offset_by_phandle(gd->fdt_blob,
-							    phandle);
+		node.of_offset = fdtdec_node_offset_by_phandle(gd->fdt_blob,
+							       phandle);
 
 	return node;
 }
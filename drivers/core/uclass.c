@@ -19,17 +19,269 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/* Number of entries in each hash table of a new uclass */
+#define UCLASS_INDEX_SIZE	8
+
+/* The hash tables in struct uclass index */
+enum {
+	UCLASS_INDEX_NAME,
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_OFNODE,
+
+	UCLASS_INDEX_COUNT,
+};
+
+static uint uclass_hash_name(const char *name)
+{
+	uint hash = 0;
+
+	while (*name)
+		hash = hash * 31 + *name++;
+
+	return hash;
+}
+
+static uint uclass_hash_ofnode(ofnode node)
+{
+	/* Both node pointers and offsets are at least 4-byte aligned */
+	ulong key = (ulong)node.of_offset >> 2;
+
+	return key ^ (key >> 10);
+}
+
+static struct hlist_head *uclass_index_head(struct uclass *uc, int table,
+					    uint hash)
+{
+	return &uc->index[table * uc->index_size +
+			  (hash & (uc->index_size - 1))];
+}
+
+/* Add to the end of the chain, so that it follows the uclass's order */
+static void uclass_index_add(struct hlist_node *n, struct hlist_head *head)
+{
+	struct hlist_node *last = head->first;
+
+	if (!last) {
+		hlist_add_head(n, head);
+		return;
+	}
+	while (last->next)
+		last = last->next;
+	hlist_add_after(last, n);
+}
+
+static void uclass_index_add_device(struct uclass *uc, struct udevice *dev)
+{
+	struct hlist_head *head;
+
+	if (dev->name) {
+		head = uclass_index_head(uc, UCLASS_INDEX_NAME,
+					 uclass_hash_name(dev->name));
+		uclass_index_add(&dev->name_node, head);
+	}
+	if (dev->seq != -1) {
+		head = uclass_index_head(uc, UCLASS_INDEX_SEQ, dev->seq);
+		uclass_index_add(&dev->seq_node, head);
+	}
+	if (ofnode_valid(dev->node)) {
+		head = uclass_index_head(uc, UCLASS_INDEX_OFNODE,
+					 uclass_hash_ofnode(dev->node));
+		uclass_index_add(&dev->ofnode_node, head);
+	}
+}
+
+static void uclass_index_del_device(struct udevice *dev)
+{
+	hlist_del_init(&dev->name_node);
+	hlist_del_init(&dev->seq_node);
+	hlist_del_init(&dev->ofnode_node);
+}
+
+/* Double the size of the hash tables and add all the devices again */
+static int uclass_index_resize(struct uclass *uc)
+{
+	struct hlist_head *index;
+	struct udevice *dev;
+	int size;
+
+	size = uc->index_size ? uc->index_size * 2 : UCLASS_INDEX_SIZE;
+	index = calloc(size * UCLASS_INDEX_COUNT, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node)
+		uclass_index_del_device(dev);
+	free(uc->index);
+	uc->index = index;
+	uc->index_size = size;
+	list_for_each_entry(dev, &uc->dev_head, uclass_node)
+		uclass_index_add_device(uc, dev);
+
+	return 0;
+}
+
+static void uclass_index_bind(struct uclass *uc, struct udevice *dev)
+{
+	uc->dev_count++;
+	/* Memory is short before relocation, so only index afterwards */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	/* If there is no memory, chains get longer */
+	if (uc->dev_count > uc->index_size && !uclass_index_resize(uc))
+		return;
+	if (uc->index)
+		uclass_index_add_device(uc, dev);
+}
+
+static void uclass_index_unbind(struct uclass *uc, struct udevice *dev)
+{
+	uclass_index_del_device(dev);
+	uc->dev_count--;
+}
+
+void uclass_index_device(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+
+	if (!uc || !uc->index || list_empty(&dev->uclass_node))
+		return;
+	uclass_index_del_device(dev);
+	uclass_index_add_device(uc, dev);
+}
+
+/*
+ * These look up a device in the hash tables, returning -ENOSYS if there are
+ * none, in which case the caller must walk the uclass's list of devices
+ */
+static int uclass_index_find_name(struct uclass *uc, const char *name,
+				  struct udevice **devp)
+{
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!uc->index)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos,
+			     uclass_index_head(uc, UCLASS_INDEX_NAME,
+					       uclass_hash_name(name)),
+			     name_node) {
+		if (!strcmp(dev->name, name)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int uclass_index_find_seq(struct uclass *uc, int seq,
+				 struct udevice **devp)
+{
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!uc->index)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos,
+			     uclass_index_head(uc, UCLASS_INDEX_SEQ, seq),
+			     seq_node) {
+		if (dev->seq == seq) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+				    struct udevice **devp)
+{
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!uc->index)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos,
+			     uclass_index_head(uc, UCLASS_INDEX_OFNODE,
+					       uclass_hash_ofnode(node)),
+			     ofnode_node) {
+		if (ofnode_equal(dev_ofnode(dev), node)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+/* Fill in the table of uclasses by ID, allocating it if needed */
+static void uclass_table_set(enum uclass_id id, struct uclass *uc)
+{
+	struct uclass *iter;
+
+	if (!gd->uclass_table) {
+		if (!uc || !(gd->flags & GD_FLG_RELOC))
+			return;
+		gd->uclass_table = calloc(UCLASS_COUNT,
+					  sizeof(*gd->uclass_table));
+		if (!gd->uclass_table)
+			return;
+		list_for_each_entry(iter, &gd->uclass_root, sibling_node)
+			gd->uclass_table[iter->uc_drv->id] = iter;
+	}
+	gd->uclass_table[id] = uc;
+
+	if (list_empty(&gd->uclass_root)) {
+		free(gd->uclass_table);
+		gd->uclass_table = NULL;
+	}
+}
+#else
+static inline void uclass_index_bind(struct uclass *uc, struct udevice *dev)
+{
+}
+
+static inline void uclass_index_unbind(struct uclass *uc,
+				       struct udevice *dev)
+{
+}
+
+static inline void uclass_table_set(enum uclass_id id, struct uclass *uc)
+{
+}
+
+static inline int uclass_index_find_name(struct uclass *uc, const char *name,
+					 struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_seq(struct uclass *uc, int seq,
+					struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+					   struct udevice **devp)
+{
+	return -ENOSYS;
+}
+#endif /* DM_UCLASS_INDEX */
+
 struct uclass *uclass_find(enum uclass_id key)
 {
 	struct uclass *uc;
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table)
+		return key >= 0 && key < UCLASS_COUNT ?
+			gd->uclass_table[key] : NULL;
+#endif
 	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -79,6 +331,7 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+	uclass_table_set(id, uc);
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -95,6 +348,7 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+	uclass_table_set(id, NULL);
 fail_mem:
 	free(uc);
 
@@ -128,8 +382,12 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	uclass_table_set(uc_drv->id, NULL);
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	free(uc->index);
+#endif
 	free(uc);
 
 	return 0;
@@ -259,6 +517,21 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	if (ret)
 		return ret;
 
+	/*
+	 * Try an exact match first, then any name starting with @name. The
+	 * index is not built before relocation, so the list is walked then.
+	 */
+	ret = uclass_index_find_name(uc, name, devp);
+	if (!ret)
+		return 0;
+	if (ret == -ENOSYS) {
+		list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+			if (!strcmp(dev->name, name)) {
+				*devp = dev;
+				return 0;
+			}
+		}
+	}
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		if (!strncmp(dev->name, name, strlen(name))) {
 			*devp = dev;
@@ -284,6 +557,12 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+	/* Requested sequence numbers may be changed by drivers at will */
+	if (!find_req_seq) {
+		ret = uclass_index_find_seq(uc, seq_or_req_seq, devp);
+		if (ret != -ENOSYS)
+			return ret;
+	}
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		debug("   - %d %d '%s'\n", dev->req_seq, dev->seq, dev->name);
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
@@ -337,6 +616,9 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_ofnode(uc, node, devp);
+	if (ret != -ENOSYS)
+		goto done;
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
@@ -368,6 +650,9 @@ static int uclass_find_device_by_phandle(enum uclass_id id,
 	find_phandle = dev_read_u32_default(parent, name, -1);
 	if (find_phandle <= 0)
 		return -ENOENT;
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		return uclass_find_device_by_ofnode(id,
+				ofnode_get_by_phandle(find_phandle), devp);
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
@@ -495,6 +780,11 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 	int ret;
 
 	*devp = NULL;
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX)) {
+		ret = uclass_find_device_by_ofnode(id,
+				ofnode_get_by_phandle(phandle_id), &dev);
+		return uclass_get_device_tail(dev, ret, devp);
+	}
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
@@ -596,6 +886,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_bind(uc, dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -610,6 +901,7 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	uclass_index_unbind(uc, dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -628,6 +920,7 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
+	uclass_index_unbind(uc, dev);
 	list_del(&dev->uclass_node);
 	return 0;
 }
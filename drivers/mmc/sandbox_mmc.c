@@ -10,21 +10,36 @@
 #include <fdtdec.h>
 #include <mmc.h>
 #include <asm/test.h>
+#include <linux/sizes.h>
+
+/* Capacity reported by the CSD below: high capacity, C_SIZE 0 */
+#define MMC_CAPACITY		SZ_1M
 
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
 };
 
+/**
+ * struct sandbox_mmc_priv - Contents of the emulated card
+ *
+ * @buf: Data, initially all zeroes
+ */
+struct sandbox_mmc_priv {
+	u8 buf[MMC_CAPACITY];
+};
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
- * This emulate an SD card version 2. Single-block reads result in zero data.
- * Multiple-block reads return a test string.
+ * This emulate an SD card version 2, with its data held in memory.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	ulong pos, size;
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		break;
@@ -54,10 +69,18 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
-		memset(data->dest, '\0', data->blocksize);
-		break;
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
-		strcpy(data->dest, "this is a test");
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		/* The card is high capacity, so addresses are in blocks */
+		pos = (ulong)cmd->cmdarg * data->blocksize;
+		size = data->blocks * data->blocksize;
+		if (pos > MMC_CAPACITY || size > MMC_CAPACITY - pos)
+			return -EINVAL;
+		if (data->flags & MMC_DATA_READ)
+			memcpy(data->dest, priv->buf + pos, size);
+		else
+			memcpy(priv->buf + pos, data->src, size);
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
 		break;
@@ -143,5 +166,6 @@ U_BOOT_DRIVER(mmc_sandbox) = {
 	.bind		= sandbox_mmc_bind,
 	.unbind		= sandbox_mmc_unbind,
 	.probe		= sandbox_mmc_probe,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 	.platdata_auto_alloc_size = sizeof(struct sandbox_mmc_plat),
 };
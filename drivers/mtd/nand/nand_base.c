@@ -1677,6 +1677,39 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_cache_read_pages - [INTERN] Number of pages to read in cache mode
+ * @mtd: MTD device structure
+ * @chip: nand chip info structure
+ * @page: page number of the first page to read
+ * @readlen: number of bytes left to read
+ *
+ * Returns the number of whole pages starting at @page which can be read with
+ * the read cache commands, or 0 if cache mode should not be used. The cache
+ * sequence only runs on the generic large page command path, and is not
+ * allowed to cross an eraseblock boundary.
+ */
+static int nand_cache_read_pages(struct mtd_info *mtd, struct nand_chip *chip,
+				 int page, uint32_t readlen)
+{
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
+	int pages;
+
+	if (!IS_ENABLED(CONFIG_SYS_NAND_USE_CACHE_READ) ||
+	    !NAND_HAS_CACHE_READ(chip) ||
+	    chip->cmdfunc != nand_command_lp ||
+	    !nand_standard_page_accessors(&chip->ecc) ||
+	    chip->ecc.mode == NAND_ECC_HW_OOB_FIRST ||
+	    chip->read_retries > 1 ||
+	    (chip->options & NAND_NEED_READRDY))
+		return 0;
+
+	pages = min_t(uint32_t, readlen >> chip->page_shift,
+		      ppb - (page & (ppb - 1)));
+
+	return pages > 1 ? pages : 0;
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1699,6 +1732,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	int use_bufpoi;
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
+	int cache_left = 0;
 	bool ecc_fail = false;
 
 	chipnr = (int)(from >> chip->chip_shift);
@@ -1729,7 +1763,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			use_bufpoi = 0;
 
 		/* Is the current page in the buffer? */
-		if (realpage != chip->pagebuf || oob) {
+		if (realpage != chip->pagebuf || oob || cache_left) {
 			bufpoi = use_bufpoi ? chip->buffers->databuf : buf;
 
 			if (use_bufpoi && aligned)
@@ -1737,8 +1771,29 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 						 __func__, buf);
 
 read_retry:
-			if (nand_standard_page_accessors(&chip->ecc))
+			if (!cache_left && aligned && !oob) {
+				cache_left = nand_cache_read_pages(mtd, chip,
+								   page,
+								   readlen);
+				if (cache_left)
+					chip->cmdfunc(mtd, NAND_CMD_READ0,
+						      0x00, page);
+			}
+
+			if (cache_left) {
+				/*
+				 * Move the page to the cache register. Unless
+				 * this is the last page of the sequence, the
+				 * chip loads the next page from the array
+				 * while this one is being transferred.
+				 */
+				cache_left--;
+				chip->cmdfunc(mtd, cache_left ?
+					      NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+			} else if (nand_standard_page_accessors(&chip->ecc)) {
 				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1848,6 +1903,11 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+
+	/* Terminate a cache sequence aborted by an error */
+	if (cache_left)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -3355,6 +3415,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 		pr_warn("Could not retrieve ONFI ECC requirements\n");
 	}
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHE_READ;
+
 	if (p->jedec_id == NAND_MFR_MICRON)
 		nand_onfi_detect_micron(chip, p);
 
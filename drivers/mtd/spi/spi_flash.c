@@ -331,9 +331,17 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		}
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
 		erase_addr = offset;
+		erase_size = flash->erase_size;
+		cmd[0] = flash->erase_cmd;
+
+		/* Use a single block erase where the whole block is covered */
+		if (flash->block_size > erase_size &&
+		    !(offset % flash->block_size) && len >= flash->block_size) {
+			erase_size = flash->block_size;
+			cmd[0] = CMD_ERASE_64K;
+		}
 
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
@@ -1317,6 +1325,7 @@ int spi_flash_scan(struct spi_flash *flash)
 	flash->page_size <<= flash->shift;
 	flash->sector_size = info->sector_size << flash->shift;
 	flash->size = flash->sector_size * info->n_sectors << flash->shift;
+	flash->block_size = flash->sector_size;
 #ifdef CONFIG_SF_DUAL_FLASH
 	if (flash->dual_flash & SF_DUAL_STACKED_FLASH)
 		flash->size <<= 1;
@@ -1065,6 +1065,20 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	spin_unlock(&ubi->wl_lock);
 
 	ubi_devices[ubi_num] = ubi;
+#if defined(__UBOOT__) && defined(CONFIG_MTD_UBI_FASTMAP)
+	/*
+	 * U-Boot normally hands over to the OS without detaching, so the
+	 * fastmap written at detach time may never reach the flash. Write one
+	 * as soon as an image without a valid fastmap has been scanned, so
+	 * that the next attach only has to read the fastmap and its pools.
+	 */
+	if (!ubi->ro_mode && !ubi->fm_disabled && !ubi->fm) {
+		ubi_msg(ubi, "writing fastmap");
+		err = ubi_update_fastmap(ubi);
+		if (err)
+			ubi_msg(ubi, "Unable to write a new fastmap: %i", err);
+	}
+#endif
 	ubi_notify_all(ubi, UBI_VOLUME_ADDED, NULL);
 	return ubi_num;
 
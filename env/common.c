@@ -100,6 +100,26 @@ int set_default_vars(int nvars, char * const vars[], int flags)
 				flags, 0, nvars, vars);
 }
 
+/*
+ * Check the CRC of an environment.
+ * Note that "ep" may or may not be aligned.
+ */
+static int env_crc_ok(const env_t *ep)
+{
+	uint32_t crc;
+
+	memcpy(&crc, &ep->crc, sizeof(crc));
+
+	if (crc32(0, ep->data, ENV_SIZE) == crc)
+		return 1;
+#ifdef CONFIG_ENV_JOURNAL
+	if (env_journal_check_crc(ep, crc))
+		return 1;
+#endif
+
+	return 0;
+}
+
 /*
  * Check if CRC is valid and (if yes) import the environment.
  * Note that "buf" may or may not be aligned.
@@ -109,11 +129,7 @@ int env_import(const char *buf, int check)
 	env_t *ep = (env_t *)buf;
 
 	if (check) {
-		uint32_t crc;
-
-		memcpy(&crc, &ep->crc, sizeof(crc));
-
-		if (crc32(0, ep->data, ENV_SIZE) != crc) {
+		if (!env_crc_ok(ep)) {
 			set_default_env("bad CRC", 0);
 			return -EIO;
 		}
@@ -121,6 +137,9 @@ int env_import(const char *buf, int check)
 
 	if (himport_r(&env_htab, (char *)ep->data, ENV_SIZE, '\0', 0, 0,
 			0, NULL)) {
+#ifdef CONFIG_ENV_JOURNAL
+		env_journal_replay(ep);
+#endif
 		gd->flags |= GD_FLG_ENV_READY;
 		return 0;
 	}
@@ -162,10 +181,8 @@ int env_import_redund(const char *buf1, int buf1_read_fail,
 		return env_import((char *)tmp_env2, 1);
 	}
 
-	crc1_ok = crc32(0, tmp_env1->data, ENV_SIZE) ==
-			tmp_env1->crc;
-	crc2_ok = crc32(0, tmp_env2->data, ENV_SIZE) ==
-			tmp_env2->crc;
+	crc1_ok = env_crc_ok(tmp_env1);
+	crc2_ok = env_crc_ok(tmp_env2);
 
 	if (!crc1_ok && !crc2_ok) {
 		set_default_env("bad CRC", 0);
@@ -211,6 +228,9 @@ int env_export(env_t *env_out)
 		return 1;
 	}
 
+#ifdef CONFIG_ENV_JOURNAL
+	env_journal_init(env_out);
+#endif
 	env_out->crc = crc32(0, env_out->data, ENV_SIZE);
 
 #ifdef CONFIG_SYS_REDUNDAND_ENVIRONMENT
@@ -230,6 +230,11 @@ int env_save(void)
 			printf("Failed (%d)\n", ret);
 		else
 			printf("OK\n");
+#ifdef CONFIG_ENV_JOURNAL
+		/* the stored state is unknown now */
+		if (ret)
+			env_journal_reset();
+#endif
 
 		if (!ret)
 			return 0;
@@ -27,46 +27,36 @@
 #include <memalign.h>
 #include <search.h>
 #include <errno.h>
-#include <ext4fs.h>
+#include <fs.h>
+#include <mapmem.h>
 #include <mmc.h>
 
+/* Go through the fs layer so that a filesystem it keeps mounted is honoured */
 #ifdef CONFIG_CMD_SAVEENV
 static int env_ext4_save(void)
 {
 	env_t	env_new;
-	struct blk_desc *dev_desc = NULL;
-	disk_partition_t info;
-	int dev, part;
+	loff_t actwrite;
 	int err;
 
 	err = env_export(&env_new);
 	if (err)
 		return err;
 
-	part = blk_get_device_part_str(CONFIG_ENV_EXT4_INTERFACE,
-				       CONFIG_ENV_EXT4_DEVICE_AND_PART,
-				       &dev_desc, &info, 1);
-	if (part < 0)
-		return 1;
-
-	dev = dev_desc->devnum;
-	ext4fs_set_blk_dev(dev_desc, &info);
-
-	if (!ext4fs_mount(info.size)) {
+	if (fs_set_blk_dev(CONFIG_ENV_EXT4_INTERFACE,
+			   CONFIG_ENV_EXT4_DEVICE_AND_PART, FS_TYPE_EXT)) {
 		printf("\n** Unable to use %s %s for saveenv **\n",
 		       CONFIG_ENV_EXT4_INTERFACE,
 		       CONFIG_ENV_EXT4_DEVICE_AND_PART);
 		return 1;
 	}
 
-	err = ext4fs_write(CONFIG_ENV_EXT4_FILE, (void *)&env_new,
-			   sizeof(env_t));
-	ext4fs_close();
-
-	if (err == -1) {
-		printf("\n** Unable to write \"%s\" from %s%d:%d **\n",
-			CONFIG_ENV_EXT4_FILE, CONFIG_ENV_EXT4_INTERFACE, dev,
-			part);
+	err = fs_write(CONFIG_ENV_EXT4_FILE, map_to_sysmem(&env_new), 0,
+		       sizeof(env_t), &actwrite);
+	if (err < 0) {
+		printf("\n** Unable to write \"%s\" from %s %s **\n",
+		       CONFIG_ENV_EXT4_FILE, CONFIG_ENV_EXT4_INTERFACE,
+		       CONFIG_ENV_EXT4_DEVICE_AND_PART);
 		return 1;
 	}
 
@@ -78,9 +68,6 @@ static int env_ext4_save(void)
 static int env_ext4_load(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(char, buf, CONFIG_ENV_SIZE);
-	struct blk_desc *dev_desc = NULL;
-	disk_partition_t info;
-	int dev, part;
 	int err;
 	loff_t off;
 
@@ -89,30 +76,20 @@ static int env_ext4_load(void)
 		mmc_initialize(NULL);
 #endif
 
-	part = blk_get_device_part_str(CONFIG_ENV_EXT4_INTERFACE,
-				       CONFIG_ENV_EXT4_DEVICE_AND_PART,
-				       &dev_desc, &info, 1);
-	if (part < 0)
-		goto err_env_relocate;
-
-	dev = dev_desc->devnum;
-	ext4fs_set_blk_dev(dev_desc, &info);
-
-	if (!ext4fs_mount(info.size)) {
+	if (fs_set_blk_dev(CONFIG_ENV_EXT4_INTERFACE,
+			   CONFIG_ENV_EXT4_DEVICE_AND_PART, FS_TYPE_EXT)) {
 		printf("\n** Unable to use %s %s for loading the env **\n",
 		       CONFIG_ENV_EXT4_INTERFACE,
 		       CONFIG_ENV_EXT4_DEVICE_AND_PART);
 		goto err_env_relocate;
 	}
 
-	err = ext4_read_file(CONFIG_ENV_EXT4_FILE, buf, 0, CONFIG_ENV_SIZE,
-			     &off);
-	ext4fs_close();
-
-	if (err == -1) {
-		printf("\n** Unable to read \"%s\" from %s%d:%d **\n",
-			CONFIG_ENV_EXT4_FILE, CONFIG_ENV_EXT4_INTERFACE, dev,
-			part);
+	err = fs_read(CONFIG_ENV_EXT4_FILE, map_to_sysmem(buf), 0,
+		      CONFIG_ENV_SIZE, &off);
+	if (err < 0) {
+		printf("\n** Unable to read \"%s\" from %s %s **\n",
+		       CONFIG_ENV_EXT4_FILE, CONFIG_ENV_EXT4_INTERFACE,
+		       CONFIG_ENV_EXT4_DEVICE_AND_PART);
 		goto err_env_relocate;
 	}
 
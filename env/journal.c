@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Environment journal: append changed variables instead of rewriting
+ *
+ * The stored environment starts as usual, with the variables exported as
+ * "name=value" strings and terminated by an empty string. The rest of the
+ * data area is left erased (0xff) and the CRC is computed that way, so a
+ * freshly saved environment is a normal one.
+ *
+ * Later saves append records to the erased area, starting at the first
+ * 4-byte boundary after the variables. Each record holds the variables
+ * changed since the previous save, in the same "name=value" form, with
+ * deleted variables written as "name=". The CRC in the environment header
+ * covers the area as if it were still erased, and each record carries its
+ * own CRC. On import the records are applied in order up to the first
+ * invalid one, so a record torn by a power failure is simply dropped.
+ */
+
+#include <common.h>
+#include <environment.h>
+#include <errno.h>
+#include <malloc.h>
+#include <search.h>
+#include <linux/stddef.h>
+#include <u-boot/crc.h>
+
+#define ENV_JOURNAL_MAGIC	0x4a766e45	/* "EnvJ" */
+
+struct env_journal_rec {
+	uint32_t magic;		/* ENV_JOURNAL_MAGIC */
+	uint32_t len;		/* length of the data that follows */
+	uint32_t crc;		/* CRC32 over the data */
+};
+
+/* Offset in the stored env_t of the next record, 0 if none can be added */
+static ulong env_journal_next;
+
+#ifndef CONFIG_SPL_BUILD
+/* Variables in storage, as exported, for comparison on the next save */
+static char *env_journal_snap;
+
+/* Export the variables into a new buffer, as the data area of an env_t */
+static char *env_journal_export(void)
+{
+	char *res = malloc(ENV_SIZE);
+
+	if (res &&
+	    hexport_r(&env_htab, '\0', 0, &res, ENV_SIZE, 0, NULL) < 0) {
+		free(res);
+		res = NULL;
+	}
+
+	return res;
+}
+#endif
+
+/* Return the offset in the data area where the records start */
+static ulong env_journal_start(const unsigned char *data)
+{
+	ulong i;
+
+	for (i = 0; i < ENV_SIZE; i++) {
+		if (!data[i] && (i == 0 || !data[i - 1]))
+			return ALIGN(i + 1, 4);
+	}
+
+	return ENV_SIZE;
+}
+
+int env_journal_check_crc(const env_t *ep, uint32_t crc)
+{
+	ulong start = env_journal_start(ep->data);
+	unsigned char erased[64];
+	uint32_t val;
+	ulong left, n;
+
+	memset(erased, 0xff, sizeof(erased));
+	val = crc32(0, ep->data, start);
+	for (left = ENV_SIZE - start; left; left -= n) {
+		n = min_t(ulong, left, sizeof(erased));
+		val = crc32(val, erased, n);
+	}
+
+	return val == crc;
+}
+
+void env_journal_replay(const env_t *ep)
+{
+	const char *data = (const char *)ep->data;
+	struct env_journal_rec rec;
+	ulong off, i;
+
+	env_journal_reset();
+
+	off = env_journal_start(ep->data);
+	while (off + sizeof(rec) <= ENV_SIZE) {
+		memcpy(&rec, data + off, sizeof(rec));
+		if (rec.magic != ENV_JOURNAL_MAGIC ||
+		    rec.len > ENV_SIZE - off - sizeof(rec) ||
+		    crc32(0, (uchar *)data + off + sizeof(rec), rec.len) !=
+		    rec.crc)
+			break;
+
+		debug("env journal: record at %lu, %u bytes\n", off, rec.len);
+		if (!himport_r(&env_htab, data + off + sizeof(rec), rec.len,
+			       '\0', H_NOCLEAR | H_FORCE, 0, 0, NULL))
+			pr_err("## Error: cannot apply environment record\n");
+
+		off += ALIGN(sizeof(rec) + rec.len, 4);
+	}
+
+	/* Only an erased remainder can take more records */
+	for (i = off; i < ENV_SIZE; i++) {
+		if (data[i] != (char)0xff)
+			return;
+	}
+
+#ifndef CONFIG_SPL_BUILD
+	env_journal_snap = env_journal_export();
+	if (!env_journal_snap)
+		return;
+#endif
+	env_journal_next = offsetof(env_t, data) + off;
+}
+
+void env_journal_init(env_t *ep)
+{
+	ulong start = env_journal_start(ep->data);
+
+	env_journal_reset();
+	memset(ep->data + start, 0xff, ENV_SIZE - start);
+
+#ifndef CONFIG_SPL_BUILD
+	env_journal_snap = malloc(start);
+	if (!env_journal_snap)
+		return;
+	memcpy(env_journal_snap, ep->data, start);
+#endif
+	env_journal_next = offsetof(env_t, data) + start;
+}
+
+void env_journal_reset(void)
+{
+	env_journal_next = 0;
+#ifndef CONFIG_SPL_BUILD
+	free(env_journal_snap);
+	env_journal_snap = NULL;
+#endif
+}
+
+#ifndef CONFIG_SPL_BUILD
+/* Compare the names of two "name=value" strings, as hexport_r() sorts */
+static int env_journal_keycmp(const char *a, const char *b)
+{
+	int na = strchr(a, '=') - a;
+	int nb = strchr(b, '=') - b;
+	int cmp = strncmp(a, b, min(na, nb));
+
+	return cmp ? cmp : na - nb;
+}
+
+/*
+ * Write the "name=value" strings that turn the sorted list "old" into the
+ * sorted list "new" to "out". Return the length, or -ENOSPC if more than
+ * "size" bytes are needed.
+ */
+static long env_journal_diff(const char *old, const char *new, char *out,
+			     ulong size)
+{
+	ulong len = 0, n;
+	int cmp;
+
+	while (*old || *new) {
+		if (!*old)
+			cmp = 1;
+		else if (!*new)
+			cmp = -1;
+		else
+			cmp = env_journal_keycmp(old, new);
+
+		if (cmp < 0) {
+			/* deleted: write "name=" */
+			n = strchr(old, '=') - old + 1;
+			if (len + n + 1 > size)
+				return -ENOSPC;
+			memcpy(out + len, old, n);
+			out[len + n] = '\0';
+			len += n + 1;
+		} else if (cmp > 0 || strcmp(old, new)) {
+			/* added or changed */
+			n = strlen(new) + 1;
+			if (len + n > size)
+				return -ENOSPC;
+			memcpy(out + len, new, n);
+			len += n;
+		}
+
+		if (cmp <= 0)
+			old += strlen(old) + 1;
+		if (cmp >= 0)
+			new += strlen(new) + 1;
+	}
+
+	return len;
+}
+
+int env_journal_save(int (*write)(ulong offset, ulong len, const void *buf))
+{
+	ulong end = offsetof(env_t, data) + ENV_SIZE;
+	struct env_journal_rec *rec;
+	char *cur;
+	ulong size;
+	long len;
+	int ret;
+
+	if (!env_journal_next || !env_journal_snap)
+		return -ENOSPC;
+	if (end - env_journal_next <= sizeof(*rec))
+		return -ENOSPC;
+
+	/* if this fails, let the full save report it */
+	cur = env_journal_export();
+	if (!cur)
+		return -ENOSPC;
+
+	size = end - env_journal_next;
+	rec = malloc(size);
+	if (!rec) {
+		free(cur);
+		return -ENOMEM;
+	}
+
+	len = env_journal_diff(env_journal_snap, cur, (char *)(rec + 1),
+			       size - sizeof(*rec));
+	if (len <= 0) {
+		/* nothing changed, or no room left */
+		ret = len;
+		goto out;
+	}
+
+	rec->magic = ENV_JOURNAL_MAGIC;
+	rec->len = len;
+	rec->crc = crc32(0, (uchar *)(rec + 1), len);
+
+	/* pad to the next record, leaving the padding erased */
+	size = min_t(ulong, size, ALIGN(sizeof(*rec) + len, 4));
+	memset((char *)(rec + 1) + len, 0xff, size - sizeof(*rec) - len);
+
+	ret = write(env_journal_next, size, rec);
+	if (ret) {
+		env_journal_reset();
+		goto out;
+	}
+
+	env_journal_next += size;
+	free(env_journal_snap);
+	env_journal_snap = cur;
+	cur = NULL;
+
+out:
+	free(rec);
+	free(cur);
+
+	return ret;
+}
+#endif /* !CONFIG_SPL_BUILD */
@@ -181,6 +181,20 @@ static void fini_mmc_for_env(struct mmc *mmc)
 #endif
 }
 
+static inline int read_env(struct mmc *mmc, unsigned long size,
+			   unsigned long offset, const void *buffer)
+{
+	uint blk_start, blk_cnt, n;
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+
+	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
+	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
+
+	n = blk_dread(desc, blk_start, blk_cnt, (uchar *)buffer);
+
+	return (n == blk_cnt) ? 0 : -1;
+}
+
 #if defined(CONFIG_CMD_SAVEENV) && !defined(CONFIG_SPL_BUILD)
 static inline int write_env(struct mmc *mmc, unsigned long size,
 			    unsigned long offset, const void *buffer)
@@ -196,6 +210,35 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_JOURNAL
+static struct mmc *env_journal_mmc;
+static u32 env_journal_offset;
+
+/* Append a journal record, rewriting only the blocks it falls into */
+static int env_mmc_journal_write(ulong offset, ulong len, const void *buf)
+{
+	struct mmc *mmc = env_journal_mmc;
+	ulong start = rounddown(offset, mmc->write_bl_len);
+	ulong size = roundup(offset + len, mmc->write_bl_len) - start;
+	char *tmp;
+	int ret;
+
+	tmp = memalign(ARCH_DMA_MINALIGN, size);
+	if (!tmp)
+		return -ENOMEM;
+
+	printf("Appending to MMC(%d)... ", mmc_get_env_dev());
+	ret = read_env(mmc, size, env_journal_offset + start, tmp);
+	if (!ret) {
+		memcpy(tmp + offset - start, buf, len);
+		ret = write_env(mmc, size, env_journal_offset + start, tmp);
+	}
+	free(tmp);
+
+	return ret ? -EIO : 0;
+}
+#endif
+
 static int env_mmc_save(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(env_t, env_new, 1);
@@ -211,6 +254,23 @@ static int env_mmc_save(void)
 		return 1;
 	}
 
+#ifdef CONFIG_ENV_JOURNAL
+	/* Append to the active copy if there is room */
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	if (gd->env_valid == ENV_REDUND)
+		copy = 1;
+#endif
+	if (mmc_get_env_addr(mmc, copy, &env_journal_offset)) {
+		ret = 1;
+		goto fini;
+	}
+	env_journal_mmc = mmc;
+	ret = env_journal_save(env_mmc_journal_write);
+	if (ret != -ENOSPC)
+		goto fini;
+	copy = 0;
+#endif
+
 	ret = env_export(env_new);
 	if (ret)
 		goto fini;
@@ -244,20 +304,6 @@ fini:
 }
 #endif /* CONFIG_CMD_SAVEENV && !CONFIG_SPL_BUILD */
 
-static inline int read_env(struct mmc *mmc, unsigned long size,
-			   unsigned long offset, const void *buffer)
-{
-	uint blk_start, blk_cnt, n;
-	struct blk_desc *desc = mmc_get_blk_desc(mmc);
-
-	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
-	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
-
-	n = blk_dread(desc, blk_start, blk_cnt, (uchar *)buffer);
-
-	return (n == blk_cnt) ? 0 : -1;
-}
-
 #ifdef CONFIG_ENV_OFFSET_REDUND
 static int env_mmc_load(void)
 {
@@ -80,6 +80,27 @@ static int setup_flash_device(void)
 	return 0;
 }
 
+#if defined(CONFIG_ENV_JOURNAL) && defined(CMD_SAVEENV)
+/* Append a journal record to the active copy; no erase is needed */
+static int env_sf_journal_write(ulong offset, ulong len, const void *buf)
+{
+	ulong base = CONFIG_ENV_OFFSET;
+	int ret;
+
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	if (gd->env_valid == ENV_REDUND)
+		base = CONFIG_ENV_OFFSET_REDUND;
+#endif
+
+	puts("Appending to SPI flash...");
+	ret = spi_flash_write(env_flash, base + offset, len, buf);
+	if (!ret)
+		puts("done\n");
+
+	return ret;
+}
+#endif
+
 #if defined(CONFIG_ENV_OFFSET_REDUND)
 #ifdef CMD_SAVEENV
 static int env_sf_save(void)
@@ -93,6 +114,12 @@ static int env_sf_save(void)
 	if (ret)
 		return ret;
 
+#ifdef CONFIG_ENV_JOURNAL
+	ret = env_journal_save(env_sf_journal_write);
+	if (ret != -ENOSPC)
+		return ret;
+#endif
+
 	ret = env_export(&env_new);
 	if (ret)
 		return -EIO;
@@ -211,6 +238,12 @@ static int env_sf_save(void)
 	if (ret)
 		return ret;
 
+#ifdef CONFIG_ENV_JOURNAL
+	ret = env_journal_save(env_sf_journal_write);
+	if (ret != -ENOSPC)
+		return ret;
+#endif
+
 	/* Is the sector larger than the env (i.e. embedded) */
 	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
 		saved_size = CONFIG_ENV_SECT_SIZE - CONFIG_ENV_SIZE;
@@ -106,6 +106,12 @@ int btrfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
 		return -1;
 	}
 
+	if (IS_ENABLED(CONFIG_FS_BTRFS_CSUM) &&
+	    btrfs_find_root(BTRFS_CSUM_TREE_OBJECTID, &btrfs_info.csum_root,
+			    NULL))
+		printf("%s: no checksum tree, data will not be verified\n",
+		       __func__);
+
 	return 0;
 }
 
@@ -17,6 +17,7 @@ struct btrfs_info {
 	struct btrfs_root tree_root;
 	struct btrfs_root fs_root;
 	struct btrfs_root chunk_root;
+	struct btrfs_root csum_root;
 
 	struct rb_root chunks_root;
 };
@@ -78,6 +79,8 @@ u64 btrfs_file_read(const struct btrfs_root *, u64, u64, u64, char *);
 u64 btrfs_get_default_subvol_objectid(void);
 
 /* extent-io.c */
+int btrfs_check_data_csum(u64, char *, u64);
+int btrfs_read_extent_run(u64, u64, u64, char *);
 u64 btrfs_read_extent_inline(struct btrfs_path *,
 			      struct btrfs_file_extent_item *, u64, u64,
 			      char *);
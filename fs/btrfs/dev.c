@@ -14,12 +14,6 @@ disk_partition_t *btrfs_part_info;
 
 int btrfs_devread(u64 address, int byte_len, void *buf)
 {
-	lbaint_t sector;
-	int byte_offset;
-
-	sector = address >> btrfs_blk_desc->log2blksz;
-	byte_offset = address % btrfs_blk_desc->blksz;
-
-	return fs_devread(btrfs_blk_desc, btrfs_part_info, sector, byte_offset,
-			  byte_len, buf);
+	return !fs_read_range(btrfs_blk_desc, btrfs_part_info, address,
+			      byte_len, buf);
 }
@@ -60,11 +60,139 @@ err:
 	return -1ULL;
 }
 
+/*
+ * Check @len bytes of data at @logical, read into @buf, against the checksum
+ * tree. @logical and @len must be sector aligned. Sectors which have no
+ * checksum, as in nodatasum files, are not checked.
+ */
+int btrfs_check_data_csum(u64 logical, char *buf, u64 len)
+{
+	const u32 sectorsize = btrfs_info.sb.sectorsize;
+	const int csum_size = btrfs_csum_sizes[BTRFS_CSUM_TYPE_CRC32];
+	struct btrfs_path path;
+	struct btrfs_key key, *found;
+	u64 cur, end;
+	u32 crc, result;
+	u8 *csum;
+	int res = 0;
+
+	if (!btrfs_info.csum_root.bytenr)
+		return 0;
+
+	key.objectid = BTRFS_EXTENT_CSUM_OBJECTID;
+	key.type = BTRFS_EXTENT_CSUM_KEY;
+	key.offset = logical;
+
+	if (btrfs_search_tree(&btrfs_info.csum_root, &key, &path))
+		return -1;
+
+	if (!path.nodes[0]->leaf.header.nritems)
+		goto out;
+
+	/* A checksum item covering @logical may start before it */
+	if (path.slots[0] >= path.nodes[0]->leaf.header.nritems ||
+	    btrfs_comp_keys(&key, btrfs_path_leaf_key(&path)) < 0) {
+		res = btrfs_prev_slot(&path);
+		if (res < 0)
+			goto out;
+	}
+
+	do {
+		found = btrfs_path_leaf_key(&path);
+		if (btrfs_comp_keys_type(&key, found) > 0)
+			continue;
+		if (btrfs_comp_keys_type(&key, found) < 0 ||
+		    found->offset >= logical + len)
+			break;
+
+		end = found->offset + btrfs_path_item_size(&path) / csum_size
+		      * sectorsize;
+		end = min(end, logical + len);
+		cur = max(found->offset, logical);
+		csum = btrfs_path_item_ptr(&path, u8)
+		       + (cur - found->offset) / sectorsize * csum_size;
+
+		for (; cur < end; cur += sectorsize, csum += csum_size) {
+			crc = btrfs_csum_data(buf + (cur - logical), ~(u32) 0,
+					      sectorsize);
+			btrfs_csum_final(crc, &result);
+			if (memcmp(&result, csum, csum_size)) {
+				printf("%s: checksum mismatch at %llu\n",
+				       __func__, cur);
+				res = -1;
+				goto out;
+			}
+		}
+	} while (!(res = btrfs_next_slot(&path)));
+
+	if (res > 0)
+		res = 0;
+out:
+	btrfs_free_path(&path);
+	return res;
+}
+
+static int check_sector_csum(u64 logical, u64 physical)
+{
+	const u32 sectorsize = btrfs_info.sb.sectorsize;
+	char *buf;
+	int res = -1;
+
+	buf = malloc(sectorsize);
+	if (!buf)
+		return -1;
+
+	if (btrfs_devread(physical, sectorsize, buf))
+		res = btrfs_check_data_csum(logical, buf, sectorsize);
+
+	free(buf);
+	return res;
+}
+
+/*
+ * Read @len bytes of uncompressed data at @logical, which lie one after the
+ * other on the device from @physical, in a single device read. A run may
+ * span several extents and start or end part way through a sector. Whole
+ * sectors are checked where they were read to, and partial ones at either
+ * end are read again in full to check them.
+ */
+int btrfs_read_extent_run(u64 logical, u64 physical, u64 len, char *out)
+{
+	const u32 sectorsize = btrfs_info.sb.sectorsize;
+	u64 first, last, start, end;
+	bool head, tail;
+
+	if (!btrfs_devread(physical, len, out))
+		return -1;
+
+	if (!IS_ENABLED(CONFIG_FS_BTRFS_CSUM) || !btrfs_info.csum_root.bytenr)
+		return 0;
+
+	first = round_down(logical, sectorsize);
+	last = round_down(logical + len - 1, sectorsize);
+	head = logical != first;
+	tail = logical + len != last + sectorsize;
+
+	if (head && check_sector_csum(first, physical - (logical - first)))
+		return -1;
+	if (tail && (first != last || !head) &&
+	    check_sector_csum(last, physical + (last - logical)))
+		return -1;
+
+	start = head ? first + sectorsize : first;
+	end = tail ? last : last + sectorsize;
+	if (start < end &&
+	    btrfs_check_data_csum(start, out + (start - logical), end - start))
+		return -1;
+
+	return 0;
+}
+
 u64 btrfs_read_extent_reg(struct btrfs_path *path,
 			  struct btrfs_file_extent_item *extent, u64 offset,
 			  u64 size, char *out)
 {
-	u64 physical, clen, dlen, orig_size = size;
+	u64 physical, clen, dlen;
 	u32 res;
 	char *cbuf, *dbuf;
 
@@ -82,18 +210,28 @@ u64 btrfs_read_extent_reg(struct btrfs_path *path,
 		return -1ULL;
 
 	if (extent->compression == BTRFS_COMPRESS_NONE) {
-		physical += extent->offset + offset;
-		if (!btrfs_devread(physical, size, out))
+		offset += extent->offset;
+		if (btrfs_read_extent_run(extent->disk_bytenr + offset,
+					  physical + offset, size, out))
 			return -1ULL;
 
 		return size;
 	}
 
+	/*
+	 * The whole extent is decompressed, into the output if it fits, and
+	 * this file extent may refer to only part of it
+	 */
+	dlen = extent->ram_bytes;
+	offset += extent->offset;
+	if (offset > dlen)
+		return -1ULL;
+
 	cbuf = malloc(dlen > size ? clen + dlen : clen);
 	if (!cbuf)
 		return -1ULL;
 
-	if (dlen > orig_size)
+	if (dlen > size)
 		dbuf = cbuf + clen;
 	else
 		dbuf = out;
@@ -101,17 +239,19 @@ u64 btrfs_read_extent_reg(struct btrfs_path *path,
 	if (!btrfs_devread(physical, clen, cbuf))
 		goto err;
 
+	if (IS_ENABLED(CONFIG_FS_BTRFS_CSUM) &&
+	    btrfs_check_data_csum(extent->disk_bytenr, cbuf, clen))
+		goto err;
+
 	res = btrfs_decompress(extent->compression, cbuf, clen, dbuf, dlen);
-	if (res == -1)
+	if (res == -1 || res < offset + size)
 		goto err;
 
-	if (dlen > orig_size)
-		memcpy(out, dbuf + offset, size);
-	else
+	if (dbuf != out || offset)
 		memmove(out, dbuf + offset, size);
 
 	free(cbuf);
-	return res;
+	return size;
 
 err:
 	free(cbuf);
@@ -9,22 +9,45 @@
 #include <u-boot/crc.h>
 #include <asm/unaligned.h>
 
-static u32 btrfs_crc32c_table[256];
+/*
+ * The crc32c table and seven more derived from it, which give the effect of
+ * each of the next eight bytes so that data can be taken eight at a time
+ */
+static u32 btrfs_crc32c_table[8][256];
 
 void btrfs_hash_init(void)
 {
 	static int inited = 0;
+	u32 (*tab)[256] = btrfs_crc32c_table;
+	int i, j;
 
 	if (!inited) {
-		crc32c_init(btrfs_crc32c_table, 0x82F63B78);
+		crc32c_init(tab[0], 0x82F63B78);
+		for (i = 1; i < 8; ++i)
+			for (j = 0; j < 256; ++j)
+				tab[i][j] = (tab[i - 1][j] >> 8) ^
+					    tab[0][tab[i - 1][j] & 0xff];
 		inited = 1;
 	}
 }
 
 u32 btrfs_crc32c(u32 crc, const void *data, size_t length)
 {
-	return crc32c_cal(crc, (const char *) data, length,
-			  btrfs_crc32c_table);
+	u32 (*tab)[256] = btrfs_crc32c_table;
+	const u8 *p = data;
+	u32 lo, hi;
+
+	for (; length >= 8; length -= 8, p += 8) {
+		lo = crc ^ get_unaligned_le32(p);
+		hi = get_unaligned_le32(p + 4);
+		crc = tab[7][lo & 0xff] ^ tab[6][(lo >> 8) & 0xff] ^
+		      tab[5][(lo >> 16) & 0xff] ^ tab[4][lo >> 24] ^
+		      tab[3][hi & 0xff] ^ tab[2][(hi >> 8) & 0xff] ^
+		      tab[1][(hi >> 16) & 0xff] ^ tab[0][hi >> 24];
+	}
+
+	return crc32c_cal(crc, (const char *) p, length,
+			  tab[0]);
 }
 
 u32 btrfs_csum_data(char *data, u32 seed, size_t len)
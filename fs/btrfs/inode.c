@@ -7,6 +7,7 @@
 
 #include "btrfs.h"
 #include <malloc.h>
+#include <linux/sizes.h>
 
 u64 btrfs_lookup_inode_ref(struct btrfs_root *root, u64 inr,
 			   struct btrfs_inode_ref *refp, char *name)
@@ -316,14 +317,28 @@ u64 btrfs_lookup_path(struct btrfs_root *root, u64 inr, const char *path,
 	return inr;
 }
 
+/*
+ * The most data read from the device at once, as btrfs_devread() takes an
+ * int length
+ */
+#define BTRFS_MAX_READ_RUN	SZ_1G
+
+/*
+ * Read @size bytes at @offset in the file. Uncompressed extents which follow
+ * each other on the device are read together, as one run. Holes, whether
+ * given by an extent or by a gap between extents, and preallocated extents
+ * read as zeroes.
+ */
 u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 		    u64 size, char *buf)
 {
 	struct btrfs_path path;
-	struct btrfs_key key;
+	struct btrfs_key key, *found;
 	struct btrfs_file_extent_item *extent;
+	u64 pos = offset, end = offset + size, ext_end, len, logical, physical;
+	u64 run_logical = 0, run_physical = 0, run_len = 0;
+	char *out, *run_out = NULL;
 	int res = 0;
-	u64 rd, rd_all = -1ULL;
 
 	key.objectid = inr;
 	key.type = BTRFS_EXTENT_DATA_KEY;
@@ -332,18 +347,19 @@ u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 	if (btrfs_search_tree(root, &key, &path))
 		return -1ULL;
 
-	if (btrfs_comp_keys(&key, btrfs_path_leaf_key(&path)) < 0) {
-		if (btrfs_prev_slot(&path))
-			goto out;
-
-		if (btrfs_comp_keys_type(&key, btrfs_path_leaf_key(&path)))
-			goto out;
+	/* The extent containing @offset may start before it */
+	if (path.slots[0] >= path.nodes[0]->leaf.header.nritems ||
+	    btrfs_comp_keys(&key, btrfs_path_leaf_key(&path)) < 0) {
+		if (btrfs_prev_slot(&path) < 0)
+			goto err;
 	}
 
-	rd_all = 0;
-
 	do {
-		if (btrfs_comp_keys_type(&key, btrfs_path_leaf_key(&path)))
+		found = btrfs_path_leaf_key(&path);
+		if (btrfs_comp_keys_type(&key, found) > 0)
+			continue;
+		if (btrfs_comp_keys_type(&key, found) < 0 ||
+		    found->offset >= end)
 			break;
 
 		extent = btrfs_path_item_ptr(&path,
@@ -351,33 +367,81 @@ u64 btrfs_file_read(const struct btrfs_root *root, u64 inr, u64 offset,
 
 		if (extent->type == BTRFS_FILE_EXTENT_INLINE) {
 			btrfs_file_extent_item_to_cpu_inl(extent);
-			rd = btrfs_read_extent_inline(&path, extent, offset,
-						      size, buf);
+			ext_end = found->offset + extent->ram_bytes;
 		} else {
 			btrfs_file_extent_item_to_cpu(extent);
-			rd = btrfs_read_extent_reg(&path, extent, offset, size,
-						   buf);
+			ext_end = found->offset + extent->num_bytes;
 		}
 
-		if (rd == -1ULL) {
-			printf("%s: Error reading extent\n", __func__);
-			rd_all = -1;
-			goto out;
+		if (ext_end <= pos)
+			continue;
+
+		if (found->offset > pos) {
+			memset(buf + (pos - offset), 0, found->offset - pos);
+			pos = found->offset;
 		}
 
-		offset = 0;
-		buf += rd;
-		rd_all += rd;
-		size -= rd;
+		len = min(ext_end, end) - pos;
+		out = buf + (pos - offset);
 
-		if (!size)
-			break;
-	} while (!(res = btrfs_next_slot(&path)));
+		if (extent->type == BTRFS_FILE_EXTENT_INLINE) {
+			if (btrfs_read_extent_inline(&path, extent,
+						     pos - found->offset, len,
+						     out) == -1ULL)
+				goto err;
+		} else if (extent->type == BTRFS_FILE_EXTENT_PREALLOC ||
+			   !extent->disk_bytenr) {
+			memset(out, 0, len);
+		} else if (extent->compression != BTRFS_COMPRESS_NONE) {
+			if (btrfs_read_extent_reg(&path, extent,
+						  pos - found->offset, len,
+						  out) == -1ULL)
+				goto err;
+		} else {
+			logical = extent->disk_bytenr + extent->offset
+				  + (pos - found->offset);
+			physical = btrfs_map_logical_to_physical(logical);
+			if (physical == -1ULL)
+				goto err;
+
+			if (run_len && run_logical + run_len == logical &&
+			    run_physical + run_len == physical &&
+			    run_out + run_len == out &&
+			    run_len + len <= BTRFS_MAX_READ_RUN) {
+				run_len += len;
+			} else {
+				if (run_len &&
+				    btrfs_read_extent_run(run_logical,
+							  run_physical,
+							  run_len, run_out))
+					goto err;
+
+				run_logical = logical;
+				run_physical = physical;
+				run_len = len;
+				run_out = out;
+			}
+		}
 
-	if (res)
-		return -1ULL;
+		pos += len;
+	} while (pos < end && !(res = btrfs_next_slot(&path)));
 
-out:
+	if (res < 0)
+		goto err;
+
+	if (run_len && btrfs_read_extent_run(run_logical, run_physical,
+					     run_len, run_out))
+		goto err;
+
+	/* Past the last extent is a hole too */
+	if (pos < end)
+		memset(buf + (pos - offset), 0, end - pos);
+
+	btrfs_free_path(&path);
+	return size;
+
+err:
+	printf("%s: Error reading extent\n", __func__);
 	btrfs_free_path(&path);
-	return rd_all;
+	return -1ULL;
 }
@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Read-only EROFS support
+ *
+ * Directories are searched by bisecting their blocks, whose entries are
+ * sorted by name, so that only a few blocks of a large directory are read.
+ * Compressed files are read by zmap.c.
+ */
+
+#include <common.h>
+#include <erofs.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <linux/errno.h>
+#include <linux/stat.h>
+#include "internal.h"
+
+struct erofs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct erofs_inode dir;
+	u64 blk;		/* block of the directory in buf */
+	u32 size;		/* bytes of it used */
+	int count;		/* entries in it */
+	int next;		/* entry to return next */
+	char *buf;
+};
+
+struct erofs_sb_info *erofs_sbi;
+
+int erofs_devread(u64 addr, u64 len, void *buf)
+{
+	return fs_read_range(erofs_sbi->desc, &erofs_sbi->part, addr, len, buf);
+}
+
+static int erofs_read_inode(u64 nid, struct erofs_inode *inode)
+{
+	union {
+		struct erofs_inode_compact c;
+		struct erofs_inode_extended e;
+	} di;
+	u16 format, icount;
+	int ret;
+
+	inode->nid = nid;
+	inode->pos = erofs_sbi->meta_addr + (nid << EROFS_ISLOTBITS);
+	ret = erofs_devread(inode->pos, sizeof(di.c), &di.c);
+	if (ret)
+		return ret;
+
+	format = le16_to_cpu(di.c.i_format);
+	inode->datalayout = format >> EROFS_I_DATALAYOUT_BIT &
+			    EROFS_I_DATALAYOUT_MASK;
+	if (inode->datalayout > EROFS_INODE_FLAT_COMPRESSION) {
+		printf("erofs: unsupported data layout %u\n",
+		       inode->datalayout);
+		return -EOPNOTSUPP;
+	}
+
+	if (format & EROFS_I_VERSION_EXTENDED) {
+		ret = erofs_devread(inode->pos, sizeof(di.e), &di.e);
+		if (ret)
+			return ret;
+		inode->inode_isize = sizeof(di.e);
+		inode->mode = le16_to_cpu(di.e.i_mode);
+		inode->size = le64_to_cpu(di.e.i_size);
+		inode->raw_blkaddr = le32_to_cpu(di.e.i_u);
+	} else {
+		inode->inode_isize = sizeof(di.c);
+		inode->mode = le16_to_cpu(di.c.i_mode);
+		inode->size = le32_to_cpu(di.c.i_size);
+		inode->raw_blkaddr = le32_to_cpu(di.c.i_u);
+	}
+
+	/* The xattrs are only skipped, to find the inline data after them */
+	icount = le16_to_cpu(di.c.i_xattr_icount);
+	inode->xattr_isize = 0;
+	if (icount)
+		inode->xattr_isize = sizeof(struct erofs_xattr_ibody_header) +
+				     (icount - 1) * sizeof(__le32);
+
+	if (erofs_inode_compressed(inode))
+		return z_erofs_fill_inode(inode);
+
+	return 0;
+}
+
+/*
+ * Read @len bytes at @offset of @inode into @buf. The data blocks of
+ * uncompressed files follow each other, but for an inline last block kept
+ * just after the inode.
+ */
+static int erofs_read_data(const struct erofs_inode *inode, u64 offset,
+			   u64 len, char *buf)
+{
+	u64 end = offset + len, tail, n;
+	int ret;
+
+	if (erofs_inode_compressed(inode))
+		return z_erofs_read_data(inode, offset, len, buf);
+
+	tail = inode->size;
+	if (inode->datalayout == EROFS_INODE_FLAT_INLINE && inode->size)
+		tail = round_down(inode->size - 1, EROFS_BLKSZ);
+
+	if (offset < min(end, tail)) {
+		n = min(end, tail) - offset;
+		ret = erofs_devread(erofs_pos(inode->raw_blkaddr) + offset, n,
+				    buf);
+		if (ret)
+			return ret;
+		offset += n;
+		buf += n;
+	}
+	if (offset == end)
+		return 0;
+
+	if ((erofs_inode_end(inode) & (EROFS_BLKSZ - 1)) + inode->size - tail >
+	    EROFS_BLKSZ)
+		return -EIO;
+
+	return erofs_devread(erofs_inode_end(inode) + offset - tail,
+			     end - offset, buf);
+}
+
+/*
+ * Read block @blk of directory @dir into @buf, setting *@sizep to the
+ * bytes of it used. Returns the number of entries in it, or -ve on error.
+ */
+static int erofs_dir_block(const struct erofs_inode *dir, u64 blk, char *buf,
+			   u32 *sizep)
+{
+	const struct erofs_dirent *de = (const struct erofs_dirent *)buf;
+	u32 size, nameoff;
+	int ret;
+
+	size = min_t(u64, EROFS_BLKSZ, dir->size - erofs_pos(blk));
+	ret = erofs_read_data(dir, erofs_pos(blk), size, buf);
+	if (ret)
+		return ret;
+
+	nameoff = le16_to_cpu(de->nameoff);
+	if (nameoff < sizeof(*de) || nameoff % sizeof(*de) || nameoff >= size)
+		return -EIO;
+	*sizep = size;
+
+	return nameoff / sizeof(*de);
+}
+
+/* Find the name of entry @i of the @count in a directory block */
+static const char *erofs_dirent_name(const char *buf, u32 size, int i,
+				     int count, u32 *lenp)
+{
+	const struct erofs_dirent *de = (const struct erofs_dirent *)buf;
+	u32 start = le16_to_cpu(de[i].nameoff), end = size;
+
+	if (i + 1 < count)
+		end = le16_to_cpu(de[i + 1].nameoff);
+	if (start < count * sizeof(*de) || start >= end || end > size)
+		return NULL;
+
+	/* The last name may be padded with zeroes */
+	*lenp = end - start;
+	if (i + 1 == count)
+		*lenp = strnlen(buf + start, end - start);
+	if (!*lenp || *lenp > EROFS_NAME_LEN)
+		return NULL;
+
+	return buf + start;
+}
+
+static int erofs_namecmp(const char *name, u32 len, const char *ename,
+			 u32 elen)
+{
+	int ret = memcmp(name, ename, min(len, elen));
+
+	return ret ? ret : (int)len - (int)elen;
+}
+
+/*
+ * Look @name up in directory @dir. Entries are sorted across blocks, so
+ * find the last block starting with a name not after it, then bisect that.
+ */
+static int erofs_dir_lookup(const struct erofs_inode *dir, const char *name,
+			    u32 len, u64 *nidp)
+{
+	const struct erofs_dirent *de;
+	u64 lo = 0, hi, mid, blk = -1ULL;
+	int count = 0, first, last, i, cmp, ret;
+	const char *ename;
+	u32 size, elen;
+	char *buf;
+
+	if (!S_ISDIR(dir->mode))
+		return -ENOTDIR;
+	if (!dir->size)
+		return -ENOENT;
+
+	buf = malloc(EROFS_BLKSZ);
+	if (!buf)
+		return -ENOMEM;
+	de = (const struct erofs_dirent *)buf;
+
+	hi = DIV_ROUND_UP(dir->size, EROFS_BLKSZ) - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		count = erofs_dir_block(dir, mid, buf, &size);
+		if (count < 0) {
+			ret = count;
+			goto out;
+		}
+		blk = mid;
+
+		ename = erofs_dirent_name(buf, size, 0, count, &elen);
+		if (!ename) {
+			ret = -EIO;
+			goto out;
+		}
+		if (erofs_namecmp(name, len, ename, elen) < 0)
+			hi = mid - 1;
+		else
+			lo = mid;
+	}
+	if (blk != lo) {
+		count = erofs_dir_block(dir, lo, buf, &size);
+		if (count < 0) {
+			ret = count;
+			goto out;
+		}
+	}
+
+	ret = -ENOENT;
+	for (first = 0, last = count - 1; first <= last;) {
+		i = (first + last) / 2;
+		ename = erofs_dirent_name(buf, size, i, count, &elen);
+		if (!ename) {
+			ret = -EIO;
+			break;
+		}
+		cmp = erofs_namecmp(name, len, ename, elen);
+		if (!cmp) {
+			*nidp = le64_to_cpu(de[i].nid);
+			ret = 0;
+			break;
+		}
+		if (cmp < 0)
+			last = i - 1;
+		else
+			first = i + 1;
+	}
+
+out:
+	free(buf);
+	return ret;
+}
+
+static int erofs_walk_root(void *inode)
+{
+	return erofs_read_inode(erofs_sbi->root_nid, inode);
+}
+
+/* "." and ".." are real directory entries, found like any other */
+static int erofs_walk_lookup(void *inode, const char *name, int len)
+{
+	u64 nid;
+	int ret;
+
+	ret = erofs_dir_lookup(inode, name, len, &nid);
+	if (ret)
+		return ret;
+
+	return erofs_read_inode(nid, inode);
+}
+
+static bool erofs_walk_is_link(const void *inode, u64 *sizep)
+{
+	const struct erofs_inode *ei = inode;
+
+	*sizep = ei->size;
+
+	return S_ISLNK(ei->mode);
+}
+
+static int erofs_walk_read_link(void *inode, char *buf, u64 size)
+{
+	return erofs_read_data(inode, 0, size, buf);
+}
+
+static const struct fs_walk_ops erofs_walk_ops = {
+	.root		= erofs_walk_root,
+	.lookup		= erofs_walk_lookup,
+	.is_link	= erofs_walk_is_link,
+	.read_link	= erofs_walk_read_link,
+};
+
+static int erofs_lookup(const char *path, struct erofs_inode *inode)
+{
+	return fs_walk_path(path, inode, &erofs_walk_ops);
+}
+
+void erofs_close(void)
+{
+	if (!erofs_sbi)
+		return;
+
+	free(erofs_sbi->zbuf);
+	free(erofs_sbi->ibuf);
+	free(erofs_sbi);
+	erofs_sbi = NULL;
+}
+
+int erofs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct erofs_super_block sb;
+	u32 incompat;
+
+	erofs_close();
+
+	if (!fs_devread(fs_dev_desc, fs_partition, 0, EROFS_SUPER_OFFSET,
+			sizeof(sb), (char *)&sb))
+		return -EIO;
+	if (le32_to_cpu(sb.magic) != EROFS_SUPER_MAGIC)
+		return -EINVAL;
+
+	incompat = le32_to_cpu(sb.feature_incompat);
+	if (sb.blkszbits < EROFS_MIN_BLKSZBITS ||
+	    sb.blkszbits > EROFS_MAX_BLKSZBITS) {
+		printf("erofs: unsupported block size %u\n", 1 << sb.blkszbits);
+		return -EINVAL;
+	}
+	if (incompat & ~EROFS_ALL_FEATURE_INCOMPAT) {
+		printf("erofs: unsupported features %x\n",
+		       incompat & ~EROFS_ALL_FEATURE_INCOMPAT);
+		return -EOPNOTSUPP;
+	}
+
+	erofs_sbi = calloc(1, sizeof(*erofs_sbi));
+	if (!erofs_sbi)
+		return -ENOMEM;
+	erofs_sbi->desc = fs_dev_desc;
+	erofs_sbi->part = *fs_partition;
+	erofs_sbi->blkszbits = sb.blkszbits;
+	erofs_sbi->meta_addr = erofs_pos(le32_to_cpu(sb.meta_blkaddr));
+	erofs_sbi->root_nid = le16_to_cpu(sb.root_nid);
+	erofs_sbi->feature_incompat = incompat;
+	memcpy(erofs_sbi->uuid, sb.uuid, sizeof(sb.uuid));
+	erofs_sbi->ibuf_blk = -1ULL;
+	erofs_sbi->zbuf_pblk = -1ULL;
+
+	erofs_sbi->ibuf = malloc(EROFS_BLKSZ);
+	if (!erofs_sbi->ibuf) {
+		erofs_close();
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int erofs_is_mounted(struct blk_desc *fs_dev_desc,
+		     disk_partition_t *fs_partition)
+{
+	return erofs_sbi && erofs_sbi->desc == fs_dev_desc &&
+	       erofs_sbi->part.start == fs_partition->start &&
+	       erofs_sbi->part.size == fs_partition->size;
+}
+
+int erofs_exists(const char *filename)
+{
+	struct erofs_inode inode;
+
+	return !erofs_lookup(filename, &inode);
+}
+
+int erofs_size(const char *filename, loff_t *size)
+{
+	struct erofs_inode inode;
+	int ret;
+
+	ret = erofs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+	if (!S_ISREG(inode.mode))
+		return -EISDIR;
+	*size = inode.size;
+
+	return 0;
+}
+
+int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	       loff_t *actread)
+{
+	struct erofs_inode inode;
+	int ret;
+
+	*actread = 0;
+	ret = erofs_lookup(filename, &inode);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		return ret;
+	}
+	if (!S_ISREG(inode.mode))
+		return -EISDIR;
+
+	if (offset >= inode.size)
+		return 0;
+	if (!len || len > inode.size - offset)
+		len = inode.size - offset;
+
+	ret = erofs_read_data(&inode, offset, len, buf);
+	if (ret) {
+		printf("** Error reading file %s **\n", filename);
+		return ret;
+	}
+	*actread = len;
+
+	return 0;
+}
+
+int erofs_uuid(char *uuid_str)
+{
+#ifdef CONFIG_LIB_UUID
+	if (!erofs_sbi)
+		return -ENODEV;
+	uuid_bin_to_str(erofs_sbi->uuid, uuid_str, UUID_STR_FORMAT_STD);
+	return 0;
+#endif
+	return -ENOSYS;
+}
+
+int erofs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct erofs_dir_stream *dirs;
+	int ret;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+
+	ret = erofs_lookup(filename, &dirs->dir);
+	if (!ret && !S_ISDIR(dirs->dir.mode))
+		ret = -ENOTDIR;
+	if (!ret) {
+		dirs->buf = malloc(EROFS_BLKSZ);
+		if (!dirs->buf)
+			ret = -ENOMEM;
+	}
+	if (ret) {
+		free(dirs);
+		return ret;
+	}
+	dirs->blk = -1ULL;
+	*dirsp = &dirs->parent;
+
+	return 0;
+}
+
+int erofs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+	const struct erofs_dirent *de = (const struct erofs_dirent *)dirs->buf;
+	struct fs_dirent *dent = &dirs->dirent;
+	struct erofs_inode inode;
+	const char *name;
+	u32 len;
+	int ret;
+
+	while (dirs->next >= dirs->count) {
+		if (erofs_pos(dirs->blk + 1) >= dirs->dir.size)
+			return -ENOENT;
+		ret = erofs_dir_block(&dirs->dir, dirs->blk + 1, dirs->buf,
+				      &dirs->size);
+		if (ret < 0)
+			return ret;
+		dirs->blk++;
+		dirs->count = ret;
+		dirs->next = 0;
+	}
+
+	name = erofs_dirent_name(dirs->buf, dirs->size, dirs->next,
+				 dirs->count, &len);
+	if (!name)
+		return -EIO;
+	memcpy(dent->name, name, len);
+	dent->name[len] = '\0';
+
+	dent->size = 0;
+	switch (de[dirs->next].file_type) {
+	case EROFS_FT_DIR:
+		dent->type = FS_DT_DIR;
+		break;
+	case EROFS_FT_SYMLINK:
+		dent->type = FS_DT_LNK;
+		break;
+	case EROFS_FT_REG_FILE:
+		ret = erofs_read_inode(le64_to_cpu(de[dirs->next].nid),
+				       &inode);
+		if (ret)
+			return ret;
+		dent->size = inode.size;
+		/* fall through */
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+	dirs->next++;
+	*dentp = dent;
+
+	return 0;
+}
+
+void erofs_closedir(struct fs_dir_stream *fs_dirs)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+
+	free(dirs->buf);
+	free(dirs);
+}
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS on-disk format
+ *
+ * Based on fs/erofs/erofs_fs.h from Linux
+ * Copyright (C) 2017-2018 HUAWEI, Inc.
+ */
+
+#ifndef __EROFS_FS_H__
+#define __EROFS_FS_H__
+
+#include <linux/types.h>
+
+#define EROFS_SUPER_MAGIC		0xe0f5e1e2
+#define EROFS_SUPER_OFFSET		1024
+
+#define EROFS_MIN_BLKSZBITS		9
+#define EROFS_MAX_BLKSZBITS		16
+
+/* Compressed data is stored at the end of each physical cluster */
+#define EROFS_FEATURE_INCOMPAT_LZ4_0PADDING	0x00000001
+#define EROFS_ALL_FEATURE_INCOMPAT	EROFS_FEATURE_INCOMPAT_LZ4_0PADDING
+
+struct erofs_super_block {
+	__le32 magic;
+	__le32 checksum;
+	__le32 feature_compat;
+	__u8 blkszbits;
+	__u8 reserved;
+	__le16 root_nid;
+	__le64 inos;
+	__le64 build_time;
+	__le32 build_time_nsec;
+	__le32 blocks;
+	__le32 meta_blkaddr;
+	__le32 xattr_blkaddr;
+	__u8 uuid[16];
+	__u8 volume_name[16];
+	__le32 feature_incompat;
+	__u8 reserved2[44];
+} __packed;
+
+/* Inode numbers (nids) count 32-byte slots from the metadata area start */
+#define EROFS_ISLOTBITS			5
+
+/* i_format: bit 0 is the inode version, bits 1-3 the data layout */
+#define EROFS_I_VERSION_EXTENDED	1
+#define EROFS_I_DATALAYOUT_BIT		1
+#define EROFS_I_DATALAYOUT_MASK		7
+
+/* Data layouts */
+#define EROFS_INODE_FLAT_PLAIN			0
+#define EROFS_INODE_FLAT_COMPRESSION_LEGACY	1
+#define EROFS_INODE_FLAT_INLINE			2
+#define EROFS_INODE_FLAT_COMPRESSION		3
+
+struct erofs_inode_compact {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_nlink;
+	__le32 i_size;
+	__le32 i_reserved;
+	/* Compressed blocks, or address of the first data block */
+	__le32 i_u;
+	__le32 i_ino;
+	__le16 i_uid;
+	__le16 i_gid;
+	__le32 i_reserved2;
+} __packed;
+
+struct erofs_inode_extended {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_reserved;
+	__le64 i_size;
+	__le32 i_u;
+	__le32 i_ino;
+	__le32 i_uid;
+	__le32 i_gid;
+	__le64 i_ctime;
+	__le32 i_ctime_nsec;
+	__le32 i_nlink;
+	__u8 i_reserved2[16];
+} __packed;
+
+/*
+ * Starts the xattrs kept after an inode, if i_xattr_icount is not zero.
+ * Followed by h_shared_count 32-bit indexes of shared xattrs, then by the
+ * inline ones, i_xattr_icount - 1 32-bit slots in all.
+ */
+struct erofs_xattr_ibody_header {
+	__le32 h_reserved;
+	__u8 h_shared_count;
+	__u8 h_reserved2[7];
+} __packed;
+
+/*
+ * Directory blocks start with the entries, the nameoff of the first giving
+ * their number. The names follow, not terminated except by the start of the
+ * next one, or by zero padding or the block end for the last one.
+ */
+struct erofs_dirent {
+	__le64 nid;
+	__le16 nameoff;
+	__u8 file_type;
+	__u8 reserved;
+} __packed;
+
+#define EROFS_FT_UNKNOWN		0
+#define EROFS_FT_REG_FILE		1
+#define EROFS_FT_DIR			2
+#define EROFS_FT_SYMLINK		7
+
+#define EROFS_NAME_LEN			255
+
+/*
+ * Compressed files are split into logical clusters of one block, each
+ * described by an index. A HEAD or PLAIN index starts a new extent at
+ * clusterofs in its cluster, whose data is the physical block at blkaddr,
+ * compressed or not. NONHEAD clusters carry on the extent started before.
+ */
+#define Z_EROFS_CLUSTER_TYPE_PLAIN	0
+#define Z_EROFS_CLUSTER_TYPE_HEAD	1
+#define Z_EROFS_CLUSTER_TYPE_NONHEAD	2
+#define Z_EROFS_CLUSTER_TYPE_MASK	3
+
+#define Z_EROFS_COMPRESSION_LZ4		0
+
+#define Z_EROFS_ADVISE_COMPACTED_2B	0x0001
+
+/* Found after the inode and its xattrs, 8-byte aligned */
+struct z_erofs_map_header {
+	__le32 h_reserved1;
+	__le16 h_advise;
+	/* bits 0-3: compression of HEAD clusters */
+	__u8 h_algorithmtype;
+	/*
+	 * bits 0-2: logical cluster bits - 12
+	 * bits 3-7: physical cluster bits - logical cluster bits
+	 */
+	__u8 h_clusterbits;
+} __packed;
+
+/* Indexes of EROFS_INODE_FLAT_COMPRESSION_LEGACY files, after the header */
+#define Z_EROFS_LEGACY_HEADER_PADDING	8
+
+struct z_erofs_vle_decompressed_index {
+	__le16 di_advise;
+	__le16 di_clusterofs;
+	union {
+		__le32 blkaddr;
+		/* NONHEAD: distances back to the HEAD and on to the next */
+		__le16 delta[2];
+	} di_u;
+} __packed;
+
+#endif /* __EROFS_FS_H__ */
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS internal definitions, shared by the parts of the driver
+ */
+
+#ifndef __EROFS_INTERNAL_H__
+#define __EROFS_INTERNAL_H__
+
+#include <part.h>
+#include "erofs_fs.h"
+
+/**
+ * struct erofs_sb_info - A mounted filesystem
+ *
+ * @desc: Block device holding it
+ * @part: Partition holding it
+ * @blkszbits: log2 of the filesystem block size
+ * @meta_addr: Position of the metadata area, that nids count from
+ * @root_nid: nid of the root directory
+ * @feature_incompat: EROFS_FEATURE_INCOMPAT_... flags
+ * @uuid: Filesystem UUID
+ * @ibuf: Block of compression indexes last read, see z_erofs_index_block()
+ * @ibuf_blk: Block number in @ibuf, -1 if none
+ * @zbuf: Extent last decompressed, if not straight into the read buffer
+ * @zbuf_size: Size of @zbuf
+ * @zbuf_pblk: Physical block it was decompressed from, -1 if none
+ */
+struct erofs_sb_info {
+	struct blk_desc *desc;
+	disk_partition_t part;
+	u8 blkszbits;
+	u64 meta_addr;
+	u64 root_nid;
+	u32 feature_incompat;
+	u8 uuid[16];
+	char *ibuf;
+	u64 ibuf_blk;
+	char *zbuf;
+	u32 zbuf_size;
+	u64 zbuf_pblk;
+};
+
+extern struct erofs_sb_info *erofs_sbi;
+
+#define EROFS_BLKSZ		(1U << erofs_sbi->blkszbits)
+#define erofs_pos(blk)		((u64)(blk) << erofs_sbi->blkszbits)
+
+/**
+ * struct erofs_inode - An inode, as needed to read it
+ *
+ * @nid: Inode number
+ * @pos: Position of the inode on the device
+ * @mode: File type and permissions
+ * @datalayout: EROFS_INODE_... data layout
+ * @inode_isize: Size of the on-disk inode, compact or extended
+ * @xattr_isize: Size of the xattrs kept after it
+ * @size: File size
+ * @raw_blkaddr: First data block, for uncompressed files
+ * @z_advise: Z_EROFS_ADVISE_... flags of compressed files
+ * @z_lclusterbits: log2 of their logical cluster size
+ */
+struct erofs_inode {
+	u64 nid;
+	u64 pos;
+	u16 mode;
+	u8 datalayout;
+	u8 inode_isize;
+	u32 xattr_isize;
+	u64 size;
+	u32 raw_blkaddr;
+	u16 z_advise;
+	u8 z_lclusterbits;
+};
+
+/* Position of what follows the inode and its xattrs */
+static inline u64 erofs_inode_end(const struct erofs_inode *inode)
+{
+	return inode->pos + inode->inode_isize + inode->xattr_isize;
+}
+
+static inline bool erofs_inode_compressed(const struct erofs_inode *inode)
+{
+	return inode->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY ||
+	       inode->datalayout == EROFS_INODE_FLAT_COMPRESSION;
+}
+
+/* erofs.c */
+int erofs_devread(u64 addr, u64 len, void *buf);
+
+/* zmap.c */
+int z_erofs_fill_inode(struct erofs_inode *inode);
+int z_erofs_read_data(const struct erofs_inode *inode, u64 offset, u64 len,
+		      char *buf);
+
+#endif /* __EROFS_INTERNAL_H__ */
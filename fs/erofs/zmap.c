@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Reading of EROFS compressed files
+ *
+ * Based on fs/erofs/zmap.c from Linux
+ * Copyright (C) 2018-2019 HUAWEI, Inc.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/errno.h>
+#include <asm/unaligned.h>
+#include "internal.h"
+
+/* Most physical clusters read from the device at once */
+#define Z_EROFS_READ_RUN	32
+
+/* A logical cluster index, decoded */
+struct z_erofs_index {
+	u8 type;
+	u32 clusterofs;
+	u32 pblk;
+	u32 delta0;		/* NONHEAD: clusters back to the HEAD */
+};
+
+/**
+ * struct z_erofs_extent - A run of file data compressed together
+ *
+ * @la: Position of the start of the extent in the file
+ * @end: Position of its end
+ * @pblk: Physical cluster holding it
+ * @plain: true if it is stored uncompressed
+ */
+struct z_erofs_extent {
+	u64 la;
+	u64 end;
+	u32 pblk;
+	bool plain;
+};
+
+int z_erofs_fill_inode(struct erofs_inode *inode)
+{
+	struct z_erofs_map_header h;
+	int ret;
+
+	if (!(erofs_sbi->feature_incompat &
+	      EROFS_FEATURE_INCOMPAT_LZ4_0PADDING)) {
+		printf("erofs: compressed files need lz4_0padding\n");
+		return -EOPNOTSUPP;
+	}
+
+	/* Old-style files have the default layout, whatever the header says */
+	if (inode->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY) {
+		inode->z_advise = 0;
+		inode->z_lclusterbits = erofs_sbi->blkszbits;
+		return 0;
+	}
+
+	ret = erofs_devread(round_up(erofs_inode_end(inode), 8), sizeof(h), &h);
+	if (ret)
+		return ret;
+	inode->z_advise = le16_to_cpu(h.h_advise);
+	inode->z_lclusterbits = 12 + (h.h_clusterbits & 7);
+
+	/* Compacted indexes are only defined for 4KiB clusters */
+	if ((h.h_algorithmtype & 0xf) != Z_EROFS_COMPRESSION_LZ4 ||
+	    h.h_clusterbits >> 3 ||
+	    inode->z_advise & ~Z_EROFS_ADVISE_COMPACTED_2B ||
+	    inode->z_lclusterbits != 12 ||
+	    inode->z_lclusterbits != erofs_sbi->blkszbits) {
+		printf("erofs: unsupported compressed file layout\n");
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+/* Point @p at the index data at @pos, reading its block if needed */
+static int z_erofs_index_block(u64 pos, const u8 **p)
+{
+	u64 blk = pos >> erofs_sbi->blkszbits;
+	int ret;
+
+	if (erofs_sbi->ibuf_blk != blk) {
+		ret = erofs_devread(erofs_pos(blk), EROFS_BLKSZ,
+				    erofs_sbi->ibuf);
+		if (ret) {
+			erofs_sbi->ibuf_blk = -1ULL;
+			return ret;
+		}
+		erofs_sbi->ibuf_blk = blk;
+	}
+	*p = (u8 *)erofs_sbi->ibuf + (pos & (EROFS_BLKSZ - 1));
+
+	return 0;
+}
+
+static int z_erofs_load_legacy(const struct erofs_inode *inode, u64 lcn,
+			       struct z_erofs_index *idx)
+{
+	const struct z_erofs_vle_decompressed_index *di;
+	u64 pos;
+	int ret;
+
+	pos = round_up(erofs_inode_end(inode), 8) +
+	      sizeof(struct z_erofs_map_header) +
+	      Z_EROFS_LEGACY_HEADER_PADDING + lcn * sizeof(*di);
+	ret = z_erofs_index_block(pos, (const u8 **)&di);
+	if (ret)
+		return ret;
+
+	idx->type = le16_to_cpu(di->di_advise) & Z_EROFS_CLUSTER_TYPE_MASK;
+	switch (idx->type) {
+	case Z_EROFS_CLUSTER_TYPE_NONHEAD:
+		idx->clusterofs = 1 << inode->z_lclusterbits;
+		idx->delta0 = le16_to_cpu(di->di_u.delta[0]);
+		break;
+	case Z_EROFS_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_CLUSTER_TYPE_HEAD:
+		idx->clusterofs = le16_to_cpu(di->di_clusterofs);
+		idx->pblk = le32_to_cpu(di->di_u.blkaddr);
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static u32 z_erofs_decode_bits(const u8 *in, u32 pos, u8 lbits, u8 *type)
+{
+	u32 v = get_unaligned_le32(in + pos / 8) >> (pos & 7);
+
+	*type = (v >> lbits) & Z_EROFS_CLUSTER_TYPE_MASK;
+
+	return v & ((1 << lbits) - 1);
+}
+
+/*
+ * Compacted indexes come in packs of 2 (4 bytes each) or 16 (2 bytes each)
+ * bit-packed entries followed by a block address. The pack starts with as
+ * many 4-byte indexes as needed to align to 32 bytes, then has 2-byte ones
+ * if the file has Z_EROFS_ADVISE_COMPACTED_2B, ending with 4-byte ones.
+ */
+static int z_erofs_load_compacted(const struct erofs_inode *inode, u64 lcn,
+				  struct z_erofs_index *idx)
+{
+	const u8 lbits = inode->z_lclusterbits;
+	const u64 ebase = round_up(erofs_inode_end(inode), 8) +
+			  sizeof(struct z_erofs_map_header);
+	const u64 totalidx = DIV_ROUND_UP(inode->size, 1ULL << lbits);
+	u32 initial_4b, compacted_2b, shift, vcnt, encodebits, eofs, base;
+	u32 lo, nblk;
+	const u8 *in;
+	u64 pos;
+	u8 type;
+	int i, ret;
+
+	initial_4b = (32 - ebase % 32) / 4;
+	if (initial_4b == 32 / 4)
+		initial_4b = 0;
+	compacted_2b = 0;
+	if (inode->z_advise & Z_EROFS_ADVISE_COMPACTED_2B &&
+	    initial_4b < totalidx)
+		compacted_2b = rounddown(totalidx - initial_4b, 16);
+
+	pos = ebase;
+	shift = 2;
+	if (lcn >= initial_4b) {
+		pos += initial_4b * 4;
+		lcn -= initial_4b;
+		if (lcn < compacted_2b) {
+			shift = 1;
+		} else {
+			pos += compacted_2b * 2;
+			lcn -= compacted_2b;
+		}
+	}
+	pos += lcn << shift;
+
+	vcnt = shift == 2 ? 2 : 16;
+	encodebits = ((vcnt << shift) - sizeof(__le32)) * 8 / vcnt;
+	eofs = pos & (EROFS_BLKSZ - 1);
+	base = round_down(eofs, vcnt << shift);
+	ret = z_erofs_index_block(pos - (eofs - base), &in);
+	if (ret)
+		return ret;
+	i = (eofs - base) >> shift;
+
+	lo = z_erofs_decode_bits(in, encodebits * i, lbits, &type);
+	idx->type = type;
+	if (type == Z_EROFS_CLUSTER_TYPE_NONHEAD) {
+		idx->clusterofs = 1 << lbits;
+		if (i + 1 != vcnt) {
+			idx->delta0 = lo;
+			return 0;
+		}
+		/*
+		 * The last index of a pack holds the distance to the next HEAD
+		 * instead, so work the distance back out from the one before
+		 */
+		lo = z_erofs_decode_bits(in, encodebits * (i - 1), lbits,
+					 &type);
+		if (type != Z_EROFS_CLUSTER_TYPE_NONHEAD)
+			lo = 0;
+		idx->delta0 = lo + 1;
+		return 0;
+	}
+	if (type != Z_EROFS_CLUSTER_TYPE_PLAIN &&
+	    type != Z_EROFS_CLUSTER_TYPE_HEAD)
+		return -EOPNOTSUPP;
+	idx->clusterofs = lo;
+
+	/* Physical clusters follow each other, one per HEAD in the pack */
+	nblk = 1;
+	while (i > 0) {
+		--i;
+		lo = z_erofs_decode_bits(in, encodebits * i, lbits, &type);
+		if (type == Z_EROFS_CLUSTER_TYPE_NONHEAD)
+			i -= lo;
+		if (i >= 0)
+			++nblk;
+	}
+	idx->pblk = get_unaligned_le32(in + (vcnt << shift) - sizeof(__le32)) +
+		    nblk;
+
+	return 0;
+}
+
+static int z_erofs_load_index(const struct erofs_inode *inode, u64 lcn,
+			      struct z_erofs_index *idx)
+{
+	if (lcn >= DIV_ROUND_UP(inode->size, 1ULL << inode->z_lclusterbits))
+		return -EIO;
+
+	if (inode->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY)
+		return z_erofs_load_legacy(inode, lcn, idx);
+
+	return z_erofs_load_compacted(inode, lcn, idx);
+}
+
+/* Find the extent of @inode holding position @la */
+static int z_erofs_map(const struct erofs_inode *inode, u64 la,
+		       struct z_erofs_extent *ext)
+{
+	const u8 lbits = inode->z_lclusterbits;
+	const u64 totalidx = DIV_ROUND_UP(inode->size, 1ULL << lbits);
+	struct z_erofs_index idx, head;
+	u64 lcn = la >> lbits, hlcn = lcn, n;
+	bool end_known = false;
+	u32 dist;
+	int ret;
+
+	ret = z_erofs_load_index(inode, lcn, &idx);
+	if (ret)
+		return ret;
+
+	head = idx;
+	if (idx.type == Z_EROFS_CLUSTER_TYPE_NONHEAD ||
+	    (la & ((1 << lbits) - 1)) < idx.clusterofs) {
+		if (idx.type == Z_EROFS_CLUSTER_TYPE_NONHEAD) {
+			dist = idx.delta0;
+		} else {
+			/* @la is before the extent starting in this cluster */
+			ext->end = lcn << lbits | idx.clusterofs;
+			end_known = true;
+			dist = 1;
+		}
+
+		/* Look back for the HEAD of the extent */
+		for (;;) {
+			if (!dist || dist > hlcn)
+				return -EIO;
+			hlcn -= dist;
+			ret = z_erofs_load_index(inode, hlcn, &head);
+			if (ret)
+				return ret;
+			if (head.type != Z_EROFS_CLUSTER_TYPE_NONHEAD)
+				break;
+			dist = head.delta0;
+		}
+	}
+
+	ext->la = hlcn << lbits | head.clusterofs;
+	ext->pblk = head.pblk;
+	ext->plain = head.type == Z_EROFS_CLUSTER_TYPE_PLAIN;
+
+	/* The extent ends where the next one starts, or at the end of file */
+	if (!end_known) {
+		ext->end = inode->size;
+		for (n = lcn + 1; n < totalidx; n++) {
+			ret = z_erofs_load_index(inode, n, &idx);
+			if (ret)
+				return ret;
+			if (idx.type != Z_EROFS_CLUSTER_TYPE_NONHEAD) {
+				ext->end = n << lbits | idx.clusterofs;
+				break;
+			}
+		}
+	}
+	ext->end = min(ext->end, inode->size);
+	if (ext->la > la || ext->end <= la)
+		return -EIO;
+
+	return 0;
+}
+
+/* Decompress @ext, whose physical cluster is at @src, to @dst */
+static int z_erofs_decompress(const struct z_erofs_extent *ext,
+			      const char *src, char *dst)
+{
+	size_t len = ext->end - ext->la;
+	u32 skip = 0;
+
+	if (ext->plain) {
+		if (len > EROFS_BLKSZ)
+			return -EIO;
+		memcpy(dst, src, len);
+		return 0;
+	}
+
+	/* The compressed data is at the end of the cluster, after zeroes */
+	while (skip < EROFS_BLKSZ && !src[skip])
+		skip++;
+	if (ulz4_block(src + skip, EROFS_BLKSZ - skip, dst, &len) ||
+	    len != ext->end - ext->la)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Copy the part of @ext from @offset to @end into @buf, which is at
+ * @offset in the file. Extents wanted in full are decompressed straight to
+ * @buf, others through erofs_sbi->zbuf, which keeps the last one for the
+ * next read.
+ */
+static int z_erofs_copy_extent(const struct z_erofs_extent *ext,
+			       const char *src, u64 offset, u64 end, char *buf)
+{
+	u64 from = max(ext->la, offset), to = min(ext->end, end);
+	u32 len = ext->end - ext->la;
+	int ret;
+
+	if (from == ext->la && to == ext->end)
+		return z_erofs_decompress(ext, src, buf + (from - offset));
+
+	if (erofs_sbi->zbuf_pblk != ext->pblk) {
+		if (erofs_sbi->zbuf_size < len) {
+			free(erofs_sbi->zbuf);
+			erofs_sbi->zbuf = malloc(len);
+			erofs_sbi->zbuf_size = erofs_sbi->zbuf ? len : 0;
+			if (!erofs_sbi->zbuf)
+				return -ENOMEM;
+		}
+		erofs_sbi->zbuf_pblk = -1ULL;
+		ret = z_erofs_decompress(ext, src, erofs_sbi->zbuf);
+		if (ret)
+			return ret;
+		erofs_sbi->zbuf_pblk = ext->pblk;
+	}
+	memcpy(buf + (from - offset), erofs_sbi->zbuf + (from - ext->la),
+	       to - from);
+
+	return 0;
+}
+
+int z_erofs_read_data(const struct erofs_inode *inode, u64 offset, u64 len,
+		      char *buf)
+{
+	struct z_erofs_extent exts[Z_EROFS_READ_RUN];
+	u64 pos = offset, end = offset + len;
+	char *rbuf;
+	int i, n, ret = 0;
+
+	rbuf = malloc(Z_EROFS_READ_RUN << erofs_sbi->blkszbits);
+	if (!rbuf)
+		return -ENOMEM;
+
+	while (pos < end) {
+		/* Map extents in consecutive clusters, to read them at once */
+		for (n = 0; n < Z_EROFS_READ_RUN && pos < end; n++) {
+			ret = z_erofs_map(inode, pos, &exts[n]);
+			if (ret)
+				goto out;
+			if (n && exts[n].pblk != exts[n - 1].pblk + 1)
+				break;
+			pos = exts[n].end;
+		}
+
+		ret = erofs_devread(erofs_pos(exts[0].pblk),
+				    erofs_pos(n), rbuf);
+		if (ret)
+			goto out;
+		for (i = 0; i < n; i++) {
+			ret = z_erofs_copy_extent(&exts[i],
+						  rbuf + erofs_pos(i),
+						  offset, end, buf);
+			if (ret)
+				goto out;
+		}
+	}
+
+out:
+	free(rbuf);
+	return ret;
+}
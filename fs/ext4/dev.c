@@ -33,26 +33,38 @@
 lbaint_t part_offset;
 
 static struct blk_desc *ext4fs_blk_desc;
-static disk_partition_t *part_info;
+static disk_partition_t part_info;
 
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info)
 {
 	assert(rbdd->blksz == (1 << rbdd->log2blksz));
 	ext4fs_blk_desc = rbdd;
 	get_fs()->dev_desc = rbdd;
-	part_info = info;
+	part_info = *info;
 	part_offset = info->start;
 	get_fs()->total_sect = ((uint64_t)info->size * info->blksz) >>
 		get_fs()->dev_desc->log2blksz;
 }
 
+/* Check whether the mounted filesystem is on the given partition */
+int ext4fs_is_mounted(struct blk_desc *rbdd, disk_partition_t *info)
+{
+	return ext4fs_root && ext4fs_blk_desc == rbdd &&
+	       part_info.start == info->start && part_info.size == info->size;
+}
+
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len,
 		   char *buffer)
 {
-	return fs_devread(get_fs()->dev_desc, part_info, sector, byte_offset,
+	return fs_devread(get_fs()->dev_desc, &part_info, sector, byte_offset,
 			  byte_len, buffer);
 }
 
+int ext4fs_read_range(u64 pos, u64 len, char *buffer)
+{
+	return fs_read_range(get_fs()->dev_desc, &part_info, pos, len, buffer);
+}
+
 int ext4_read_superblock(char *buffer)
 {
 	struct ext_filesystem *fs = get_fs();
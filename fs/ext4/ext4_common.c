@@ -24,6 +24,7 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <stddef.h>
+#include <linux/sizes.h>
 #include <linux/stat.h>
 #include <linux/time.h>
 #include <asm/byteorder.h>
@@ -310,6 +311,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index)
 	remainder = blockno % 8;
 	int blocksize = EXT2_BLOCK_SIZE(ext4fs_root);
 
+	get_fs()->bmap_dirty[index] = true;
 	i = i - (index * blocksize);
 	if (blocksize != 1024) {
 		ptr = ptr + i;
@@ -346,6 +348,7 @@ void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer, int index)
 	remainder = blockno % 8;
 	int blocksize = EXT2_BLOCK_SIZE(ext4fs_root);
 
+	get_fs()->bmap_dirty[index] = true;
 	i = i - (index * blocksize);
 	if (blocksize != 1024) {
 		ptr = ptr + i;
@@ -373,6 +376,7 @@ int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index)
 	unsigned char *ptr = buffer;
 	unsigned char operand;
 
+	get_fs()->bmap_dirty[index] = true;
 	inode_no -= (index * le32_to_cpu(ext4fs_root->sblock.inodes_per_group));
 	i = inode_no / 8;
 	remainder = inode_no % 8;
@@ -398,6 +402,7 @@ void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index)
 	unsigned char *ptr = buffer;
 	unsigned char operand;
 
+	get_fs()->bmap_dirty[index] = true;
 	inode_no -= (index * le32_to_cpu(ext4fs_root->sblock.inodes_per_group));
 	i = inode_no / 8;
 	remainder = inode_no % 8;
@@ -992,6 +997,7 @@ uint32_t ext4fs_get_new_blk_no(void)
 				fs->curr_blkno = fs->curr_blkno +
 						(i * fs->blksz * 8);
 				fs->first_pass_bbmap++;
+				fs->bmap_dirty[i] = true;
 				ext4fs_bg_free_blocks_dec(bgd, fs);
 				ext4fs_sb_free_blocks_dec(fs->sb);
 				status = ext4fs_devread(b_bitmap_blk *
@@ -1126,6 +1132,7 @@ int ext4fs_get_new_inode_no(void)
 				fs->curr_inode_no = fs->curr_inode_no +
 							(i * inodes_per_grp);
 				fs->first_pass_ibmap++;
+				fs->bmap_dirty[i] = true;
 				ext4fs_bg_free_inodes_dec(bgd, fs);
 				if (has_gdt_chksum)
 					ext4fs_bg_itable_unused_dec(bgd, fs);
@@ -1519,6 +1526,295 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	*total_no_of_block += no_blks_reqd;
 }
 
+static inline bool ext4fs_bmap_test(const unsigned char *bmap, uint32_t bit)
+{
+	return bmap[bit >> 3] & (1 << (bit & 7));
+}
+
+/*
+ * Mark @count blocks from bit @bit of group @bg_idx as used, or as free if
+ * @used is false, and adjust the free block counts to match
+ */
+static int ext4fs_mark_blocks(uint32_t bg_idx, uint32_t bit, uint32_t count,
+			      bool used)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+	unsigned char *bmap = fs->blk_bmaps[bg_idx];
+	uint32_t free_blocks, changed = 0;
+	uint64_t sb_free;
+	uint32_t i;
+	int ret;
+
+	/*
+	 * The bitmap in memory is as on the disk until it is first changed,
+	 * and the journal only keeps the first copy of each block
+	 */
+	ret = ext4fs_log_journal((char *)bmap, ext4fs_bg_get_block_id(bgd, fs));
+	if (ret)
+		return ret;
+
+	fs->bmap_dirty[bg_idx] = true;
+	for (i = bit; i < bit + count; i++) {
+		if (ext4fs_bmap_test(bmap, i) == used)
+			continue;
+		bmap[i >> 3] ^= 1 << (i & 7);
+		changed++;
+	}
+
+	free_blocks = ext4fs_bg_get_free_blocks(bgd, fs);
+	free_blocks = used ? free_blocks - changed : free_blocks + changed;
+	bgd->free_blocks = cpu_to_le16(free_blocks & 0xffff);
+	if (fs->gdsize == 64)
+		bgd->free_blocks_high = cpu_to_le16(free_blocks >> 16);
+	sb_free = ext4fs_sb_get_free_blocks(fs->sb);
+	sb_free = used ? sb_free - changed : sb_free + changed;
+	ext4fs_sb_set_free_blocks(fs->sb, sb_free);
+
+	return 0;
+}
+
+/**
+ * ext4fs_alloc_blocks() - Allocate a run of contiguous blocks
+ *
+ * The search starts after the block last allocated, and takes the first
+ * free block found along with as many free blocks as follow it in the same
+ * group, up to @count.
+ *
+ * @count: Number of blocks wanted
+ * @startp: Returns the first block allocated
+ * @return number of blocks allocated, 0 if there are none left, -ve on error
+ */
+int ext4fs_alloc_blocks(uint32_t count, uint32_t *startp)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t first_block = le32_to_cpu(fs->sb->first_data_block);
+	uint32_t blk_per_grp = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t total = le32_to_cpu(fs->sb->total_blocks) - first_block;
+	uint32_t bg_idx = 0, bit = 0, end, n;
+	struct ext2_block_group *bgd;
+	unsigned char *bmap;
+	uint64_t bmap_blk;
+	uint16_t bg_flags;
+	int tries, ret;
+
+	if (fs->first_pass_bbmap && fs->curr_blkno + 1 - first_block < total) {
+		bg_idx = (fs->curr_blkno + 1 - first_block) / blk_per_grp;
+		bit = (fs->curr_blkno + 1 - first_block) % blk_per_grp;
+	}
+
+	/* go round once, then look at the start of the first group again */
+	for (tries = 0; tries <= fs->no_blkgrp; tries++, bg_idx++, bit = 0) {
+		if (bg_idx >= fs->no_blkgrp)
+			bg_idx = 0;
+		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+		if (!ext4fs_bg_get_free_blocks(bgd, fs))
+			continue;
+
+		bmap = fs->blk_bmaps[bg_idx];
+		bg_flags = ext4fs_bg_get_flags(bgd);
+		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
+			bmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+			ret = ext4fs_log_journal((char *)bmap, bmap_blk);
+			if (ret)
+				return ret;
+			memset(bmap, '\0', fs->blksz);
+			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+			ext4fs_bg_set_flags(bgd, bg_flags);
+			fs->bmap_dirty[bg_idx] = true;
+		}
+
+		end = min(blk_per_grp, total - bg_idx * blk_per_grp);
+		while (bit < end && ext4fs_bmap_test(bmap, bit)) {
+			if (!(bit & 7) && bmap[bit >> 3] == 0xff)
+				bit += 8;
+			else
+				bit++;
+		}
+		if (bit >= end)
+			continue;
+
+		for (n = 1; n < count && bit + n < end; n++) {
+			if (ext4fs_bmap_test(bmap, bit + n))
+				break;
+		}
+		ret = ext4fs_mark_blocks(bg_idx, bit, n, true);
+		if (ret)
+			return ret;
+
+		*startp = first_block + bg_idx * blk_per_grp + bit;
+		fs->curr_blkno = *startp + n - 1;
+		fs->first_pass_bbmap = 1;
+
+		return n;
+	}
+
+	return 0;
+}
+
+/**
+ * ext4fs_free_blocks() - Release a run of contiguous blocks
+ *
+ * @start: First block to release
+ * @count: Number of blocks
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_free_blocks(uint32_t start, uint32_t count)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t first_block = le32_to_cpu(fs->sb->first_data_block);
+	uint32_t blk_per_grp = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t bg_idx, bit, n;
+	int ret;
+
+	while (count) {
+		if (start < first_block)
+			return -EINVAL;
+		bg_idx = (start - first_block) / blk_per_grp;
+		bit = (start - first_block) % blk_per_grp;
+		if (bg_idx >= fs->no_blkgrp)
+			return -EINVAL;
+
+		n = min(count, blk_per_grp - bit);
+		debug("EXT4 Block releasing %u+%u: %u\n", start, n, bg_idx);
+		ret = ext4fs_mark_blocks(bg_idx, bit, n, false);
+		if (ret)
+			return ret;
+		start += n;
+		count -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * ext4fs_allocate_extents() - Allocate the blocks of a new file as extents
+ *
+ * The blocks are allocated in runs which are as long as possible, each of
+ * which becomes an extent. If there are too many to fit in the inode, the
+ * levels of the tree below it are written to the disk straight away.
+ *
+ * @file_inode: Inode of the new file
+ * @count: Number of data blocks to allocate
+ * @total_no_of_block: Incremented by the number of blocks used by the tree
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_allocate_extents(struct ext2_inode *file_inode, uint32_t count,
+			    unsigned int *total_no_of_block)
+{
+	struct ext_filesystem *fs = get_fs();
+	/* an index entry is the same size as an extent */
+	int per_block = (fs->blksz - sizeof(struct ext4_extent_header)) /
+		sizeof(struct ext4_extent);
+	int per_inode = (sizeof(file_inode->b.blocks) -
+			 sizeof(struct ext4_extent_header)) /
+		sizeof(struct ext4_extent);
+	struct ext4_extent *extents = NULL, *extent;
+	struct ext4_extent_idx *index;
+	struct ext4_extent_header *eh;
+	uint32_t fileblock, start, len;
+	int entries = 0, max = 0, depth = 0;
+	int nodes, i, n, ret;
+	char *buf = NULL;
+
+	for (fileblock = 0; fileblock < count; fileblock += ret) {
+		ret = ext4fs_alloc_blocks(min_t(uint32_t, count - fileblock,
+						EXT_INIT_MAX_LEN), &start);
+		if (ret <= 0) {
+			printf("no block left to assign\n");
+			ret = ret ? ret : -ENOSPC;
+			goto fail;
+		}
+
+		/* runs may carry on into the next group */
+		extent = entries ? &extents[entries - 1] : NULL;
+		if (extent) {
+			len = le16_to_cpu(extent->ee_len);
+			if (le32_to_cpu(extent->ee_start_lo) + len == start &&
+			    len + ret <= EXT_INIT_MAX_LEN) {
+				extent->ee_len = cpu_to_le16(len + ret);
+				continue;
+			}
+		}
+
+		if (entries == max) {
+			max = max ? max * 2 : 16;
+			extent = realloc(extents, max * sizeof(*extent));
+			if (!extent) {
+				ret = -ENOMEM;
+				goto fail;
+			}
+			extents = extent;
+		}
+		extent = &extents[entries++];
+		extent->ee_block = cpu_to_le32(fileblock);
+		extent->ee_len = cpu_to_le16(ret);
+		extent->ee_start_hi = 0;
+		extent->ee_start_lo = cpu_to_le32(start);
+	}
+
+	/* Put the entries of each level which does not fit in blocks */
+	while (entries > per_inode) {
+		nodes = DIV_ROUND_UP(entries, per_block);
+		index = calloc(nodes, sizeof(*index));
+		if (!buf)
+			buf = zalloc(fs->blksz);
+		if (!index || !buf) {
+			free(index);
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		for (i = 0; i < nodes; i++) {
+			ret = ext4fs_alloc_blocks(1, &start);
+			if (ret <= 0) {
+				printf("no block left to assign\n");
+				free(index);
+				ret = ret ? ret : -ENOSPC;
+				goto fail;
+			}
+			(*total_no_of_block)++;
+
+			n = min(per_block, entries - i * per_block);
+			extent = &extents[i * per_block];
+			memset(buf, '\0', fs->blksz);
+			eh = (struct ext4_extent_header *)buf;
+			eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+			eh->eh_entries = cpu_to_le16(n);
+			eh->eh_max = cpu_to_le16(per_block);
+			eh->eh_depth = cpu_to_le16(depth);
+			memcpy(eh + 1, extent, n * sizeof(*extent));
+			put_ext4((uint64_t)start * fs->blksz, buf, fs->blksz);
+
+			/* ee_block and ei_block are both first */
+			index[i].ei_block = extent->ee_block;
+			index[i].ei_leaf_lo = cpu_to_le32(start);
+		}
+
+		free(extents);
+		extents = (struct ext4_extent *)index;
+		entries = nodes;
+		depth++;
+	}
+
+	eh = (struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	memset(eh, '\0', sizeof(file_inode->b.blocks));
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_entries = cpu_to_le16(entries);
+	eh->eh_max = cpu_to_le16(per_inode);
+	eh->eh_depth = cpu_to_le16(depth);
+	if (entries)
+		memcpy(eh + 1, extents, entries * sizeof(*extents));
+	file_inode->flags = cpu_to_le32(le32_to_cpu(file_inode->flags) |
+					EXT4_EXTENTS_FL);
+	ret = 0;
+fail:
+	free(extents);
+	free(buf);
+
+	return ret;
+}
+
 #endif
 
 static struct ext4_extent_header *ext4fs_get_extent_block
@@ -1560,6 +1856,170 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+struct ext4fs_runs {
+	struct ext4fs_run *run;
+	int count;
+	int max;
+};
+
+/* Add the extents under @ext_block which cover blocks @first to @last */
+static int ext4fs_add_extent_runs(struct ext4fs_runs *runs,
+				  struct ext4_extent_header *ext_block,
+				  uint32_t first, uint32_t last)
+{
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	int depth = le16_to_cpu(ext_block->eh_depth);
+	struct ext4_extent_header *child;
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	struct ext4fs_run *run;
+	uint32_t start, len;
+	uint64_t block;
+	char *buf;
+	int i, ret;
+
+	if (depth == 0) {
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries; i++) {
+			start = le32_to_cpu(extent[i].ee_block);
+			len = le16_to_cpu(extent[i].ee_len);
+			if (start > last)
+				break;
+			if (len > EXT_INIT_MAX_LEN)
+				len -= EXT_INIT_MAX_LEN;
+			if (!len || start + len <= first)
+				continue;
+
+			if (runs->count == runs->max) {
+				runs->max = runs->max ? runs->max * 2 : 16;
+				run = realloc(runs->run,
+					      runs->max * sizeof(*run));
+				if (!run)
+					return -ENOMEM;
+				runs->run = run;
+			}
+			run = &runs->run[runs->count++];
+			run->fileblock = start;
+			run->len = len;
+			run->start = le16_to_cpu(extent[i].ee_start_hi);
+			run->start = (run->start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			run->uninit = le16_to_cpu(extent[i].ee_len) >
+				EXT_INIT_MAX_LEN;
+		}
+
+		return 0;
+	}
+
+	buf = malloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	/* Each index covers the blocks up to where the next one starts */
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0, ret = 0; i < entries && !ret; i++) {
+		if (le32_to_cpu(index[i].ei_block) > last)
+			break;
+		if (i + 1 < entries &&
+		    le32_to_cpu(index[i + 1].ei_block) <= first)
+			continue;
+
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			ret = -EIO;
+			break;
+		}
+
+		child = (struct ext4_extent_header *)buf;
+		if (le16_to_cpu(child->eh_magic) != EXT4_EXT_MAGIC ||
+		    le16_to_cpu(child->eh_depth) != depth - 1) {
+			printf("invalid extent block\n");
+			ret = -EINVAL;
+			break;
+		}
+		ret = ext4fs_add_extent_runs(runs, child, first, last);
+	}
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * ext4fs_get_extent_runs() - Get the disk blocks of part of a file
+ *
+ * This walks the extent tree of @inode once, visiting only the parts which
+ * cover the blocks wanted. Holes are not included, so the caller must zero
+ * any blocks between the runs.
+ *
+ * @inode: Inode, which must use extents
+ * @first: First block in the file which is wanted
+ * @last: Last block in the file which is wanted
+ * @runsp: Returns an allocated list of runs, in file order, to be freed by
+ *	the caller. This is NULL if there are none
+ * @return number of runs, or -ve on error
+ */
+int ext4fs_get_extent_runs(struct ext2_inode *inode, uint32_t first,
+			   uint32_t last, struct ext4fs_run **runsp)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4fs_runs runs = { NULL, 0, 0 };
+	int ret;
+
+	ext_block = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	ret = ext4fs_add_extent_runs(&runs, ext_block, first, last);
+	if (ret) {
+		free(runs.run);
+		return ret;
+	}
+	*runsp = runs.run;
+
+	return runs.count;
+}
+
+/* Largest group descriptor table which is kept in memory */
+#define EXT4_GDT_CACHE_MAX	SZ_256K
+
+/*
+ * Read the whole group descriptor table, which is usually only a few blocks,
+ * so that looking up inodes needs no further reads for it
+ */
+static void ext4fs_read_gdt(struct ext2_data *data)
+{
+	int log2blksz = get_fs()->dev_desc->log2blksz;
+	int desc_size = get_fs()->gdsize;
+	uint32_t groups;
+	long int blkno;
+	char *gdt;
+
+	groups = le32_to_cpu(data->sblock.total_inodes) /
+		le32_to_cpu(data->sblock.inodes_per_group);
+	if ((u64)groups * desc_size > EXT4_GDT_CACHE_MAX)
+		return;
+
+	gdt = malloc(groups * desc_size);
+	if (!gdt)
+		return;
+	blkno = le32_to_cpu(data->sblock.first_data_block) + 1;
+	if (!ext4fs_devread((lbaint_t)blkno <<
+			    (LOG2_BLOCK_SIZE(data) - log2blksz), 0,
+			    groups * desc_size, gdt)) {
+		free(gdt);
+		return;
+	}
+	data->gdt = gdt;
+	data->gdt_groups = groups;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -1568,6 +2028,13 @@ static int ext4fs_blockgroup
 	int log2blksz = get_fs()->dev_desc->log2blksz;
 	int desc_size = get_fs()->gdsize;
 
+	if (!data->gdt)
+		ext4fs_read_gdt(data);
+	if (data->gdt && group < data->gdt_groups) {
+		memcpy(blkgrp, data->gdt + group * desc_size, desc_size);
+		return 1;
+	}
+
 	desc_per_blk = EXT2_BLOCK_SIZE(data) / desc_size;
 
 	blkno = le32_to_cpu(data->sblock.first_data_block) + 1 +
@@ -1996,6 +2463,7 @@ void ext4fs_close(void)
 		ext4fs_file = NULL;
 	}
 	if (ext4fs_root != NULL) {
+		free(ext4fs_root->gdt);
 		free(ext4fs_root);
 		ext4fs_root = NULL;
 	}
@@ -2003,6 +2471,236 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+void ext4fs_dcache_clear(void)
+{
+	int i;
+
+	if (!ext4fs_root)
+		return;
+	for (i = 0; i < EXT2_DCACHE_SIZE; i++)
+		ext4fs_root->dcache[i].dir_ino = 0;
+}
+
+/* Look up a name found earlier in a directory, returning its inode or 0 */
+static int ext4fs_dcache_find(struct ext2fs_node *dir, const char *name,
+			      int *type)
+{
+	struct ext2_dcache_entry *entry;
+	int i;
+
+	for (i = 0; i < EXT2_DCACHE_SIZE; i++) {
+		entry = &dir->data->dcache[i];
+		if (entry->dir_ino == dir->ino && !strcmp(entry->name, name)) {
+			*type = entry->type;
+			return entry->ino;
+		}
+	}
+
+	return 0;
+}
+
+static void ext4fs_dcache_add(struct ext2fs_node *dir, const char *name,
+			      int ino, int type)
+{
+	struct ext2_data *data = dir->data;
+	struct ext2_dcache_entry *entry;
+
+	if (strlen(name) >= sizeof(entry->name))
+		return;
+	entry = &data->dcache[data->dcache_next];
+	data->dcache_next = (data->dcache_next + 1) % EXT2_DCACHE_SIZE;
+	entry->dir_ino = dir->ino;
+	entry->ino = ino;
+	entry->type = type;
+	strcpy(entry->name, name);
+}
+
+/*
+ * Make a node for the directory entry 'dirent' and return its type in
+ * 'type', reading its inode if the entry does not give it.
+ * Return NULL on error.
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *dir,
+					      struct ext2_dirent *dirent,
+					      int *type)
+{
+	struct ext2fs_node *fdiro;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = dir->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+	*type = FILETYPE_UNKNOWN;
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			*type = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			*type = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			*type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(dir->data, fdiro->ino,
+					   &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
+		}
+		fdiro->inode_read = 1;
+
+		if ((le16_to_cpu(fdiro->inode.mode) &
+		     FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY) {
+			*type = FILETYPE_DIRECTORY;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK) {
+			*type = FILETYPE_SYMLINK;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_REG) {
+			*type = FILETYPE_REG;
+		}
+	}
+
+	return fdiro;
+}
+
+/*
+ * Find 'name' in the directory block 'buf'. Return 1 and copy its entry
+ * to 'found' if it is there, 0 if not, or -1 if the block is corrupt.
+ */
+static int ext4fs_dx_find_leaf(char *buf, int blksz, const char *name,
+			       struct ext2_dirent *found)
+{
+	struct ext2_dirent *dirent;
+	int len = strlen(name);
+	int pos, direntlen;
+
+	for (pos = 0; pos < blksz; pos += direntlen) {
+		dirent = (struct ext2_dirent *)(buf + pos);
+		direntlen = le16_to_cpu(dirent->direntlen);
+		if (direntlen < sizeof(*dirent) || pos + direntlen > blksz ||
+		    sizeof(*dirent) + dirent->namelen > direntlen)
+			return -1;
+
+		if (dirent->inode && dirent->namelen == len &&
+		    !memcmp(dirent + 1, name, len)) {
+			memcpy(found, dirent, sizeof(*found));
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Look up 'name' in a directory which is indexed by a hash tree, reading
+ * only the index blocks on the way to its leaf block. Return 1 and copy
+ * its entry to 'found' if it is there, 0 if not, or -1 if the directory
+ * must be searched in full instead.
+ */
+static int ext4fs_dx_find(struct ext2fs_node *dir, const char *name,
+			  struct ext2_dirent *found)
+{
+	struct ext2_sblock *sb = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct ext4_dx_root_info *info;
+	struct ext4_dx_countlimit *cl;
+	struct ext4_dx_entry *entries, *at;
+	int version, depth, levels, count, lo, hi, mid, ret = -1;
+	uint32_t hash, blk;
+	char *buf, *leaf;
+	loff_t actread;
+
+	if (!(le32_to_cpu(sb->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL))
+		return -1;
+
+	buf = malloc(2 * blksz);
+	if (!buf)
+		return -1;
+	leaf = buf + blksz;
+
+	if (ext4fs_read_file(dir, 0, blksz, buf, &actread) < 0 ||
+	    actread != blksz)
+		goto out;
+
+	/* The root follows the 12-byte "." and ".." entries */
+	info = (struct ext4_dx_root_info *)(buf + 24);
+	depth = info->indirect_levels;
+	version = info->hash_version;
+	if (info->reserved_zero || info->info_length < sizeof(*info) ||
+	    depth >= EXT4_HTREE_LEVEL)
+		goto out;
+	if (version <= DX_HASH_TEA &&
+	    (le32_to_cpu(sb->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	if (ext4fs_dirhash(name, strlen(name), version, sb->hash_seed, &hash))
+		goto out;
+
+	entries = (struct ext4_dx_entry *)((char *)info + info->info_length);
+	for (levels = depth; ; levels--) {
+		cl = (struct ext4_dx_countlimit *)entries;
+		count = le16_to_cpu(cl->count);
+		if (!count || count > le16_to_cpu(cl->limit) ||
+		    (char *)(entries + count) > buf + blksz)
+			goto out;
+
+		/* Find the last entry with a hash no higher than the name's */
+		lo = 1;
+		hi = count - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			if (le32_to_cpu(entries[mid].hash) > hash)
+				hi = mid - 1;
+			else
+				lo = mid + 1;
+		}
+		at = &entries[lo - 1];
+		blk = le32_to_cpu(at->block) & 0x0fffffff;
+		if (!levels)
+			break;
+
+		/* Index blocks start with an empty 8-byte entry */
+		if (ext4fs_read_file(dir, (loff_t)blk * blksz, blksz, buf,
+				     &actread) < 0 || actread != blksz)
+			goto out;
+		entries = (struct ext4_dx_entry *)(buf + 8);
+	}
+
+	while (1) {
+		if (ext4fs_read_file(dir, (loff_t)blk * blksz, blksz, leaf,
+				     &actread) < 0 || actread != blksz)
+			goto out;
+		ret = ext4fs_dx_find_leaf(leaf, blksz, name, found);
+		if (ret)
+			break;
+
+		/*
+		 * Names with the same hash may carry on in the next leaf,
+		 * which then has the hash with the low bit set
+		 */
+		if (++at == entries + count) {
+			/* any next one is under another index block */
+			if (depth)
+				ret = -1;
+			break;
+		}
+		if ((le32_to_cpu(at->hash) & ~1) != hash ||
+		    !(le32_to_cpu(at->hash) & 1))
+			break;
+		blk = le32_to_cpu(at->block) & 0x0fffffff;
+	}
+out:
+	free(buf);
+
+	return ret;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2020,6 +2718,38 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+
+	if (name && fnode && ftype) {
+		struct ext2fs_node *fdiro;
+		struct ext2_dirent dirent;
+		int ino, type;
+
+		ino = ext4fs_dcache_find(diro, name, &type);
+		if (ino) {
+			fdiro = zalloc(sizeof(struct ext2fs_node));
+			if (!fdiro)
+				return 0;
+			fdiro->data = diro->data;
+			fdiro->ino = ino;
+			*ftype = type;
+			*fnode = fdiro;
+			return 1;
+		}
+
+		status = ext4fs_dx_find(diro, name, &dirent);
+		if (status == 0)
+			return 0;
+		if (status > 0) {
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
+			if (!fdiro)
+				return 0;
+			ext4fs_dcache_add(diro, name, fdiro->ino, type);
+			*ftype = type;
+			*fnode = fdiro;
+			return 1;
+		}
+	}
+
 	/* Search the file.  */
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
@@ -2038,7 +2768,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (dirent.namelen != 0) {
 			char filename[dirent.namelen + 1];
 			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
+			int type;
 
 			status = ext4fs_read_file(diro,
 						  fpos +
@@ -2048,55 +2778,19 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
 			if (!fdiro)
 				return 0;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
-
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
 			if ((name != NULL) && (fnode != NULL)
 			    && (ftype != NULL)) {
 				if (strcmp(filename, name) == 0) {
+					ext4fs_dcache_add(diro, name,
+							  fdiro->ino, type);
 					*ftype = type;
 					*fnode = fdiro;
 					return 1;
@@ -2302,7 +2996,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* a mounted filesystem may be used for several files in turn */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2329,7 +3027,7 @@ int ext4fs_mount(unsigned part_length)
 	struct ext2_data *data;
 	int status;
 	struct ext_filesystem *fs = get_fs();
-	data = zalloc(SUPERBLOCK_SIZE);
+	data = zalloc(sizeof(*data));
 	if (!data)
 		return 0;
 
@@ -56,6 +56,38 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+/**
+ * struct ext4fs_run - File blocks which are contiguous on the disk
+ *
+ * @fileblock: First block in the file
+ * @len: Number of blocks
+ * @start: First block on the disk
+ * @uninit: true if the blocks are allocated but not written, so read as 0
+ */
+struct ext4fs_run {
+	uint32_t fileblock;
+	uint32_t len;
+	uint64_t start;
+	bool uninit;
+};
+
+void ext4fs_dcache_clear(void);
+
+/**
+ * ext4fs_dirhash() - Hash a file name as for a hashed directory
+ *
+ * @name: File name, which need not be terminated
+ * @len: Length of the name
+ * @version: Hash to use, DX_HASH_...
+ * @seed: Seed for the hash, from the superblock
+ * @hashp: Returns the hash
+ * @return 0 if OK, -EINVAL if the hash is not known
+ */
+int ext4fs_dirhash(const char *name, int len, int version,
+		   const __le32 *seed, uint32_t *hashp);
+int ext4fs_get_extent_runs(struct ext2_inode *inode, uint32_t first,
+			   uint32_t last, struct ext4fs_run **runsp);
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
@@ -72,6 +104,10 @@ int ext4fs_iget(int inode_no, struct ext2_inode *inode);
 void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block);
+int ext4fs_alloc_blocks(uint32_t count, uint32_t *startp);
+int ext4fs_free_blocks(uint32_t start, uint32_t count);
+int ext4fs_allocate_extents(struct ext2_inode *file_inode, uint32_t count,
+			    unsigned int *total_no_of_block);
 void put_ext4(uint64_t off, void *buf, uint32_t size);
 struct ext2_block_group *ext4fs_get_group_descriptor
 	(const struct ext_filesystem *fs, uint32_t bg_idx);
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Hashes of file names, as used to index ext3/ext4 directories
+ *
+ * Based on fs/ext4/hash.c and lib/halfmd4.c from Linux
+ * Copyright (C) 2002 by Theodore Ts'o
+ */
+
+#include <common.h>
+#include "ext4_common.h"
+
+#define DELTA	0x9e3779b9
+
+static void tea_transform(uint32_t buf[4], const uint32_t in[4])
+{
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z)	(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+
+#define STEP(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + (x), a = (a << (s)) | (a >> (32 - (s))))
+#define K1	0
+#define K2	0x5a827999
+#define K3	0x6ed9eba1
+
+/* The basic MD4 transform, cut down to 3 rounds of 8 steps */
+static void half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+{
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	STEP(F, a, b, c, d, in[0] + K1, 3);
+	STEP(F, d, a, b, c, in[1] + K1, 7);
+	STEP(F, c, d, a, b, in[2] + K1, 11);
+	STEP(F, b, c, d, a, in[3] + K1, 19);
+	STEP(F, a, b, c, d, in[4] + K1, 3);
+	STEP(F, d, a, b, c, in[5] + K1, 7);
+	STEP(F, c, d, a, b, in[6] + K1, 11);
+	STEP(F, b, c, d, a, in[7] + K1, 19);
+
+	STEP(G, a, b, c, d, in[1] + K2, 3);
+	STEP(G, d, a, b, c, in[3] + K2, 5);
+	STEP(G, c, d, a, b, in[5] + K2, 9);
+	STEP(G, b, c, d, a, in[7] + K2, 13);
+	STEP(G, a, b, c, d, in[0] + K2, 3);
+	STEP(G, d, a, b, c, in[2] + K2, 5);
+	STEP(G, c, d, a, b, in[4] + K2, 9);
+	STEP(G, b, c, d, a, in[6] + K2, 13);
+
+	STEP(H, a, b, c, d, in[3] + K3, 3);
+	STEP(H, d, a, b, c, in[7] + K3, 9);
+	STEP(H, c, d, a, b, in[2] + K3, 11);
+	STEP(H, b, c, d, a, in[6] + K3, 15);
+	STEP(H, a, b, c, d, in[1] + K3, 3);
+	STEP(H, d, a, b, c, in[5] + K3, 9);
+	STEP(H, c, d, a, b, in[0] + K3, 11);
+	STEP(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The original hash, treating the name as signed or unsigned chars */
+static uint32_t dx_hack_hash(const char *name, int len, bool is_unsigned)
+{
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		if (is_unsigned)
+			c = (unsigned char)*name++;
+		else
+			c = (signed char)*name++;
+		hash = hash1 + (hash0 ^ ((uint32_t)c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+/* Pack up to 'num' words of the name into 'buf', padded with its length */
+static void str2hashbuf(const char *msg, int len, uint32_t *buf, int num,
+			bool is_unsigned)
+{
+	uint32_t pad, val;
+	int i, c;
+
+	pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		if (is_unsigned)
+			c = (unsigned char)msg[i];
+		else
+			c = (signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+int ext4fs_dirhash(const char *name, int len, int version,
+		   const __le32 *seed, uint32_t *hashp)
+{
+	uint32_t buf[4], in[8], hash;
+	bool is_unsigned = false;
+	int i;
+
+	/* The MD4 initial values, unless the file system has a seed */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = le32_to_cpu(seed[i]);
+			break;
+		}
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, is_unsigned);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8, is_unsigned);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_TEA:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4, is_unsigned);
+			tea_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	hash &= ~1;
+	if (hash == EXT4_HTREE_EOF_32BIT << 1)
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+	*hashp = hash;
+
+	return 0;
+}
@@ -78,6 +78,8 @@ static void ext4fs_update(void)
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		bgd = ext4fs_get_group_descriptor(fs, i);
 		bgd->bg_checksum = cpu_to_le16(ext4fs_checksum_update(i));
+		if (!fs->bmap_dirty[i])
+			continue;
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		put_ext4(b_bitmap_blk * fs->blksz,
 			 fs->blk_bmaps[i], fs->blksz);
@@ -85,10 +87,13 @@ static void ext4fs_update(void)
 
 	/* update inode bitmaps */
 	for (i = 0; i < fs->no_blkgrp; i++) {
+		if (!fs->bmap_dirty[i])
+			continue;
 		bgd = ext4fs_get_group_descriptor(fs, i);
 		uint64_t i_bitmap_blk = ext4fs_bg_get_inode_id(bgd, fs);
 		put_ext4(i_bitmap_blk * fs->blksz,
 			 fs->inode_bmaps[i], fs->blksz);
+		fs->bmap_dirty[i] = false;
 	}
 
 	/* update the block group descriptor table */
@@ -431,24 +436,90 @@ fail:
 	free(journal_buffer);
 }
 
+/* Release the blocks of an extent tree below @eh, and the data blocks */
+static int ext4fs_delete_extents(struct ext4_extent_header *eh)
+{
+	struct ext_filesystem *fs = get_fs();
+	int entries = le16_to_cpu(eh->eh_entries);
+	struct ext4_extent_header *child;
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	uint64_t blknr;
+	uint32_t len;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	if (!eh->eh_depth) {
+		extent = (struct ext4_extent *)(eh + 1);
+		for (i = 0; i < entries && !ret; i++) {
+			blknr = le16_to_cpu(extent[i].ee_start_hi);
+			blknr = (blknr << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			len = le16_to_cpu(extent[i].ee_len);
+			if (len > EXT_INIT_MAX_LEN)
+				len -= EXT_INIT_MAX_LEN;
+			/* Blocks can only be freed below 2^32 */
+			if (blknr + len - 1 > U32_MAX)
+				return -EINVAL;
+			ret = ext4fs_free_blocks(blknr, len);
+		}
+
+		return ret;
+	}
+
+	buf = zalloc(fs->blksz);
+	if (!buf)
+		return -ENOMEM;
+	index = (struct ext4_extent_idx *)(eh + 1);
+	for (i = 0; i < entries && !ret; i++) {
+		blknr = le16_to_cpu(index[i].ei_leaf_hi);
+		blknr = (blknr << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (blknr > U32_MAX) {
+			ret = -EINVAL;
+			break;
+		}
+		if (!ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+				    fs->blksz, buf)) {
+			ret = -EIO;
+			break;
+		}
+		child = (struct ext4_extent_header *)buf;
+		if (le16_to_cpu(child->eh_depth) + 1 !=
+		    le16_to_cpu(eh->eh_depth)) {
+			printf("invalid extent block\n");
+			ret = -EINVAL;
+			break;
+		}
+		ret = ext4fs_delete_extents(child);
+		if (!ret)
+			ret = ext4fs_free_blocks(blknr, 1);
+	}
+	free(buf);
+
+	return ret;
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
 	short status;
 	int i;
-	int remainder;
 	long int blknr;
-	int bg_idx;
+	long int start;
+	uint32_t len;
 	int ibmap_idx;
 	char *read_buffer = NULL;
 	char *start_block_address = NULL;
 	uint32_t no_blocks;
 
-	static int prev_bg_bmap_idx = -1;
 	unsigned int inodes_per_block;
 	uint32_t blkno;
 	unsigned int blkoff;
-	uint32_t blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	uint32_t inode_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext2_inode *inode_buffer = NULL;
 	struct ext2_block_group *bgd = NULL;
@@ -466,50 +537,30 @@ static int ext4fs_delete_file(int inodeno)
 		no_blocks++;
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		/* FIXME delete extent index blocks, i.e. eh_depth >= 1 */
-		struct ext4_extent_header *eh =
-			(struct ext4_extent_header *)
-				inode.b.blocks.dir_blocks;
-		debug("del: dep=%d entries=%d\n", eh->eh_depth, eh->eh_entries);
+		if (ext4fs_delete_extents((struct ext4_extent_header *)
+					  inode.b.blocks.dir_blocks))
+			goto fail;
 	} else {
 		delete_single_indirect_block(&inode);
 		delete_double_indirect_block(&inode);
 		delete_triple_indirect_block(&inode);
-	}
 
-	/* release data blocks */
-	for (i = 0; i < no_blocks; i++) {
-		blknr = read_allocated_block(&inode, i);
-		if (blknr == 0)
-			continue;
-		if (blknr < 0)
-			goto fail;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-					bg_idx);
-		debug("EXT4 Block releasing %ld: %d\n", blknr, bg_idx);
-
-		/* get  block group descriptor table */
-		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
-		ext4fs_bg_free_blocks_inc(bgd, fs);
-		ext4fs_sb_free_blocks_inc(fs->sb);
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
-			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
+		/* release data blocks, a run at a time */
+		for (i = 0, start = 0, len = 0; i < no_blocks; i++) {
+			blknr = read_allocated_block(&inode, i);
+			if (blknr < 0)
 				goto fail;
-			if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+			if (blknr && blknr == start + len) {
+				len++;
+				continue;
+			}
+			if (len && ext4fs_free_blocks(start, len))
 				goto fail;
-			prev_bg_bmap_idx = bg_idx;
+			start = blknr;
+			len = blknr ? 1 : 0;
 		}
+		if (len && ext4fs_free_blocks(start, len))
+			goto fail;
 	}
 
 	/* release inode */
@@ -589,6 +640,9 @@ int ext4fs_init(void)
 	uint32_t real_free_blocks = 0;
 	struct ext_filesystem *fs = get_fs();
 
+	/* directories are about to change */
+	ext4fs_dcache_clear();
+
 	/* populate fs */
 	fs->blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	fs->sect_perblk = fs->blksz >> fs->dev_desc->log2blksz;
@@ -617,6 +671,11 @@ int ext4fs_init(void)
 		goto fail;
 	}
 
+	/* only the bitmaps which change are written back */
+	fs->bmap_dirty = zalloc(fs->no_blkgrp * sizeof(bool));
+	if (!fs->bmap_dirty)
+		goto fail;
+
 	/* load all the available bitmap block of the partition */
 	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(char *));
 	if (!fs->blk_bmaps)
@@ -734,7 +793,8 @@ void ext4fs_deinit(void)
 		fs->inode_bmaps = NULL;
 	}
 
-
+	free(fs->bmap_dirty);
+	fs->bmap_dirty = NULL;
 	free(fs->gdtable);
 	fs->gdtable = NULL;
 	/*
@@ -747,6 +807,34 @@ void ext4fs_deinit(void)
 	fs->curr_blkno = 0;
 }
 
+/* Write data to the blocks of a file which uses extents, an extent at a time */
+static int ext4fs_write_extents(struct ext2_inode *file_inode,
+				int pos, unsigned int len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4fs_run *runs = NULL;
+	uint32_t first = pos / fs->blksz;
+	uint32_t last = (pos + len - 1) / fs->blksz;
+	uint32_t start, end;
+	int count, i;
+
+	count = ext4fs_get_extent_runs(file_inode, first, last, &runs);
+	if (count < 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		start = max(runs[i].fileblock, first);
+		end = min(runs[i].fileblock + runs[i].len - 1, last);
+		put_ext4((runs[i].start + start - runs[i].fileblock) *
+			 fs->blksz,
+			 buf + (start - first) * fs->blksz,
+			 (end - start + 1) * fs->blksz);
+	}
+	free(runs);
+
+	return len;
+}
+
 /*
  * Write data to filesystem blocks. Uses same optimization for
  * contigous sectors as ext4fs_read_file
@@ -770,6 +858,11 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 	if (len > filesize)
 		len = filesize;
 
+	if (!len)
+		return 0;
+	if (le32_to_cpu(file_inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_write_extents(file_inode, pos, len, buf);
+
 	blockcnt = ((len + pos) + fs->blksz - 1) / fs->blksz;
 
 	for (i = pos / fs->blksz; i < blockcnt; i++) {
@@ -919,8 +1012,15 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	file_inode->size = cpu_to_le32(sizebytes);
 
 	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	if (le32_to_cpu(fs->sb->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_EXTENTS) {
+		if (ext4fs_allocate_extents(file_inode, blocks_remaining,
+					    &blks_reqd_for_file))
+			goto fail;
+	} else {
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
+	}
 	file_inode->blockcnt = cpu_to_le32((blks_reqd_for_file * fs->blksz) >>
 		fs->dev_desc->log2blksz);
 
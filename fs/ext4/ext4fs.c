@@ -25,6 +25,7 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -40,6 +41,59 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Read part of a file which uses extents, with one device read for each run
+ * of blocks which are contiguous on the disk. Holes and uninitialised
+ * extents read as zeroes.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node, loff_t pos,
+			       loff_t len, char *buf)
+{
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data);
+	loff_t end = pos + len;
+	loff_t start, stop;
+	struct ext4fs_run *runs = NULL, *run;
+	int count, i;
+
+	count = ext4fs_get_extent_runs(&node->inode, pos >> log2_fs_blocksize,
+				       (end - 1) >> log2_fs_blocksize, &runs);
+	if (count < 0)
+		return count;
+
+	for (i = 0; i < count && pos < end; i++) {
+		run = &runs[i];
+		start = (loff_t)run->fileblock << log2_fs_blocksize;
+		stop = start + ((loff_t)run->len << log2_fs_blocksize);
+		if (stop <= pos)
+			continue;
+		if (start >= end)
+			break;
+		if (start > pos) {
+			memset(buf, '\0', start - pos);
+			buf += start - pos;
+			pos = start;
+		}
+
+		stop = min(stop, end);
+		if (run->uninit) {
+			memset(buf, '\0', stop - pos);
+		} else if (ext4fs_read_range(((loff_t)run->start <<
+					      log2_fs_blocksize) + pos - start,
+					     stop - pos, buf)) {
+			free(runs);
+			return -EIO;
+		}
+		buf += stop - pos;
+		pos = stop;
+	}
+	free(runs);
+
+	if (pos < end)
+		memset(buf, '\0', end - pos);
+
+	return 0;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -70,6 +124,13 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	if (len + pos > filesize)
 		len = (filesize - pos);
 
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		if (len > 0 && ext4fs_read_extents(node, pos, len, buf))
+			return -1;
+		*actread = len;
+		return 0;
+	}
+
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
@@ -14,6 +14,7 @@
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <asm/byteorder.h>
 #include <part.h>
 #include <malloc.h>
@@ -193,12 +194,12 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
+		__u32 getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		/* Cap length if fatlength is not a multiple of fatbufblocks */
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
 
@@ -238,6 +239,26 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/*
+ * Read 'size' bytes starting 'offset' bytes into sector 'sect' into 'buffer'.
+ * See fs_read_range() for how whole and partial sectors are read.
+ * Return 0 on success, -1 otherwise.
+ */
+static int get_data(fsdata *mydata, __u32 sect, __u32 offset, __u8 *buffer,
+		    unsigned long size)
+{
+	debug("gd - sect: %d, offset: %d, size: %lu\n", sect, offset, size);
+
+	if (!cur_dev)
+		return -1;
+
+	if (fs_read_range(cur_dev, &cur_part_info,
+			  (u64)sect * mydata->sect_size + offset, size, buffer))
+		return -1;
+
+	return 0;
+}
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -245,9 +266,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 static int
 get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 {
-	__u32 idx = 0;
 	__u32 startsect;
-	int ret;
 
 	if (clustnum > 0) {
 		startsect = clust_to_sect(mydata, clustnum);
@@ -257,47 +276,7 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
-	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
-
-		printf("FAT: Misaligned buffer address (%p)\n", buffer);
-
-		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
-				debug("Error reading data (got %d)\n", ret);
-				return -1;
-			}
-
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
-		}
-	} else {
-		idx = size / mydata->sect_size;
-		ret = disk_read(startsect, idx, buffer);
-		if (ret != idx) {
-			debug("Error reading data (got %d)\n", ret);
-			return -1;
-		}
-		startsect += idx;
-		idx *= mydata->sect_size;
-		buffer += idx;
-		size -= idx;
-	}
-	if (size) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
-
-		ret = disk_read(startsect, 1, tmpbuf);
-		if (ret != 1) {
-			debug("Error reading data (got %d)\n", ret);
-			return -1;
-		}
-
-		memcpy(buffer, tmpbuf, size);
-	}
-
-	return 0;
+	return get_data(mydata, startsect, 0, buffer, size);
 }
 
 /*
@@ -314,7 +293,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	__u32 endclust, newclust = 0;
 	loff_t actsize;
 
 	*gotsize = 0;
@@ -348,39 +327,17 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	filesize -= actsize;
 	pos -= actsize;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		actsize = min(filesize, (loff_t)bytesperclust);
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
+	/*
+	 * Read each run of consecutive clusters in one go. 'pos' is the offset
+	 * into the first cluster and 'filesize' is what is left from its start.
+	 */
 	do {
-		/* search for consecutive clusters */
+		actsize = bytesperclust;
+		endclust = curclust;
 		while (actsize < filesize) {
 			newclust = get_fatent(mydata, endclust);
 			if ((newclust - 1) != endclust)
-				goto getit;
+				break;
 			if (CHECK_CLUST(newclust, mydata->fatsize)) {
 				debug("curclust: 0x%x\n", newclust);
 				debug("Invalid FAT entry\n");
@@ -389,32 +346,26 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			endclust = newclust;
 			actsize += bytesperclust;
 		}
+		actsize = min(actsize, filesize);
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (get_data(mydata, clust_to_sect(mydata, curclust), pos,
+			     buffer, actsize - pos) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
-		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
+		*gotsize += actsize - pos;
+		buffer += actsize - pos;
 		filesize -= actsize;
-		buffer += actsize;
+		pos = 0;
+		if (!filesize)
+			return 0;
 
-		curclust = get_fatent(mydata, endclust);
+		curclust = newclust;
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
 			return 0;
 		}
-		actsize = bytesperclust;
-		endclust = curclust;
 	} while (1);
 }
 
@@ -591,6 +542,7 @@ static int get_fs_info(fsdata *mydata)
 	}
 
 	mydata->fatbufnum = -1;
+	mydata->fatbufblocks = FATBUFBLOCKS;
 	mydata->fat_dirty = 0;
 	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
 	if (mydata->fatbuf == NULL) {
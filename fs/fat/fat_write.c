@@ -14,8 +14,14 @@
 #include <linux/ctype.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <linux/sizes.h>
 #include "fat.c"
 
+/* Largest FAT kept in memory as a whole while writing */
+#define FAT_WRITE_CACHE_MAX	SZ_4M
+/* Largest bounce buffer for writing data from a misaligned buffer */
+#define FAT_WRITE_BOUNCE_MAX	SZ_64K
+
 static void uppercase(char *str, int len)
 {
 	int i;
@@ -100,15 +106,49 @@ static void set_name(dir_entry *dirent, const char *filename)
 }
 
 static __u8 num_of_fats;
+
+/*
+ * When the whole FAT fits in fatbuf, one bit per sector of it which has
+ * been modified since it was last written
+ */
+static __u8 *fat_dirty_map;
+
+static inline int is_dirty_sect(__u32 sect)
+{
+	return fat_dirty_map[sect / 8] & (1 << (sect % 8));
+}
+
+/*
+ * Write 'count' sectors of fatbuf, starting at sector 'start' of the FAT,
+ * to each copy of the FAT
+ */
+static int write_fat_sectors(fsdata *mydata, __u32 start, __u32 count,
+			     __u8 *bufptr)
+{
+	__u32 startblock = mydata->fat_sect + start;
+	int i;
+
+	for (i = 0; i < num_of_fats; i++) {
+		if (disk_write(startblock, count, bufptr) < 0) {
+			debug("error: writing FAT %d blocks\n", i);
+			return -1;
+		}
+		startblock += mydata->fatlength;
+	}
+
+	return 0;
+}
+
 /*
  * Write fat buffer into block device
  */
 static int flush_dirty_fat_buffer(fsdata *mydata)
 {
-	int getsize = FATBUFBLOCKS;
+	int getsize = mydata->fatbufblocks;
 	__u32 fatlength = mydata->fatlength;
 	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 startblock = mydata->fatbufnum * mydata->fatbufblocks;
+	__u32 sect, end;
 
 	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
 	      (int)mydata->fat_dirty);
@@ -116,25 +156,26 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
 		return 0;
 
-	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-	if (startblock + getsize > fatlength)
-		getsize = fatlength - startblock;
-
-	startblock += mydata->fat_sect;
-
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
-	}
+	if (fat_dirty_map) {
+		/* Write each run of modified sectors */
+		for (sect = 0; sect < fatlength; sect = end) {
+			end = sect + 1;
+			if (!is_dirty_sect(sect))
+				continue;
+			while (end < fatlength && is_dirty_sect(end))
+				end++;
+			bufptr = mydata->fatbuf + sect * mydata->sect_size;
+			if (write_fat_sectors(mydata, sect, end - sect, bufptr))
+				return -1;
+		}
+		memset(fat_dirty_map, '\0', DIV_ROUND_UP(fatlength, 8));
+	} else {
+		/* Cap length if fatlength is not a multiple of fatbufblocks */
+		if (startblock + getsize > fatlength)
+			getsize = fatlength - startblock;
 
-	if (num_of_fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
+		if (write_fat_sectors(mydata, startblock, getsize, bufptr))
 			return -1;
-		}
 	}
 	mydata->fat_dirty = 0;
 
@@ -359,12 +400,41 @@ get_long_file_name(fsdata *mydata, int curclust, __u8 *cluster,
 	return 0;
 }
 
+/*
+ * Read block 'bufnum' of the FAT into the cache, writing back the one
+ * there first if needed. Return 0 on success, -1 otherwise.
+ */
+static int read_fat_buffer(fsdata *mydata, __u32 bufnum)
+{
+	int getsize = mydata->fatbufblocks;
+	__u8 *bufptr = mydata->fatbuf;
+	__u32 fatlength = mydata->fatlength;
+	__u32 startblock = bufnum * mydata->fatbufblocks;
+
+	/* Cap length if fatlength is not a multiple of fatbufblocks */
+	if (startblock + getsize > fatlength)
+		getsize = fatlength - startblock;
+
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	startblock += mydata->fat_sect;
+
+	if (disk_read(startblock, getsize, bufptr) < 0) {
+		debug("Error reading FAT blocks\n");
+		return -1;
+	}
+	mydata->fatbufnum = bufnum;
+
+	return 0;
+}
+
 /*
  * Set the entry at index 'entry' in a FAT (12/16/32) table.
  */
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
-	__u32 bufnum, offset, off16;
+	__u32 bufnum, offset, off16, sect;
 	__u16 val1, val2;
 
 	switch (mydata->fatsize) {
@@ -386,30 +456,18 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	}
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (bufnum != mydata->fatbufnum && read_fat_buffer(mydata, bufnum))
+		return -1;
 
-	/* Mark as dirty */
+	/* Mark as dirty, along with the sectors holding the entry */
 	mydata->fat_dirty = 1;
+	if (fat_dirty_map) {
+		sect = offset * mydata->fatsize / 8 / mydata->sect_size;
+		fat_dirty_map[sect / 8] |= 1 << (sect % 8);
+		sect = (offset * mydata->fatsize + mydata->fatsize - 1) / 8 /
+			mydata->sect_size;
+		fat_dirty_map[sect / 8] |= 1 << (sect % 8);
+	}
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
@@ -465,23 +523,147 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	return 0;
 }
 
+/*
+ * Free clusters of the file system being written, one bit each, with
+ * the number of them and the first cluster number past the data area
+ */
+static __u8 *free_map;
+static __u32 free_clusts, max_clust;
+/* Where to start looking for the next free cluster */
+static __u32 next_free;
+
+static inline int is_free_clust(__u32 clust)
+{
+	return free_map[clust / 8] & (1 << (clust % 8));
+}
+
+static void take_clust(__u32 clust)
+{
+	free_map[clust / 8] &= ~(1 << (clust % 8));
+	free_clusts--;
+	next_free = clust + 1;
+}
+
+static void release_clust(__u32 clust)
+{
+	if (clust < max_clust && !is_free_clust(clust)) {
+		free_map[clust / 8] |= 1 << (clust % 8);
+		free_clusts++;
+	}
+}
+
+/*
+ * Read the FAT and note which clusters are free.
+ * Return 0 on success, -1 otherwise.
+ */
+static int build_free_map(fsdata *mydata)
+{
+	__u32 clust, entries, data_sect = clust_to_sect(mydata, 2);
+
+	if ((__u32)total_sector <= data_sect)
+		return -1;
+
+	max_clust = (total_sector - data_sect) / mydata->clust_size + 2;
+	max_clust = min(max_clust, mydata->fatlength * mydata->sect_size * 8 /
+			mydata->fatsize);
+	if (mydata->fatsize == 32)
+		max_clust = min(max_clust, 0xffffff0U);
+	else if (mydata->fatsize == 16)
+		max_clust = min(max_clust, 0xfff0U);
+	else
+		max_clust = min(max_clust, 0xff0U);
+
+	free_map = calloc(DIV_ROUND_UP(max_clust, 8), 1);
+	if (!free_map)
+		return -1;
+
+	entries = FATBUFSIZE * 8 / mydata->fatsize;
+	free_clusts = 0;
+	for (clust = 2; clust < max_clust; clust++) {
+		if (clust / entries != mydata->fatbufnum &&
+		    read_fat_buffer(mydata, clust / entries))
+			return -1;
+		if (!get_fatent(mydata, clust))
+			release_clust(clust);
+	}
+	next_free = 2;
+
+	debug("FAT%d: %u of %u clusters free\n", mydata->fatsize, free_clusts,
+	      max_clust - 2);
+
+	return 0;
+}
+
+/* Find the first free cluster in 'clust' up to 'end', 0 if none */
+static __u32 scan_free_clust(__u32 clust, __u32 end)
+{
+	while (clust < end) {
+		if (!(clust % 8) && !free_map[clust / 8]) {
+			clust += 8;
+			continue;
+		}
+		if (is_free_clust(clust))
+			return clust;
+		clust++;
+	}
+
+	return 0;
+}
+
+/*
+ * Find the first free cluster from 'clust' on, wrapping around at the end
+ * of the file system. Return 0 if there is none.
+ */
+static __u32 find_free_clust(__u32 clust)
+{
+	__u32 ret = 0;
+
+	if (clust >= 2 && clust < max_clust)
+		ret = scan_free_clust(clust, max_clust);
+	if (!ret)
+		ret = scan_free_clust(2, max_clust);
+
+	return ret;
+}
+
+/*
+ * Find free clusters for a file of 'count' clusters: the first run long
+ * enough to hold it, or else the longest one. Return the first cluster of
+ * the run, 0 if there are no free clusters.
+ */
+static __u32 find_free_run(__u32 count)
+{
+	__u32 clust = 2, start, best = 0, best_len = 0;
+
+	while ((clust = scan_free_clust(clust, max_clust))) {
+		start = clust;
+		while (clust < max_clust && is_free_clust(clust))
+			clust++;
+		if (clust - start >= count)
+			return start;
+		if (clust - start > best_len) {
+			best = start;
+			best_len = clust - start;
+		}
+	}
+
+	return best;
+}
+
 /*
  * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
  * and link it to 'entry'. EOC marker is not set on returned entry.
+ * Return 0 if there are no free clusters left.
  */
 static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	__u32 next_entry = find_free_clust(entry + 1);
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
-		}
-		next_entry++;
-	}
+	if (!next_entry)
+		return 0;
+
+	take_clust(next_entry);
+	set_fatent_value(mydata, entry, next_entry);
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -508,21 +690,35 @@ set_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer,
 	debug("clustnum: %d, startsect: %d\n", clustnum, startsect);
 
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		unsigned long len;
+		__u8 *tmpbuf;
 
 		printf("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* Copy through an aligned buffer, many sectors at a time */
+		len = min_t(unsigned long, size, FAT_WRITE_BOUNCE_MAX);
+		tmpbuf = memalign(ARCH_DMA_MINALIGN, len);
+		if (!tmpbuf) {
+			debug("Error: allocating memory\n");
+			return -1;
+		}
+
 		while (size >= mydata->sect_size) {
-			memcpy(tmpbuf, buffer, mydata->sect_size);
-			ret = disk_write(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			idx = min(size, len) / mydata->sect_size;
+			memcpy(tmpbuf, buffer, idx * mydata->sect_size);
+			ret = disk_write(startsect, idx, tmpbuf);
+			if (ret != idx) {
 				debug("Error writing data (got %d)\n", ret);
+				free(tmpbuf);
 				return -1;
 			}
 
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			startsect += idx;
+			idx *= mydata->sect_size;
+			buffer += idx;
+			size -= idx;
 		}
+		free(tmpbuf);
 	} else if (size >= mydata->sect_size) {
 		idx = size / mydata->sect_size;
 		ret = disk_write(startsect, idx, buffer);
@@ -552,20 +748,16 @@ set_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find an empty cluster and take it. Return 0 if there is none.
  */
-static int find_empty_cluster(fsdata *mydata)
+static __u32 find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
+	__u32 clust = find_free_clust(next_free);
 
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
-	}
+	if (clust)
+		take_clust(clust);
 
-	return entry;
+	return clust;
 }
 
 /*
@@ -582,6 +774,10 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 		return;
 	}
 	dir_newclust = find_empty_cluster(mydata);
+	if (!dir_newclust) {
+		printf("error: no free cluster for directory\n");
+		return;
+	}
 	set_fatent_value(mydata, dir_curclust, dir_newclust);
 	if (mydata->fatsize == 32)
 		set_fatent_value(mydata, dir_newclust, 0xffffff8);
@@ -592,9 +788,6 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 
 	dir_curclust = dir_newclust;
 
-	if (flush_dirty_fat_buffer(mydata) < 0)
-		return;
-
 	memset(get_dentfromdir_block, 0x00,
 		mydata->clust_size * mydata->sect_size);
 
@@ -610,18 +803,15 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 
 	while (!CHECK_CLUST(entry, mydata->fatsize)) {
 		fat_val = get_fatent(mydata, entry);
-		if (fat_val != 0)
-			set_fatent_value(mydata, entry, 0);
-		else
+		if (fat_val == 0)
 			break;
+		if (set_fatent_value(mydata, entry, 0))
+			return -1;
+		release_clust(entry);
 
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_dirty_fat_buffer(mydata) < 0)
-		return -1;
-
 	return 0;
 }
 
@@ -740,27 +930,36 @@ static void fill_dentry(fsdata *mydata, dir_entry *dentptr,
 }
 
 /*
- * Check whether adding a file makes the file system to
- * exceed the size of the block device
- * Return -1 when overflow occurs, otherwise return 0
+ * Update the number of free clusters and the hint for the next one in the
+ * FAT32 filesystem info sector, if there is one
+ * Return 0 on success, -1 otherwise.
  */
-static int check_overflow(fsdata *mydata, __u32 clustnum, loff_t size)
+static int update_fsinfo(fsdata *mydata, __u16 info_sector)
 {
-	__u32 startsect, sect_num, offset;
+	ALLOC_CACHE_ALIGN_BUFFER(__u8, block, mydata->sect_size);
+	fsinfo_sector *info = (fsinfo_sector *)block;
+	__u32 hint;
 
-	if (clustnum > 0) {
-		startsect = clust_to_sect(mydata, clustnum);
-	} else {
-		startsect = mydata->rootdir_sect;
-	}
+	if (mydata->fatsize != 32 || !info_sector || info_sector == 0xffff)
+		return 0;
 
-	sect_num = div_u64_rem(size, mydata->sect_size, &offset);
+	if (disk_read(info_sector, 1, block) < 0)
+		return -1;
 
-	if (offset != 0)
-		sect_num++;
+	if (FAT2CPU32(info->lead_sig) != FSINFO_LEAD_SIG ||
+	    FAT2CPU32(info->struct_sig) != FSINFO_STRUCT_SIG ||
+	    FAT2CPU32(info->trail_sig) != FSINFO_TRAIL_SIG) {
+		debug("FAT: no valid FSInfo sector\n");
+		return 0;
+	}
+
+	hint = find_free_clust(next_free);
+	info->free_count = cpu_to_le32(free_clusts);
+	info->next_free = cpu_to_le32(hint ? hint : 0xffffffff);
 
-	if (startsect + sect_num > total_sector)
+	if (disk_write(info_sector, 1, block) < 0)
 		return -1;
+
 	return 0;
 }
 
@@ -904,7 +1103,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 {
 	dir_entry *dentptr, *retdent;
 	__u32 startsect;
-	__u32 start_cluster;
+	__u32 start_cluster, clusts;
 	boot_sector bs;
 	volume_info volinfo;
 	fsdata datablock;
@@ -958,10 +1157,35 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
-		return -1;
+	mydata->fatbuf = NULL;
+
+	/*
+	 * Keep the whole FAT in memory if it is not too large, so that it
+	 * is read once and only the sectors changed are written back
+	 */
+	if (mydata->fatlength * mydata->sect_size <= FAT_WRITE_CACHE_MAX) {
+		mydata->fatbufblocks = mydata->fatlength;
+		mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+		fat_dirty_map = calloc(DIV_ROUND_UP(mydata->fatlength, 8), 1);
+		if (!mydata->fatbuf || !fat_dirty_map) {
+			free(mydata->fatbuf);
+			free(fat_dirty_map);
+			mydata->fatbuf = NULL;
+			fat_dirty_map = NULL;
+		}
+	}
+	if (!mydata->fatbuf) {
+		mydata->fatbufblocks = FATBUFBLOCKS;
+		mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+		if (mydata->fatbuf == NULL) {
+			debug("Error: allocating memory\n");
+			return -1;
+		}
+	}
+
+	if (build_free_map(mydata)) {
+		debug("Error: reading FAT\n");
+		goto exit;
 	}
 
 	if (disk_read(cursect,
@@ -981,7 +1205,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		*bad = illegal[i];
 		if (strstr(filename, bad)) {
 			printf("FAT: illegal filename (%s)\n", filename);
-			return -1;
+			goto exit;
 		}
 	}
 
@@ -1002,66 +1226,39 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		start_cluster = START(retdent);
 
 		if (start_cluster) {
-			if (size) {
-				ret = check_overflow(mydata, start_cluster,
-							size);
-				if (ret) {
-					printf("Error: %llu overflow\n", size);
-					goto exit;
-				}
-			}
-
 			ret = clear_fatent(mydata, start_cluster);
 			if (ret) {
 				printf("Error: clearing FAT entries\n");
 				goto exit;
 			}
-
-			if (!size)
-				set_start_cluster(mydata, retdent, 0);
-		} else if (size) {
-			ret = start_cluster = find_empty_cluster(mydata);
-			if (ret < 0) {
-				printf("Error: finding empty cluster\n");
-				goto exit;
-			}
-
-			ret = check_overflow(mydata, start_cluster, size);
-			if (ret) {
-				printf("Error: %llu overflow\n", size);
-				goto exit;
-			}
-
-			set_start_cluster(mydata, retdent, start_cluster);
 		}
 	} else {
 		/* Set short name to set alias checksum field in dir_slot */
 		set_name(empty_dentptr, filename);
 		fill_dir_slot(mydata, &empty_dentptr, filename);
 
-		if (size) {
-			ret = start_cluster = find_empty_cluster(mydata);
-			if (ret < 0) {
-				printf("Error: finding empty cluster\n");
-				goto exit;
-			}
-
-			ret = check_overflow(mydata, start_cluster, size);
-			if (ret) {
-				printf("Error: %llu overflow\n", size);
-				goto exit;
-			}
-		} else {
-			start_cluster = 0;
-		}
-
 		/* Set attribute as archieve for regular file */
-		fill_dentry(mydata, empty_dentptr, filename,
-			start_cluster, size, 0x20);
+		fill_dentry(mydata, empty_dentptr, filename, 0, size, 0x20);
 
 		retdent = empty_dentptr;
 	}
 
+	/* Place the file in the first run of free clusters that can hold it */
+	start_cluster = 0;
+	if (size) {
+		clusts = DIV_ROUND_UP(size, mydata->clust_size *
+				      mydata->sect_size);
+		if (clusts > free_clusts) {
+			printf("Error: %llu overflow\n", size);
+			ret = -1;
+			goto exit;
+		}
+
+		start_cluster = find_free_run(clusts);
+		take_clust(start_cluster);
+	}
+	set_start_cluster(mydata, retdent, start_cluster);
+
 	ret = set_contents(mydata, retdent, buffer, size, actwrite);
 	if (ret < 0) {
 		printf("Error: writing contents\n");
@@ -1079,11 +1276,21 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 	/* Write directory table to device */
 	ret = set_cluster(mydata, dir_curclust, get_dentfromdir_block,
 			mydata->clust_size * mydata->sect_size);
-	if (ret)
+	if (ret) {
 		printf("Error: writing directory entry\n");
+		goto exit;
+	}
+
+	ret = update_fsinfo(mydata, bs.info_sector);
+	if (ret)
+		printf("Error: updating FSInfo sector\n");
 
 exit:
 	free(mydata->fatbuf);
+	free(fat_dirty_map);
+	free(free_map);
+	fat_dirty_map = NULL;
+	free_map = NULL;
 	return ret;
 }
 
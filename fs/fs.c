@@ -14,6 +14,8 @@
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
+#include <squashfs.h>
+#include <erofs.h>
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
@@ -25,6 +27,16 @@ static int fs_dev_part;
 static disk_partition_t fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+/* Filesystem left mounted after the last operation, see fs_close() */
+static struct {
+	int type;		/* FS_TYPE_ANY if none */
+	struct blk_desc *desc;
+	int part;
+	ulong gen;		/* blkcache_get_gen() when last used */
+} fs_mount = { .type = FS_TYPE_ANY };
+#endif
+
 static inline int fs_probe_unsupported(struct blk_desc *fs_dev_desc,
 				      disk_partition_t *fs_partition)
 {
@@ -128,6 +140,14 @@ struct fstype_info {
 		     loff_t len, loff_t *actwrite);
 	void (*close)(void);
 	int (*uuid)(char *uuid_str);
+	/*
+	 * Check whether the filesystem is still mounted on the partition,
+	 * from the last probe. If so, it is kept between operations when
+	 * CONFIG_FS_MOUNT_CACHE is enabled and ->close() is only called once
+	 * it is no longer wanted. May be NULL if this is not supported.
+	 */
+	int (*is_mounted)(struct blk_desc *fs_dev_desc,
+			  disk_partition_t *fs_partition);
 	/*
 	 * Open a directory stream.  On success return 0 and directory
 	 * stream pointer via 'dirsp'.  On error, return -errno.  See
@@ -184,6 +204,7 @@ static struct fstype_info fstypes[] = {
 		.write = fs_write_unsupported,
 #endif
 		.uuid = ext4fs_uuid,
+		.is_mounted = ext4fs_is_mounted,
 		.opendir = fs_opendir_unsupported,
 	},
 #endif
@@ -234,6 +255,44 @@ static struct fstype_info fstypes[] = {
 		.uuid = btrfs_uuid,
 		.opendir = fs_opendir_unsupported,
 	},
+#endif
+#ifdef CONFIG_FS_SQUASHFS
+	{
+		.fstype = FS_TYPE_SQUASHFS,
+		.name = "squashfs",
+		.null_dev_desc_ok = false,
+		.probe = sqfs_probe,
+		.close = sqfs_close,
+		.ls = fs_ls_generic,
+		.exists = sqfs_exists,
+		.size = sqfs_size,
+		.read = sqfs_read,
+		.write = fs_write_unsupported,
+		.uuid = fs_uuid_unsupported,
+		.is_mounted = sqfs_is_mounted,
+		.opendir = sqfs_opendir,
+		.readdir = sqfs_readdir,
+		.closedir = sqfs_closedir,
+	},
+#endif
+#ifdef CONFIG_FS_EROFS
+	{
+		.fstype = FS_TYPE_EROFS,
+		.name = "erofs",
+		.null_dev_desc_ok = false,
+		.probe = erofs_probe,
+		.close = erofs_close,
+		.ls = fs_ls_generic,
+		.exists = erofs_exists,
+		.size = erofs_size,
+		.read = erofs_read,
+		.write = fs_write_unsupported,
+		.uuid = erofs_uuid,
+		.is_mounted = erofs_is_mounted,
+		.opendir = erofs_opendir,
+		.readdir = erofs_readdir,
+		.closedir = erofs_closedir,
+	},
 #endif
 	{
 		.fstype = FS_TYPE_ANY,
@@ -278,6 +337,63 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+/* Unmount the filesystem left mounted, if any */
+static void fs_mount_drop(void)
+{
+	if (fs_mount.type == FS_TYPE_ANY)
+		return;
+	fs_get_info(fs_mount.type)->close();
+	fs_mount.type = FS_TYPE_ANY;
+}
+
+/* Use the filesystem left mounted, if it is on the selected partition */
+static bool fs_mount_reuse(int fstype, int part)
+{
+	struct fstype_info *info;
+
+	if (fs_mount.type == FS_TYPE_ANY || fs_mount.desc != fs_dev_desc ||
+	    fs_mount.part != part || fs_mount.gen != blkcache_get_gen() ||
+	    (fstype != FS_TYPE_ANY && fstype != fs_mount.type))
+		return false;
+
+	info = fs_get_info(fs_mount.type);
+	if (!info->is_mounted(fs_dev_desc, &fs_partition))
+		return false;
+	fs_type = fs_mount.type;
+	fs_dev_part = part;
+	fs_mount.type = FS_TYPE_ANY;
+
+	return true;
+}
+
+/* Keep the current filesystem mounted if possible, returning true if so */
+static bool fs_mount_keep(struct fstype_info *info)
+{
+	if (!info->is_mounted || !fs_dev_desc ||
+	    !info->is_mounted(fs_dev_desc, &fs_partition))
+		return false;
+	fs_mount.type = fs_type;
+	fs_mount.desc = fs_dev_desc;
+	fs_mount.part = fs_dev_part;
+	fs_mount.gen = blkcache_get_gen();
+
+	return true;
+}
+#else
+static inline void fs_mount_drop(void) {}
+
+static inline bool fs_mount_reuse(int fstype, int part)
+{
+	return false;
+}
+
+static inline bool fs_mount_keep(struct fstype_info *info)
+{
+	return false;
+}
+#endif
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -304,6 +420,10 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (fs_mount_reuse(fstype, part))
+		return 0;
+	fs_mount_drop();
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -336,9 +456,14 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (fs_mount_reuse(FS_TYPE_ANY, part))
+		return 0;
+	fs_mount_drop();
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
+			fs_dev_part = part;
 			return 0;
 		}
 	}
@@ -346,10 +471,22 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	return -1;
 }
 
+/* Finish an operation, leaving the filesystem mounted if it can be reused */
 static void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	if (!fs_mount_keep(info))
+		info->close();
+
+	fs_type = FS_TYPE_ANY;
+}
+
+/* Finish an operation which changed the filesystem */
+static void fs_unmount(void)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+
 	info->close();
 
 	fs_type = FS_TYPE_ANY;
@@ -370,7 +507,6 @@ int fs_ls(const char *dirname)
 
 	ret = info->ls(dirname);
 
-	fs_type = FS_TYPE_ANY;
 	fs_close();
 
 	return ret;
@@ -440,7 +576,7 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	fs_unmount();
 
 	return ret;
 }
@@ -7,86 +7,180 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <fs_internal.h>
+#include <malloc.h>
 #include <part.h>
 #include <memalign.h>
 
-int fs_devread(struct blk_desc *blk, disk_partition_t *partition,
-	       lbaint_t sector, int byte_offset, int byte_len, char *buf)
+/*
+ * Read 'len' bytes from byte 'pos' of a partition into 'buf'. Whole sectors
+ * are read straight into the buffer with a single block read. A cache-aligned
+ * bounce buffer is only used for partial sectors at either end and, if 'buf'
+ * is not aligned for DMA, for the last whole sector: the others are then read
+ * to the first aligned address in 'buf' and moved down into place.
+ */
+int fs_read_range(struct blk_desc *blk, disk_partition_t *partition, u64 pos,
+		  u64 len, void *buf)
 {
-	unsigned block_len;
-	int log2blksz;
 	ALLOC_CACHE_ALIGN_BUFFER(char, sec_buf, (blk ? blk->blksz : 0));
-	if (blk == NULL) {
+	lbaint_t sector, nsect;
+	ulong misalign;
+	char *p = buf;
+	u64 n;
+
+	if (!blk) {
 		printf("** Invalid Block Device Descriptor (NULL)\n");
-		return 0;
+		return -EINVAL;
 	}
-	log2blksz = blk->log2blksz;
+	if (!len)
+		return 0;
 
 	/* Check partition boundaries */
-	if ((sector + ((byte_offset + byte_len - 1) >> log2blksz))
-	    >= partition->size) {
-		printf("%s read outside partition " LBAFU "\n", __func__,
-		       sector);
-		return 0;
+	if ((pos + len - 1) >> blk->log2blksz >= partition->size) {
+		printf("%s read outside partition %llu\n", __func__, pos);
+		return -EINVAL;
 	}
 
-	/* Get the read to the beginning of a partition */
-	sector += byte_offset >> log2blksz;
-	byte_offset &= blk->blksz - 1;
-
-	debug(" <" LBAFU ", %d, %d>\n", sector, byte_offset, byte_len);
+	sector = partition->start + (pos >> blk->log2blksz);
+	pos &= blk->blksz - 1;
+	debug(" <" LBAFU ", %llu, %llu>\n", sector, pos, len);
 
-	if (byte_offset != 0) {
-		int readlen;
+	if (pos) {
 		/* read first part which isn't aligned with start of sector */
-		if (blk_dread(blk, partition->start + sector, 1,
-			      (void *)sec_buf) != 1) {
-			printf(" ** %s read error **\n", __func__);
-			return 0;
-		}
-		readlen = min((int)blk->blksz - byte_offset,
-			      byte_len);
-		memcpy(buf, sec_buf + byte_offset, readlen);
-		buf += readlen;
-		byte_len -= readlen;
+		if (blk_dread(blk, sector, 1, sec_buf) != 1)
+			goto err;
+		n = min_t(u64, blk->blksz - pos, len);
+		memcpy(p, sec_buf + pos, n);
 		sector++;
+		p += n;
+		len -= n;
 	}
 
-	if (byte_len == 0)
-		return 1;
+	nsect = len >> blk->log2blksz;
+	misalign = (ulong)p & (ARCH_DMA_MINALIGN - 1);
+	if (nsect && !misalign) {
+		if (blk_dread(blk, sector, nsect, p) != nsect)
+			goto err;
+	} else if (nsect) {
+		n = (u64)(nsect - 1) << blk->log2blksz;
+		if (n) {
+			if (blk_dread(blk, sector, nsect - 1,
+				      p + ARCH_DMA_MINALIGN - misalign) !=
+			    nsect - 1)
+				goto err;
+			memmove(p, p + ARCH_DMA_MINALIGN - misalign, n);
+		}
+		if (blk_dread(blk, sector + nsect - 1, 1, sec_buf) != 1)
+			goto err;
+		memcpy(p + n, sec_buf, blk->blksz);
+	}
+	sector += nsect;
+	p += (u64)nsect << blk->log2blksz;
+	len -= (u64)nsect << blk->log2blksz;
 
-	/* read sector aligned part */
-	block_len = byte_len & ~(blk->blksz - 1);
+	if (len) {
+		/* read rest of data which are not in whole sector */
+		if (blk_dread(blk, sector, 1, sec_buf) != 1)
+			goto err;
+		memcpy(p, sec_buf, len);
+	}
 
-	if (block_len == 0) {
-		ALLOC_CACHE_ALIGN_BUFFER(u8, p, blk->blksz);
+	return 0;
 
-		block_len = blk->blksz;
-		blk_dread(blk, partition->start + sector, 1,
-			  (void *)p);
-		memcpy(buf, p, byte_len);
-		return 1;
-	}
+err:
+	printf(" ** %s read error at sector " LBAFU " **\n", __func__, sector);
+	return -EIO;
+}
 
-	if (blk_dread(blk, partition->start + sector,
-		      block_len >> log2blksz, (void *)buf) !=
-			block_len >> log2blksz) {
-		printf(" ** %s read error - block\n", __func__);
+int fs_devread(struct blk_desc *blk, disk_partition_t *partition,
+	       lbaint_t sector, int byte_offset, int byte_len, char *buf)
+{
+	if (!blk) {
+		printf("** Invalid Block Device Descriptor (NULL)\n");
 		return 0;
 	}
-	block_len = byte_len & ~(blk->blksz - 1);
-	buf += block_len;
-	byte_len -= block_len;
-	sector += block_len / blk->blksz;
 
-	if (byte_len != 0) {
-		/* read rest of data which are not in whole sector */
-		if (blk_dread(blk, partition->start + sector, 1,
-			      (void *)sec_buf) != 1) {
-			printf("* %s read error - last part\n", __func__);
+	return !fs_read_range(blk, partition,
+			      ((u64)sector << blk->log2blksz) + byte_offset,
+			      byte_len, buf);
+}
+
+static int fs_walk(const char *path, void *inode,
+		   const struct fs_walk_ops *ops, int symlinks);
+
+/*
+ * Look up the symlink @inode, of @size bytes, met at @cur in @path, with
+ * what follows it in the path at @rest appended
+ */
+static int fs_follow(const char *path, const char *cur, const char *rest,
+		     void *inode, const struct fs_walk_ops *ops, u64 size,
+		     int symlinks)
+{
+	char *target, *next;
+	u32 prefix;
+	int ret;
+
+	if (!symlinks)
+		return -ELOOP;
+	if (size > FS_MAX_TARGET)
+		return -ENAMETOOLONG;
+
+	target = malloc(size + 1);
+	if (!target)
+		return -ENOMEM;
+	ret = ops->read_link(inode, target, size);
+	if (ret)
+		goto out;
+	target[size] = '\0';
+
+	/* A relative target is looked up in the directory holding the link */
+	prefix = *target == '/' ? 0 : cur - path;
+	next = malloc(prefix + size + strlen(rest) + 1);
+	if (!next) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	memcpy(next, path, prefix);
+	strcpy(next + prefix, target);
+	strcat(next, rest);
+
+	ret = fs_walk(next, inode, ops, symlinks - 1);
+	free(next);
+out:
+	free(target);
+	return ret;
+}
+
+static int fs_walk(const char *path, void *inode,
+		   const struct fs_walk_ops *ops, int symlinks)
+{
+	const char *cur = path, *end;
+	u64 size;
+	int ret;
+
+	ret = ops->root(inode);
+	if (ret)
+		return ret;
+
+	for (;;) {
+		while (*cur == '/')
+			cur++;
+		if (!*cur)
 			return 0;
-		}
-		memcpy(buf, sec_buf, byte_len);
+		end = strchrnul(cur, '/');
+
+		ret = ops->lookup(inode, cur, end - cur);
+		if (ret)
+			return ret;
+
+		if (ops->is_link(inode, &size))
+			return fs_follow(path, cur, end, inode, ops, size,
+					 symlinks);
+		cur = end;
 	}
-	return 1;
+}
+
+int fs_walk_path(const char *path, void *inode, const struct fs_walk_ops *ops)
+{
+	return fs_walk(path, inode, ops, FS_MAX_SYMLINKS);
 }
@@ -0,0 +1,993 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Read-only SquashFS 4.0 support
+ *
+ * Directories are decoded as they are walked, stopping at the entry wanted,
+ * rather than being read in full. Decompressed metadata and fragment blocks
+ * are kept in small LRU caches, since the inodes, directory entries and file
+ * tails looked up one after the other tend to share blocks.
+ */
+
+#include <common.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <squashfs.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include "squashfs_fs.h"
+#include "sqfs_decompressor.h"
+
+/* Number of decompressed metadata and fragment blocks to keep */
+#define SQFS_META_CACHE		8
+#define SQFS_FRAG_CACHE		2
+
+/* Most data blocks read from the device at once, in bytes */
+#define SQFS_READ_RUN		SZ_1M
+
+#define SQFS_MAX_DEPTH		32
+
+/**
+ * struct sqfs_cache_entry - A decompressed metadata or fragment block
+ *
+ * @addr: Position of the block on the device, -1ULL if the entry is unused
+ * @next: Position of the following metadata block
+ * @len: Length of the decompressed data
+ * @stamp: When the entry was last used, to find the least recently used
+ * @data: Decompressed data
+ */
+struct sqfs_cache_entry {
+	u64 addr;
+	u64 next;
+	u32 len;
+	ulong stamp;
+	char *data;
+};
+
+struct sqfs_cache {
+	struct sqfs_cache_entry *entries;
+	int count;
+	u32 size;
+};
+
+/* A position in the inode or directory table */
+struct sqfs_meta_pos {
+	u64 block;
+	u32 offset;
+};
+
+/**
+ * struct sqfs_inode - The parts of an inode needed to read it
+ *
+ * @type: Basic inode type, SQFS_..._TYPE, also for extended inodes
+ * @size: Size of the file, or length of the directory listing or target
+ * @start: Position of the first data block, or of the directory listing
+ *	from the start of the directory table
+ * @offset: Offset of the directory listing in its metadata block
+ * @frag: Fragment holding the end of the file, or SQFS_INVALID_FRAG
+ * @frag_offset: Offset of the end of the file in the fragment block
+ * @i_count: Number of entries in the directory index
+ * @pos: What follows the inode, i.e. the list of block sizes, the directory
+ *	index or the symlink target
+ */
+struct sqfs_inode {
+	u16 type;
+	u64 size;
+	u64 start;
+	u32 offset;
+	u32 frag;
+	u32 frag_offset;
+	u16 i_count;
+	struct sqfs_meta_pos pos;
+};
+
+struct sqfs_dir_iter {
+	struct sqfs_meta_pos pos;
+	u64 left;		/* bytes left in the listing */
+	u32 count;		/* entries left under the current header */
+	u32 inode_block;	/* metadata block holding their inodes */
+};
+
+struct sqfs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct sqfs_dir_iter iter;
+};
+
+static struct sqfs_info {
+	struct blk_desc *desc;
+	disk_partition_t part;
+	u16 comp;
+	u32 block_size;
+	u64 bytes_used;
+	u64 root_inode;
+	u64 inode_table;
+	u64 dir_table;
+	u32 frags;
+	__le64 *frag_index;
+	struct sqfs_cache meta;
+	struct sqfs_cache frag;
+	ulong clock;
+	char *cbuf;		/* compressed metadata or fragment block */
+} *sqfs;
+
+static int sqfs_devread(u64 addr, u32 len, void *buf)
+{
+	if (addr + len > sqfs->bytes_used)
+		return -EIO;
+
+	return fs_read_range(sqfs->desc, &sqfs->part, addr, len, buf);
+}
+
+static int sqfs_cache_init(struct sqfs_cache *cache, int count, u32 size)
+{
+	int i;
+
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+	cache->count = count;
+	cache->size = size;
+	for (i = 0; i < count; i++)
+		cache->entries[i].addr = -1ULL;
+
+	return 0;
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	int i;
+
+	if (!cache->entries)
+		return;
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+	free(cache->entries);
+	cache->entries = NULL;
+}
+
+/*
+ * Find the block at @addr in @cache. If it is not there, return the least
+ * recently used entry for the caller to fill in, with *@hitp false.
+ */
+static struct sqfs_cache_entry *sqfs_cache_get(struct sqfs_cache *cache,
+					       u64 addr, bool *hitp)
+{
+	struct sqfs_cache_entry *entry, *lru = cache->entries;
+	int i;
+
+	for (i = 0, entry = cache->entries; i < cache->count; i++, entry++) {
+		if (entry->addr == addr) {
+			entry->stamp = ++sqfs->clock;
+			*hitp = true;
+			return entry;
+		}
+		if (entry->stamp < lru->stamp)
+			lru = entry;
+	}
+
+	*hitp = false;
+	if (!lru->data) {
+		lru->data = malloc(cache->size);
+		if (!lru->data)
+			return NULL;
+	}
+	lru->addr = -1ULL;
+	lru->stamp = ++sqfs->clock;
+
+	return lru;
+}
+
+static int sqfs_read_meta(u64 addr, struct sqfs_cache_entry **entryp)
+{
+	struct sqfs_cache_entry *entry;
+	__le16 hdr;
+	u32 len, dlen;
+	bool hit;
+	int ret;
+
+	entry = sqfs_cache_get(&sqfs->meta, addr, &hit);
+	if (!entry)
+		return -ENOMEM;
+	*entryp = entry;
+	if (hit)
+		return 0;
+
+	ret = sqfs_devread(addr, sizeof(hdr), &hdr);
+	if (ret)
+		return ret;
+	len = SQFS_META_LEN(le16_to_cpu(hdr));
+	if (!len || len > SQFS_METADATA_SIZE)
+		return -EIO;
+
+	if (le16_to_cpu(hdr) & SQFS_META_UNCOMPRESSED) {
+		ret = sqfs_devread(addr + sizeof(hdr), len, entry->data);
+		dlen = len;
+	} else {
+		ret = sqfs_devread(addr + sizeof(hdr), len, sqfs->cbuf);
+		dlen = SQFS_METADATA_SIZE;
+		if (!ret)
+			ret = sqfs_decompress(sqfs->comp, entry->data, &dlen,
+					      sqfs->cbuf, len);
+	}
+	if (ret)
+		return ret;
+
+	entry->addr = addr;
+	entry->next = addr + sizeof(hdr) + len;
+	entry->len = dlen;
+
+	return 0;
+}
+
+/*
+ * Copy @len bytes of metadata at @pos to @buf, or skip them if @buf is NULL,
+ * and move @pos past them
+ */
+static int sqfs_meta_read(struct sqfs_meta_pos *pos, void *buf, u32 len)
+{
+	struct sqfs_cache_entry *entry;
+	u32 n;
+	int ret;
+
+	while (len) {
+		ret = sqfs_read_meta(pos->block, &entry);
+		if (ret)
+			return ret;
+		if (pos->offset >= entry->len) {
+			pos->offset -= entry->len;
+			pos->block = entry->next;
+			continue;
+		}
+
+		n = min(len, entry->len - pos->offset);
+		if (buf) {
+			memcpy(buf, entry->data + pos->offset, n);
+			buf += n;
+		}
+		pos->offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int sqfs_read_inode(u64 ref, struct sqfs_inode *inode)
+{
+	union {
+		struct squashfs_base_inode base;
+		struct squashfs_dir_inode dir;
+		struct squashfs_ldir_inode ldir;
+		struct squashfs_reg_inode reg;
+		struct squashfs_lreg_inode lreg;
+		struct squashfs_symlink_inode symlink;
+	} i;
+	struct sqfs_meta_pos *pos = &inode->pos;
+	u16 type;
+	u32 size;
+	int ret;
+
+	pos->block = sqfs->inode_table + SQFS_REF_BLOCK(ref);
+	pos->offset = SQFS_REF_OFFSET(ref);
+	ret = sqfs_meta_read(pos, &i.base, sizeof(i.base));
+	if (ret)
+		return ret;
+
+	type = le16_to_cpu(i.base.inode_type);
+	switch (type) {
+	case SQFS_DIR_TYPE:
+		size = sizeof(i.dir);
+		break;
+	case SQFS_LDIR_TYPE:
+		size = sizeof(i.ldir);
+		break;
+	case SQFS_REG_TYPE:
+		size = sizeof(i.reg);
+		break;
+	case SQFS_LREG_TYPE:
+		size = sizeof(i.lreg);
+		break;
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		size = sizeof(i.symlink);
+		break;
+	default:
+		size = sizeof(i.base);
+		break;
+	}
+	ret = sqfs_meta_read(pos, (char *)&i + sizeof(i.base),
+			     size - sizeof(i.base));
+	if (ret)
+		return ret;
+
+	memset(inode, '\0', offsetof(struct sqfs_inode, pos));
+	inode->type = (type - 1) % SQFS_TYPES + 1;
+	inode->frag = SQFS_INVALID_FRAG;
+	switch (type) {
+	case SQFS_DIR_TYPE:
+		inode->size = le16_to_cpu(i.dir.file_size);
+		inode->start = le32_to_cpu(i.dir.start_block);
+		inode->offset = le16_to_cpu(i.dir.offset);
+		break;
+	case SQFS_LDIR_TYPE:
+		inode->size = le32_to_cpu(i.ldir.file_size);
+		inode->start = le32_to_cpu(i.ldir.start_block);
+		inode->offset = le16_to_cpu(i.ldir.offset);
+		inode->i_count = le16_to_cpu(i.ldir.i_count);
+		break;
+	case SQFS_REG_TYPE:
+		inode->size = le32_to_cpu(i.reg.file_size);
+		inode->start = le32_to_cpu(i.reg.start_block);
+		inode->frag = le32_to_cpu(i.reg.fragment);
+		inode->frag_offset = le32_to_cpu(i.reg.offset);
+		break;
+	case SQFS_LREG_TYPE:
+		inode->size = le64_to_cpu(i.lreg.file_size);
+		inode->start = le64_to_cpu(i.lreg.start_block);
+		inode->frag = le32_to_cpu(i.lreg.fragment);
+		inode->frag_offset = le32_to_cpu(i.lreg.offset);
+		break;
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		inode->size = le32_to_cpu(i.symlink.symlink_size);
+		break;
+	}
+
+	return 0;
+}
+
+static void sqfs_dir_open(const struct sqfs_inode *dir,
+			  struct sqfs_dir_iter *iter)
+{
+	iter->pos.block = sqfs->dir_table + dir->start;
+	iter->pos.offset = dir->offset;
+	/* The size counts 3 bytes for the "." and ".." entries, not stored */
+	iter->left = dir->size > 3 ? dir->size - 3 : 0;
+	iter->count = 0;
+}
+
+/*
+ * Start @iter at the last part of the directory listing, as given by the
+ * directory index, whose first name does not come after @name
+ */
+static int sqfs_dir_seek(const struct sqfs_inode *dir, const char *name,
+			 struct sqfs_dir_iter *iter)
+{
+	struct sqfs_meta_pos pos = dir->pos;
+	struct squashfs_dir_index index;
+	char first[SQFS_NAME_LEN + 1];
+	u32 len, skip = 0, block = dir->start;
+	int i, ret;
+
+	for (i = 0; i < dir->i_count; i++) {
+		ret = sqfs_meta_read(&pos, &index, sizeof(index));
+		if (ret)
+			return ret;
+		len = le32_to_cpu(index.size) + 1;
+		if (len > SQFS_NAME_LEN)
+			return -EIO;
+		ret = sqfs_meta_read(&pos, first, len);
+		if (ret)
+			return ret;
+		first[len] = '\0';
+		if (strcmp(first, name) > 0)
+			break;
+		skip = le32_to_cpu(index.index);
+		block = le32_to_cpu(index.start_block);
+	}
+
+	if (skip > iter->left)
+		return -EIO;
+	iter->pos.block = sqfs->dir_table + block;
+	iter->pos.offset = (dir->offset + skip) % SQFS_METADATA_SIZE;
+	iter->left -= skip;
+
+	return 0;
+}
+
+/*
+ * Read the next directory entry into @name, which must have room for
+ * SQFS_NAME_LEN + 1 bytes. Returns 0 if OK, 1 at the end of the directory,
+ * or -ve on error.
+ */
+static int sqfs_dir_next(struct sqfs_dir_iter *iter, char *name, u64 *refp,
+			 u16 *typep)
+{
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry entry;
+	u32 len;
+	int ret;
+
+	if (!iter->count) {
+		if (iter->left < sizeof(hdr))
+			return 1;
+		ret = sqfs_meta_read(&iter->pos, &hdr, sizeof(hdr));
+		if (ret)
+			return ret;
+		iter->left -= sizeof(hdr);
+		iter->count = le32_to_cpu(hdr.count) + 1;
+		iter->inode_block = le32_to_cpu(hdr.start_block);
+		if (iter->count > SQFS_MAX_DIR_ENTRIES)
+			return -EIO;
+	}
+
+	if (iter->left < sizeof(entry))
+		return -EIO;
+	ret = sqfs_meta_read(&iter->pos, &entry, sizeof(entry));
+	if (ret)
+		return ret;
+	len = le16_to_cpu(entry.size) + 1;
+	if (len > SQFS_NAME_LEN || iter->left < sizeof(entry) + len)
+		return -EIO;
+	ret = sqfs_meta_read(&iter->pos, name, len);
+	if (ret)
+		return ret;
+	name[len] = '\0';
+	iter->left -= sizeof(entry) + len;
+	iter->count--;
+
+	*refp = (u64)iter->inode_block << 16 | le16_to_cpu(entry.offset);
+	*typep = le16_to_cpu(entry.type);
+
+	return 0;
+}
+
+static int sqfs_dir_lookup(const struct sqfs_inode *dir, const char *name,
+			   u64 *refp)
+{
+	struct sqfs_dir_iter iter;
+	char entry[SQFS_NAME_LEN + 1];
+	u16 type;
+	int ret;
+
+	sqfs_dir_open(dir, &iter);
+	if (dir->i_count) {
+		ret = sqfs_dir_seek(dir, name, &iter);
+		if (ret)
+			return ret;
+	}
+
+	while (!(ret = sqfs_dir_next(&iter, entry, refp, &type))) {
+		if (!strcmp(entry, name))
+			return 0;
+		/* Entries are sorted by name */
+		if ((u8)entry[0] > (u8)name[0])
+			break;
+	}
+
+	return ret < 0 ? ret : -ENOENT;
+}
+
+/**
+ * struct sqfs_walk - State of a path lookup
+ *
+ * Directories do not list "." and "..", so the lookup keeps the directories
+ * it went through to go back up.
+ *
+ * @inode: Inode reached
+ * @ref: Reference of @inode
+ * @refs: References of the directories above it
+ * @depth: Number of entries in @refs
+ */
+struct sqfs_walk {
+	struct sqfs_inode inode;
+	u64 ref;
+	u64 refs[SQFS_MAX_DEPTH];
+	int depth;
+};
+
+static int sqfs_walk_root(void *priv)
+{
+	struct sqfs_walk *walk = priv;
+
+	walk->ref = sqfs->root_inode;
+	walk->depth = 0;
+
+	return sqfs_read_inode(walk->ref, &walk->inode);
+}
+
+static int sqfs_walk_lookup(void *priv, const char *cur, int len)
+{
+	struct sqfs_walk *walk = priv;
+	char name[SQFS_NAME_LEN + 1];
+	int ret;
+
+	if (len == 1 && *cur == '.')
+		return 0;
+	if (len == 2 && !strncmp(cur, "..", 2)) {
+		if (!walk->depth)
+			return 0;
+		walk->ref = walk->refs[--walk->depth];
+		return sqfs_read_inode(walk->ref, &walk->inode);
+	}
+
+	if (walk->inode.type != SQFS_DIR_TYPE)
+		return -ENOTDIR;
+	if (len > SQFS_NAME_LEN || walk->depth == SQFS_MAX_DEPTH)
+		return -ENAMETOOLONG;
+	memcpy(name, cur, len);
+	name[len] = '\0';
+
+	walk->refs[walk->depth++] = walk->ref;
+	ret = sqfs_dir_lookup(&walk->inode, name, &walk->ref);
+	if (ret)
+		return ret;
+
+	return sqfs_read_inode(walk->ref, &walk->inode);
+}
+
+static bool sqfs_walk_is_link(const void *priv, u64 *sizep)
+{
+	const struct sqfs_walk *walk = priv;
+
+	*sizep = walk->inode.size;
+
+	return walk->inode.type == SQFS_SYMLINK_TYPE;
+}
+
+static int sqfs_walk_read_link(void *priv, char *buf, u64 size)
+{
+	struct sqfs_walk *walk = priv;
+	struct sqfs_meta_pos pos = walk->inode.pos;
+
+	return sqfs_meta_read(&pos, buf, size);
+}
+
+static const struct fs_walk_ops sqfs_walk_ops = {
+	.root		= sqfs_walk_root,
+	.lookup		= sqfs_walk_lookup,
+	.is_link	= sqfs_walk_is_link,
+	.read_link	= sqfs_walk_read_link,
+};
+
+static int sqfs_lookup(const char *path, struct sqfs_inode *inode)
+{
+	struct sqfs_walk walk;
+	int ret;
+
+	ret = fs_walk_path(path, &walk, &sqfs_walk_ops);
+	if (!ret)
+		*inode = walk.inode;
+
+	return ret;
+}
+
+static int sqfs_read_frag(u32 frag, struct sqfs_cache_entry **entryp)
+{
+	struct squashfs_fragment_entry fe;
+	struct sqfs_cache_entry *entry;
+	struct sqfs_meta_pos pos;
+	u32 size, len, dlen;
+	u64 start;
+	bool hit;
+	int ret;
+
+	if (frag >= sqfs->frags)
+		return -EIO;
+	pos.block = le64_to_cpu(sqfs->frag_index[frag / SQFS_FRAGS_PER_BLOCK]);
+	pos.offset = frag % SQFS_FRAGS_PER_BLOCK * sizeof(fe);
+	ret = sqfs_meta_read(&pos, &fe, sizeof(fe));
+	if (ret)
+		return ret;
+	start = le64_to_cpu(fe.start_block);
+	size = le32_to_cpu(fe.size);
+	len = SQFS_BLOCK_LEN(size);
+	if (!len || len > sqfs->block_size)
+		return -EIO;
+
+	entry = sqfs_cache_get(&sqfs->frag, start, &hit);
+	if (!entry)
+		return -ENOMEM;
+	*entryp = entry;
+	if (hit)
+		return 0;
+
+	if (size & SQFS_BLOCK_UNCOMPRESSED) {
+		ret = sqfs_devread(start, len, entry->data);
+		dlen = len;
+	} else {
+		ret = sqfs_devread(start, len, sqfs->cbuf);
+		dlen = sqfs->block_size;
+		if (!ret)
+			ret = sqfs_decompress(sqfs->comp, entry->data, &dlen,
+					      sqfs->cbuf, len);
+	}
+	if (ret)
+		return ret;
+
+	entry->addr = start;
+	entry->len = dlen;
+
+	return 0;
+}
+
+/*
+ * Work out which part of data block @i of @inode, from @from to @to in the
+ * file, falls within the @offset to @end being read. Returns true if that is
+ * the whole block.
+ */
+static bool sqfs_block_part(const struct sqfs_inode *inode, u32 i, u64 offset,
+			    u64 end, u64 *from, u64 *to)
+{
+	u64 bstart = (u64)i * sqfs->block_size;
+	u64 bend = min(bstart + sqfs->block_size, inode->size);
+
+	*from = max(offset, bstart);
+	*to = min(end, bend);
+
+	return *from == bstart && *to == bend;
+}
+
+/*
+ * Read @len bytes at @offset from the data blocks of @inode into @buf. The
+ * compressed blocks are read a run at a time, and uncompressed blocks which
+ * are wanted in full go straight to @buf.
+ */
+static int sqfs_read_blocks(const struct sqfs_inode *inode, u64 offset,
+			    u64 len, char *buf)
+{
+	const u32 bs = sqfs->block_size;
+	const u32 run = max_t(u32, bs, SQFS_READ_RUN);
+	struct sqfs_meta_pos pos = inode->pos;
+	u64 addr = inode->start, end = offset + len, bstart, from, to;
+	u32 first, last, i, j, n, size, blen, dlen;
+	char *rbuf = NULL, *dbuf = NULL, *p, *dst;
+	__le32 *sizes;
+	bool whole;
+	int ret;
+
+	first = offset / bs;
+	last = DIV_ROUND_UP(end, bs);
+	if (inode->frag != SQFS_INVALID_FRAG)
+		last = min_t(u64, last, inode->size / bs);
+	if (first >= last)
+		return 0;
+
+	sizes = malloc(last * sizeof(*sizes));
+	if (!sizes)
+		return -ENOMEM;
+	ret = sqfs_meta_read(&pos, sizes, last * sizeof(*sizes));
+	if (ret)
+		goto out;
+	for (i = 0; i < first; i++)
+		addr += SQFS_BLOCK_LEN(le32_to_cpu(sizes[i]));
+
+	/* Blocks must fit in a block, and stored ones must be complete */
+	for (i = first; i < last; i++) {
+		size = le32_to_cpu(sizes[i]);
+		blen = SQFS_BLOCK_LEN(size);
+		n = min_t(u64, bs, inode->size - (u64)i * bs);
+		if (blen > bs ||
+		    (blen && size & SQFS_BLOCK_UNCOMPRESSED && blen != n)) {
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	for (i = first; i < last; i = j) {
+		size = le32_to_cpu(sizes[i]);
+		whole = sqfs_block_part(inode, i, offset, end, &from, &to);
+		if (!SQFS_BLOCK_LEN(size)) {
+			memset(buf + (from - offset), '\0', to - from);
+			j = i + 1;
+			continue;
+		}
+
+		if (size & SQFS_BLOCK_UNCOMPRESSED && whole) {
+			p = buf + (from - offset);
+			for (j = i, n = 0; j < last; j++) {
+				size = le32_to_cpu(sizes[j]);
+				if (!(size & SQFS_BLOCK_UNCOMPRESSED) ||
+				    !SQFS_BLOCK_LEN(size) || n >= SZ_1G ||
+				    !sqfs_block_part(inode, j, offset, end,
+						     &from, &to))
+					break;
+				n += SQFS_BLOCK_LEN(size);
+			}
+			ret = sqfs_devread(addr, n, p);
+			if (ret)
+				goto out;
+			addr += n;
+			continue;
+		}
+
+		if (!rbuf) {
+			rbuf = malloc(run);
+			if (!rbuf) {
+				ret = -ENOMEM;
+				goto out;
+			}
+		}
+		for (j = i, n = 0; j < last; j++) {
+			blen = SQFS_BLOCK_LEN(le32_to_cpu(sizes[j]));
+			if (!blen || n + blen > run)
+				break;
+			n += blen;
+		}
+		ret = sqfs_devread(addr, n, rbuf);
+		if (ret)
+			goto out;
+		addr += n;
+
+		for (p = rbuf; i < j; p += blen, i++) {
+			size = le32_to_cpu(sizes[i]);
+			blen = SQFS_BLOCK_LEN(size);
+			bstart = (u64)i * bs;
+			whole = sqfs_block_part(inode, i, offset, end, &from,
+						&to);
+			dst = buf + (from - offset);
+
+			if (size & SQFS_BLOCK_UNCOMPRESSED) {
+				memcpy(dst, p + (from - bstart), to - from);
+				continue;
+			}
+
+			n = min_t(u64, bs, inode->size - bstart);
+			dlen = n;
+			if (whole) {
+				ret = sqfs_decompress(sqfs->comp, dst, &dlen, p,
+						      blen);
+			} else {
+				if (!dbuf)
+					dbuf = malloc(bs);
+				if (!dbuf) {
+					ret = -ENOMEM;
+					goto out;
+				}
+				ret = sqfs_decompress(sqfs->comp, dbuf, &dlen,
+						      p, blen);
+				if (!ret)
+					memcpy(dst, dbuf + (from - bstart),
+					       to - from);
+			}
+			if (!ret && dlen != n)
+				ret = -EIO;
+			if (ret)
+				goto out;
+		}
+	}
+
+out:
+	free(dbuf);
+	free(rbuf);
+	free(sizes);
+	return ret;
+}
+
+static int sqfs_read_file(const struct sqfs_inode *inode, u64 offset, u64 len,
+			  char *buf)
+{
+	struct sqfs_cache_entry *entry;
+	u64 tail, from;
+	int ret;
+
+	ret = sqfs_read_blocks(inode, offset, len, buf);
+	if (ret || inode->frag == SQFS_INVALID_FRAG)
+		return ret;
+
+	/* The end of the file is in a fragment block, shared with others */
+	tail = inode->size - inode->size % sqfs->block_size;
+	if (offset + len <= tail)
+		return 0;
+	from = max(offset, tail);
+
+	ret = sqfs_read_frag(inode->frag, &entry);
+	if (ret)
+		return ret;
+	if (inode->frag_offset + (inode->size - tail) > entry->len)
+		return -EIO;
+	memcpy(buf + (from - offset),
+	       entry->data + inode->frag_offset + (from - tail),
+	       offset + len - from);
+
+	return 0;
+}
+
+void sqfs_close(void)
+{
+	if (!sqfs)
+		return;
+
+	sqfs_cache_free(&sqfs->meta);
+	sqfs_cache_free(&sqfs->frag);
+	free(sqfs->frag_index);
+	free(sqfs->cbuf);
+	free(sqfs);
+	sqfs = NULL;
+}
+
+int sqfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct squashfs_super_block sb;
+	u32 count;
+	u16 block_log;
+	int ret;
+
+	sqfs_close();
+
+	if (!fs_devread(fs_dev_desc, fs_partition, 0, 0, sizeof(sb),
+			(char *)&sb))
+		return -EIO;
+	if (le32_to_cpu(sb.s_magic) != SQFS_MAGIC)
+		return -EINVAL;
+
+	block_log = le16_to_cpu(sb.block_log);
+	if (le16_to_cpu(sb.s_major) != SQFS_MAJOR ||
+	    block_log < SQFS_MIN_BLOCK_LOG || block_log > SQFS_MAX_BLOCK_LOG ||
+	    le32_to_cpu(sb.block_size) != 1 << block_log) {
+		printf("squashfs: unsupported version or block size\n");
+		return -EINVAL;
+	}
+	if (!sqfs_comp_supported(le16_to_cpu(sb.compression))) {
+		printf("squashfs: unsupported compression type %u\n",
+		       le16_to_cpu(sb.compression));
+		return -EPROTONOSUPPORT;
+	}
+
+	sqfs = calloc(1, sizeof(*sqfs));
+	if (!sqfs)
+		return -ENOMEM;
+	sqfs->desc = fs_dev_desc;
+	sqfs->part = *fs_partition;
+	sqfs->comp = le16_to_cpu(sb.compression);
+	sqfs->block_size = le32_to_cpu(sb.block_size);
+	sqfs->bytes_used = min(le64_to_cpu(sb.bytes_used),
+			       (u64)fs_partition->size * fs_partition->blksz);
+	sqfs->root_inode = le64_to_cpu(sb.root_inode);
+	sqfs->inode_table = le64_to_cpu(sb.inode_table_start);
+	sqfs->dir_table = le64_to_cpu(sb.directory_table_start);
+
+	ret = -ENOMEM;
+	sqfs->cbuf = malloc(max_t(u32, sqfs->block_size, SQFS_METADATA_SIZE));
+	if (!sqfs->cbuf ||
+	    sqfs_cache_init(&sqfs->meta, SQFS_META_CACHE, SQFS_METADATA_SIZE) ||
+	    sqfs_cache_init(&sqfs->frag, SQFS_FRAG_CACHE, sqfs->block_size))
+		goto err;
+
+	/* The fragment table is indexed by the positions of its blocks */
+	sqfs->frags = le32_to_cpu(sb.fragments);
+	if (sqfs->frags) {
+		count = DIV_ROUND_UP(sqfs->frags, SQFS_FRAGS_PER_BLOCK);
+		sqfs->frag_index = malloc(count * sizeof(__le64));
+		if (!sqfs->frag_index)
+			goto err;
+		ret = sqfs_devread(le64_to_cpu(sb.fragment_table_start),
+				   count * sizeof(__le64), sqfs->frag_index);
+		if (ret)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	sqfs_close();
+	return ret;
+}
+
+int sqfs_is_mounted(struct blk_desc *fs_dev_desc,
+		    disk_partition_t *fs_partition)
+{
+	return sqfs && sqfs->desc == fs_dev_desc &&
+	       sqfs->part.start == fs_partition->start &&
+	       sqfs->part.size == fs_partition->size;
+}
+
+int sqfs_exists(const char *filename)
+{
+	struct sqfs_inode inode;
+
+	return !sqfs_lookup(filename, &inode);
+}
+
+int sqfs_size(const char *filename, loff_t *size)
+{
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+	if (inode.type != SQFS_REG_TYPE)
+		return -EISDIR;
+	*size = inode.size;
+
+	return 0;
+}
+
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread)
+{
+	struct sqfs_inode inode;
+	int ret;
+
+	*actread = 0;
+	ret = sqfs_lookup(filename, &inode);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		return ret;
+	}
+	if (inode.type != SQFS_REG_TYPE)
+		return -EISDIR;
+
+	if (offset >= inode.size)
+		return 0;
+	if (!len || len > inode.size - offset)
+		len = inode.size - offset;
+
+	ret = sqfs_read_file(&inode, offset, len, buf);
+	if (ret) {
+		printf("** Error reading file %s **\n", filename);
+		return ret;
+	}
+	*actread = len;
+
+	return 0;
+}
+
+int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct sqfs_dir_stream *dirs;
+	struct sqfs_inode inode;
+	int ret;
+
+	ret = sqfs_lookup(filename, &inode);
+	if (ret)
+		return ret;
+	if (inode.type != SQFS_DIR_TYPE)
+		return -ENOTDIR;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+	sqfs_dir_open(&inode, &dirs->iter);
+	*dirsp = &dirs->parent;
+
+	return 0;
+}
+
+int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct sqfs_dir_stream *dirs = (struct sqfs_dir_stream *)fs_dirs;
+	struct fs_dirent *dent = &dirs->dirent;
+	struct sqfs_inode inode;
+	char name[SQFS_NAME_LEN + 1];
+	u64 ref;
+	u16 type;
+	int ret;
+
+	ret = sqfs_dir_next(&dirs->iter, name, &ref, &type);
+	if (ret)
+		return ret < 0 ? ret : -ENOENT;
+	/* Squashfs allows one more character than fs_dirent has room for */
+	if (strlen(name) >= sizeof(dent->name))
+		return -ENAMETOOLONG;
+	strcpy(dent->name, name);
+
+	dent->size = 0;
+	switch (type) {
+	case SQFS_DIR_TYPE:
+		dent->type = FS_DT_DIR;
+		break;
+	case SQFS_REG_TYPE:
+		dent->type = FS_DT_REG;
+		ret = sqfs_read_inode(ref, &inode);
+		if (ret)
+			return ret;
+		dent->size = inode.size;
+		break;
+	case SQFS_SYMLINK_TYPE:
+		dent->type = FS_DT_LNK;
+		break;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+	*dentp = dent;
+
+	return 0;
+}
+
+void sqfs_closedir(struct fs_dir_stream *dirs)
+{
+	free(dirs);
+}
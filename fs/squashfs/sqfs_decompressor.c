@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompression of SquashFS metadata, data and fragment blocks
+ */
+
+#include <common.h>
+#include <linux/errno.h>
+#include <linux/lzo.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <lzma/LzmaTools.h>
+#include "squashfs_fs.h"
+#include "sqfs_decompressor.h"
+
+bool sqfs_comp_supported(u16 comp)
+{
+	switch (comp) {
+	case SQFS_COMP_ZLIB:
+		return true;
+	case SQFS_COMP_LZMA:
+		return IS_ENABLED(CONFIG_LZMA);
+	case SQFS_COMP_LZO:
+		return IS_ENABLED(CONFIG_LZO);
+	case SQFS_COMP_LZ4:
+		return IS_ENABLED(CONFIG_LZ4);
+	default:
+		return false;
+	}
+}
+
+int sqfs_decompress(u16 comp, void *dst, u32 *dstlen, void *src, u32 srclen)
+{
+	switch (comp) {
+	case SQFS_COMP_ZLIB: {
+		unsigned long len = srclen;
+
+		/* zunzip() inflates what follows the 2-byte zlib header */
+		if (srclen < 2 || zunzip(dst, *dstlen, src, &len, 1, 2))
+			return -EIO;
+		*dstlen = len;
+		return 0;
+	}
+#ifdef CONFIG_LZMA
+	case SQFS_COMP_LZMA: {
+		SizeT len = *dstlen;
+
+		if (lzmaBuffToBuffDecompress(dst, &len, src, srclen) != SZ_OK)
+			return -EIO;
+		*dstlen = len;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_LZO
+	case SQFS_COMP_LZO: {
+		size_t len = *dstlen;
+
+		if (lzo1x_decompress_safe(src, srclen, dst, &len) != LZO_E_OK)
+			return -EIO;
+		*dstlen = len;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_LZ4
+	case SQFS_COMP_LZ4: {
+		size_t len = *dstlen;
+
+		if (ulz4_block(src, srclen, dst, &len))
+			return -EIO;
+		*dstlen = len;
+		return 0;
+	}
+#endif
+	default:
+		return -EPROTONOSUPPORT;
+	}
+}
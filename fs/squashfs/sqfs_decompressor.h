@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Decompression of SquashFS metadata, data and fragment blocks
+ */
+
+#ifndef __SQFS_DECOMPRESSOR_H__
+#define __SQFS_DECOMPRESSOR_H__
+
+#include <linux/types.h>
+
+/**
+ * sqfs_comp_supported() - Check whether blocks can be decompressed
+ *
+ * @comp: Compression type, SQFS_COMP_...
+ * @return true if blocks compressed that way can be read
+ */
+bool sqfs_comp_supported(u16 comp);
+
+/**
+ * sqfs_decompress() - Decompress a block
+ *
+ * @comp: Compression type, SQFS_COMP_...
+ * @dst: Buffer for the decompressed data
+ * @dstlen: Size of @dst, updated to the length decompressed
+ * @src: Compressed data
+ * @srclen: Length of @src
+ * @return 0 if OK, -EIO if the data is corrupt or too long for @dst, or
+ *	-EPROTONOSUPPORT if the compression type is not supported
+ */
+int sqfs_decompress(u16 comp, void *dst, u32 *dstlen, void *src, u32 srclen);
+
+#endif /* __SQFS_DECOMPRESSOR_H__ */
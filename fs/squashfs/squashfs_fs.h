@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SquashFS 4.0 on-disk format
+ *
+ * Based on include/linux/squashfs_fs.h from Linux
+ * Copyright (c) 2002-2009 Phillip Lougher <phillip@squashfs.org.uk>
+ */
+
+#ifndef __SQUASHFS_FS_H__
+#define __SQUASHFS_FS_H__
+
+#include <linux/types.h>
+
+#define SQFS_MAGIC			0x73717368
+#define SQFS_MAJOR			4
+
+/* Metadata is kept in blocks of up to 8KiB, each with a 16-bit header */
+#define SQFS_METADATA_SIZE		8192
+#define SQFS_META_UNCOMPRESSED		(1 << 15)
+#define SQFS_META_LEN(hdr)		((hdr) & ~SQFS_META_UNCOMPRESSED)
+
+/* Sizes of data and fragment blocks, 0 for a sparse block */
+#define SQFS_BLOCK_UNCOMPRESSED		(1 << 24)
+#define SQFS_BLOCK_LEN(size)		((size) & ~SQFS_BLOCK_UNCOMPRESSED)
+
+#define SQFS_MIN_BLOCK_LOG		12
+#define SQFS_MAX_BLOCK_LOG		20
+
+#define SQFS_NAME_LEN			256
+#define SQFS_INVALID_FRAG		0xffffffffU
+#define SQFS_MAX_DIR_ENTRIES		256
+
+/* An inode reference: metadata block (from the table start) and offset */
+#define SQFS_REF_BLOCK(ref)		((ref) >> 16)
+#define SQFS_REF_OFFSET(ref)		((ref) & 0xffff)
+
+/* Compression types */
+#define SQFS_COMP_ZLIB			1
+#define SQFS_COMP_LZMA			2
+#define SQFS_COMP_LZO			3
+#define SQFS_COMP_XZ			4
+#define SQFS_COMP_LZ4			5
+#define SQFS_COMP_ZSTD			6
+
+/* Inode types, the extended ones following the basic ones */
+#define SQFS_DIR_TYPE			1
+#define SQFS_REG_TYPE			2
+#define SQFS_SYMLINK_TYPE		3
+#define SQFS_BLKDEV_TYPE		4
+#define SQFS_CHRDEV_TYPE		5
+#define SQFS_FIFO_TYPE			6
+#define SQFS_SOCKET_TYPE		7
+#define SQFS_LDIR_TYPE			8
+#define SQFS_LREG_TYPE			9
+#define SQFS_LSYMLINK_TYPE		10
+#define SQFS_TYPES			7
+
+struct squashfs_super_block {
+	__le32 s_magic;
+	__le32 inodes;
+	__le32 mkfs_time;
+	__le32 block_size;
+	__le32 fragments;
+	__le16 compression;
+	__le16 block_log;
+	__le16 flags;
+	__le16 no_ids;
+	__le16 s_major;
+	__le16 s_minor;
+	__le64 root_inode;
+	__le64 bytes_used;
+	__le64 id_table_start;
+	__le64 xattr_id_table_start;
+	__le64 inode_table_start;
+	__le64 directory_table_start;
+	__le64 fragment_table_start;
+	__le64 lookup_table_start;
+} __packed;
+
+struct squashfs_base_inode {
+	__le16 inode_type;
+	__le16 mode;
+	__le16 uid;
+	__le16 guid;
+	__le32 mtime;
+	__le32 inode_number;
+} __packed;
+
+struct squashfs_dir_inode {
+	struct squashfs_base_inode base;
+	__le32 start_block;
+	__le32 nlink;
+	__le16 file_size;
+	__le16 offset;
+	__le32 parent_inode;
+} __packed;
+
+/* Followed by i_count struct squashfs_dir_index */
+struct squashfs_ldir_inode {
+	struct squashfs_base_inode base;
+	__le32 nlink;
+	__le32 file_size;
+	__le32 start_block;
+	__le32 parent_inode;
+	__le16 i_count;
+	__le16 offset;
+	__le32 xattr;
+} __packed;
+
+/* Followed by the size of each block, as a __le32 */
+struct squashfs_reg_inode {
+	struct squashfs_base_inode base;
+	__le32 start_block;
+	__le32 fragment;
+	__le32 offset;
+	__le32 file_size;
+} __packed;
+
+struct squashfs_lreg_inode {
+	struct squashfs_base_inode base;
+	__le64 start_block;
+	__le64 file_size;
+	__le64 sparse;
+	__le32 nlink;
+	__le32 fragment;
+	__le32 offset;
+	__le32 xattr;
+} __packed;
+
+/* Followed by the target, not terminated */
+struct squashfs_symlink_inode {
+	struct squashfs_base_inode base;
+	__le32 nlink;
+	__le32 symlink_size;
+} __packed;
+
+/* Followed by size + 1 bytes of the name of the first entry it leads to */
+struct squashfs_dir_index {
+	__le32 index;
+	__le32 start_block;
+	__le32 size;
+} __packed;
+
+/* Followed by count + 1 entries with inodes in the same metadata block */
+struct squashfs_dir_header {
+	__le32 count;
+	__le32 start_block;
+	__le32 inode_number;
+} __packed;
+
+/* Followed by size + 1 bytes of name */
+struct squashfs_dir_entry {
+	__le16 offset;
+	__le16 inode_number;
+	__le16 type;
+	__le16 size;
+} __packed;
+
+struct squashfs_fragment_entry {
+	__le64 start_block;
+	__le32 size;
+	__le32 unused;
+} __packed;
+
+#define SQFS_FRAGS_PER_BLOCK	\
+	(SQFS_METADATA_SIZE / sizeof(struct squashfs_fragment_entry))
+
+#endif /* __SQUASHFS_FS_H__ */
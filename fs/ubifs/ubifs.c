@@ -675,28 +675,13 @@ out:
 
 /* file.c */
 
-static inline void *kmap(struct page *page)
+static int read_data_node(struct ubifs_info *c, struct inode *inode,
+			  void *addr, unsigned int block,
+			  struct ubifs_data_node *dn)
 {
-	return page->addr;
-}
-
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
-{
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -727,114 +712,128 @@ dump:
 	return -EINVAL;
 }
 
-static int do_readpage(struct ubifs_info *c, struct inode *inode,
-		       struct page *page, int last_block_size)
+/**
+ * do_bulk_read - read a range of blocks of a file.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @bu: bulk-read information, with @bu->buf and @bu->buf_len set up
+ * @addr: destination buffer
+ * @first: first block to read
+ * @size: number of bytes to read
+ * @actread: returns the number of bytes read
+ *
+ * Data nodes which follow each other in the same LEB are looked up with a
+ * single index walk and read from the flash in one go, then decompressed
+ * straight into @addr. Holes are zeroed. Only a trailing partial block goes
+ * through a bounce buffer, so that nothing is written beyond @size.
+ *
+ * This function returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+static int do_bulk_read(struct ubifs_info *c, struct inode *inode,
+			struct bu_info *bu, void *addr, unsigned int first,
+			loff_t size, loff_t *actread)
 {
-	void *addr;
-	int err = 0, i;
-	unsigned int block, beyond;
-	struct ubifs_data_node *dn;
-	loff_t i_size = inode->i_size;
-
-	dbg_gen("ino %lu, pg %lu, i_size %lld",
-		inode->i_ino, page->index, i_size);
-
-	addr = kmap(page);
-
-	block = page->index << UBIFS_BLOCKS_PER_PAGE_SHIFT;
-	beyond = (i_size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
-	if (block >= beyond) {
-		/* Reading beyond inode */
-		memset(addr, 0, PAGE_CACHE_SIZE);
-		goto out;
-	}
-
-	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
-	if (!dn)
-		return -ENOMEM;
+	unsigned int end = first + DIV_ROUND_UP(size, UBIFS_BLOCK_SIZE);
+	unsigned int block = first;
+	void *bounce = NULL;
+	int err = 0;
 
-	i = 0;
-	while (1) {
-		int ret;
+	while (block < end) {
+		unsigned int next;
+		void *buf;
+		int i;
 
-		if (block >= beyond) {
-			/* Reading beyond inode */
-			err = -ENOENT;
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		} else {
+		data_key_init(c, &bu->key, inode->i_ino, block);
+		err = ubifs_tnc_get_bu_keys(c, bu);
+		if (err)
+			break;
+		if (!bu->cnt && !bu->eof) {
 			/*
-			 * Reading last block? Make sure to not write beyond
-			 * the requested size in the destination buffer.
+			 * The next data node is too far away to be part of
+			 * this bulk read: zero the start of the hole and look
+			 * again from its end.
 			 */
-			if (((block + 1) == beyond) || last_block_size) {
-				void *buff;
-				int dlen;
+			loff_t pos = (loff_t)(block - first) << UBIFS_BLOCK_SHIFT;
 
-				/*
-				 * We need to buffer the data locally for the
-				 * last block. This is to not pad the
-				 * destination area to a multiple of
-				 * UBIFS_BLOCK_SIZE.
-				 */
-				buff = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
-				if (!buff) {
-					printf("%s: Error, malloc fails!\n",
-					       __func__);
-					err = -ENOMEM;
-					break;
-				}
+			next = min(block + max(bu->blk_cnt, 1), end);
+			dbg_gen("hole");
+			memset(addr + pos, 0,
+			       min((loff_t)(next - block) << UBIFS_BLOCK_SHIFT,
+				   size - pos));
+			block = next;
+			continue;
+		}
+		if (bu->cnt) {
+			err = ubifs_tnc_bulk_read(c, bu);
+			if (err)
+				break;
+		}
 
-				/* Read block-size into temp buffer */
-				ret = read_block(inode, buff, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT) {
-						free(buff);
-						break;
-					}
-				}
+		buf = bu->buf;
+		for (i = 0; i <= bu->cnt && block < end; i++) {
+			loff_t pos = (loff_t)(block - first) << UBIFS_BLOCK_SHIFT;
+			struct ubifs_data_node *dn = buf;
+
+			/* Anything past the last node is a hole, or not read */
+			if (i == bu->cnt) {
+				if (!bu->eof)
+					break;
+				next = end;
+			} else {
+				next = key_block(c, &bu->zbranch[i].key);
+				buf += ALIGN(bu->zbranch[i].len, 8);
+			}
 
-				if (last_block_size)
-					dlen = last_block_size;
-				else
-					dlen = le32_to_cpu(dn->size);
+			/* Zero any hole before this node */
+			if (next > block) {
+				loff_t hole = (loff_t)(min(next, end) - block) <<
+					      UBIFS_BLOCK_SHIFT;
 
-				/* Now copy required size back to dest */
-				memcpy(addr, buff, dlen);
+				dbg_gen("hole");
+				memset(addr + pos, 0, min(hole, size - pos));
+				pos += hole;
+				block = min(next, end);
+				if (block == end)
+					break;
+			}
 
-				free(buff);
+			if (size - pos >= UBIFS_BLOCK_SIZE) {
+				err = read_data_node(c, inode, addr + pos,
+						     block, dn);
 			} else {
-				ret = read_block(inode, addr, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT)
+				/*
+				 * Decompress the last block into a local
+				 * buffer, so as not to pad the destination
+				 * area to a multiple of UBIFS_BLOCK_SIZE.
+				 */
+				if (!bounce) {
+					bounce = malloc_cache_aligned(
+							UBIFS_BLOCK_SIZE);
+					if (!bounce) {
+						err = -ENOMEM;
 						break;
+					}
 				}
+				err = read_data_node(c, inode, bounce, block,
+						     dn);
+				if (!err)
+					memcpy(addr + pos, bounce, size - pos);
 			}
+			if (err)
+				break;
+			block++;
 		}
-		if (++i >= UBIFS_BLOCKS_PER_PAGE)
+		if (err)
 			break;
-		block += 1;
-		addr += UBIFS_BLOCK_SIZE;
-	}
-	if (err) {
-		if (err == -ENOENT) {
-			/* Not found, so it must be a hole */
-			dbg_gen("hole");
-			goto out_free;
-		}
-		ubifs_err(c, "cannot read page %lu of inode %lu, error %d",
-			  page->index, inode->i_ino, err);
-		goto error;
 	}
 
-out_free:
-	kfree(dn);
-out:
-	return 0;
+	free(bounce);
+	*actread = min((loff_t)(block - first) << UBIFS_BLOCK_SHIFT, size);
+	if (err)
+		ubifs_err(c, "cannot read block %u of inode %lu, error %d",
+			  block, inode->i_ino, err);
 
-error:
-	kfree(dn);
 	return err;
 }
 
@@ -844,11 +843,8 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum;
 	struct inode *inode;
-	struct page page;
+	struct bu_info *bu;
 	int err = 0;
-	int i;
-	int count;
-	int last_block_size = 0;
 
 	*actread = 0;
 
@@ -891,33 +887,26 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	if ((size == 0) || (size > (inode->i_size - offset)))
 		size = inode->i_size - offset;
 
-	count = (size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
-
-	page.addr = buf;
-	page.index = offset / PAGE_SIZE;
-	page.inode = inode;
-	for (i = 0; i < count; i++) {
-		/*
-		 * Make sure to not read beyond the requested size
-		 */
-		if (((i + 1) == count) && (size < inode->i_size))
-			last_block_size = size - (i * PAGE_SIZE);
-
-		err = do_readpage(c, inode, &page, last_block_size);
-		if (err)
-			break;
-
-		page.addr += PAGE_SIZE;
-		page.index++;
+	bu = malloc(sizeof(*bu));
+	if (!bu) {
+		err = -ENOMEM;
+		goto put_inode;
+	}
+	bu->buf_len = c->max_bu_buf_len;
+	bu->buf = malloc_cache_aligned(bu->buf_len);
+	if (!bu->buf) {
+		err = -ENOMEM;
+		goto free_bu;
 	}
 
-	if (err) {
+	err = do_bulk_read(c, inode, bu, buf, offset >> UBIFS_BLOCK_SHIFT,
+			   size, actread);
+	if (err)
 		printf("Error reading file '%s'\n", filename);
-		*actread = i * PAGE_SIZE;
-	} else {
-		*actread = size;
-	}
 
+	free(bu->buf);
+free_bu:
+	free(bu);
 put_inode:
 	ubifs_iput(inode);
 
@@ -153,6 +153,16 @@ void blkcache_fill(int iftype, int dev,
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_get_gen() - get the generation of the block devices
+ *
+ * This changes each time blkcache_invalidate() is called, so that data read
+ * from any device can be checked for being up to date.
+ *
+ * @return current generation
+ */
+ulong blkcache_get_gen(void);
+
 /**
  * blkcache_configure() - configure block cache
  *
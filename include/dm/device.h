@@ -123,6 +123,9 @@ enum {
  *		When CONFIG_DEVRES is enabled, devm_kmalloc() and friends will
  *		add to this list. Memory so-allocated will be freed
  *		automatically when the device is removed / unbound
+ * @name_node: Used by uclass to index its devices by name
+ * @seq_node: Used by uclass to index its devices by sequence number
+ * @ofnode_node: Used by uclass to index its devices by device tree node
  */
 struct udevice {
 	const struct driver *driver;
@@ -146,6 +149,11 @@ struct udevice {
 #ifdef CONFIG_DEVRES
 	struct list_head devres_head;
 #endif
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_node name_node;
+	struct hlist_node seq_node;
+	struct hlist_node ofnode_node;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -162,9 +170,24 @@ static inline int dev_of_offset(const struct udevice *dev)
 	return ofnode_to_offset(dev->node);
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * dev_set_ofnode() - Set the device tree node of a device
+ *
+ * @dev: Device to update
+ * @node: New node for the device
+ */
+void dev_set_ofnode(struct udevice *dev, ofnode node);
+#else
+static inline void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	dev->node = node;
+}
+#endif
+
 static inline void dev_set_of_offset(struct udevice *dev, int of_offset)
 {
-	dev->node = offset_to_ofnode(of_offset);
+	dev_set_ofnode(dev, offset_to_ofnode(of_offset));
 }
 
 static inline bool dev_has_of_node(struct udevice *dev)
@@ -39,6 +39,12 @@ struct property {
  * @parent: Pointer to parent node, or NULL if this is the root node
  * @child: Pointer to head of child node list, or NULL if no children
  * @sibling: Pointer to the next sibling node, or NULL if this is the last
+ * @offset: Offset of the node in the flat tree (CONFIG_OF_LIVE_LAZY only)
+ * @populated: true once @properties has been read from the flat tree
+ *	(CONFIG_OF_LIVE_LAZY only). Use of_node_populate() before accessing it.
+ * @children_populated: true once @child has been read from the flat tree
+ *	(CONFIG_OF_LIVE_LAZY only). Use of_node_populate_children() before
+ *	accessing it.
  */
 struct device_node {
 	const char *name;
@@ -50,6 +56,11 @@ struct device_node {
 	struct device_node *parent;
 	struct device_node *child;
 	struct device_node *sibling;
+#ifdef CONFIG_OF_LIVE_LAZY
+	int offset;
+	bool populated;
+	bool children_populated;
+#endif
 };
 
 #define OF_MAX_PHANDLE_ARGS 16
@@ -102,6 +113,57 @@ static inline bool of_live_active(void)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(OF_LIVE_LAZY)
+/**
+ * of_live_populate() - read the properties of a node
+ *
+ * @np: Node to populate, from a tree built by of_live_build()
+ */
+void of_live_populate(struct device_node *np);
+
+/**
+ * of_live_populate_children() - create the subnodes of a node
+ *
+ * The subnodes are created without their properties and subnodes.
+ *
+ * @np: Node to populate, from a tree built by of_live_build()
+ */
+void of_live_populate_children(struct device_node *np);
+
+/**
+ * of_live_find_node_by_phandle() - find a node by its phandle
+ *
+ * This looks up the phandle in the flat tree and then populates only the
+ * nodes on the path to the node, as needed.
+ *
+ * @handle: Phandle to look for
+ * @returns the node, or NULL if none
+ */
+struct device_node *of_live_find_node_by_phandle(phandle handle);
+
+/* Make sure the properties of a node have been read */
+static inline void of_node_populate(const struct device_node *np)
+{
+	if (!np->populated)
+		of_live_populate((struct device_node *)np);
+}
+
+/* Make sure the subnodes of a node have been created */
+static inline void of_node_populate_children(const struct device_node *np)
+{
+	if (!np->children_populated)
+		of_live_populate_children((struct device_node *)np);
+}
+#else
+static inline void of_node_populate(const struct device_node *np)
+{
+}
+
+static inline void of_node_populate_children(const struct device_node *np)
+{
+}
+#endif
+
 #define OF_BAD_ADDR	((u64)-1)
 
 static inline const char *of_node_full_name(const struct device_node *np)
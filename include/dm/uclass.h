@@ -30,12 +30,21 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index: Hash tables of devices by name, sequence number and device tree
+ * node, each of @index_size entries, or NULL if there are none yet
+ * @index_size: Number of entries in each hash table
+ * @dev_count: Number of devices in this uclass
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_head *index;
+	int index_size;
+	int dev_count;
+#endif
 };
 
 struct driver;
@@ -283,6 +283,34 @@ int env_import(const char *buf, int check);
 /* Export from hash table into binary representation */
 int env_export(env_t *env_out);
 
+#ifdef CONFIG_ENV_JOURNAL
+/* Check the CRC of an environment which may have records appended */
+int env_journal_check_crc(const env_t *ep, uint32_t crc);
+
+/* Apply the records appended to an imported environment */
+void env_journal_replay(const env_t *ep);
+
+/* Start an empty journal after an environment exported in full */
+void env_journal_init(env_t *ep);
+
+/* Forget the stored state, so that the next save writes in full */
+void env_journal_reset(void);
+
+/**
+ * env_journal_save() - Append the changes to the stored environment
+ *
+ * This compares the environment with the one last loaded or saved and
+ * appends a record with the differences to the active copy in storage.
+ * Nothing is written if there are no changes.
+ *
+ * @write: function writing @len bytes from @buf at byte @offset of the
+ *	stored env_t; the area written is still erased (all 0xff)
+ * @return 0 if OK, -ENOSPC if the environment must be saved in full,
+ * other -ve on error
+ */
+int env_journal_save(int (*write)(ulong offset, ulong len, const void *buf));
+#endif
+
 #ifdef CONFIG_SYS_REDUNDAND_ENVIRONMENT
 /* Select and import one of two redundant environments */
 int env_import_redund(const char *buf1, int buf1_status,
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Read-only EROFS support
+ */
+
+#ifndef __U_BOOT_EROFS_H__
+#define __U_BOOT_EROFS_H__
+
+struct fs_dir_stream;
+struct fs_dirent;
+
+int erofs_probe(struct blk_desc *, disk_partition_t *);
+int erofs_is_mounted(struct blk_desc *, disk_partition_t *);
+int erofs_exists(const char *);
+int erofs_size(const char *, loff_t *);
+int erofs_read(const char *, void *, loff_t, loff_t, loff_t *);
+int erofs_uuid(char *);
+int erofs_opendir(const char *, struct fs_dir_stream **);
+int erofs_readdir(struct fs_dir_stream *, struct fs_dirent **);
+void erofs_closedir(struct fs_dir_stream *);
+void erofs_close(void);
+
+#endif /* __U_BOOT_EROFS_H__ */
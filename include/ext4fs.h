@@ -31,6 +31,9 @@
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+/* Extents longer than this are uninitialised, of length less this value */
+#define EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
@@ -69,6 +72,45 @@ struct ext4_extent_idx {
 	__u16	ei_unused;
 };
 
+/* Hashes used to index directories */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+/* Superblock flag: the hashes treat names as unsigned chars */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+/* Most levels of index blocks below the root of a hashed directory */
+#define EXT4_HTREE_LEVEL		3
+
+/*
+ * The root of a hashed directory follows the "." and ".." entries in its
+ * first block, and is followed by the index entries.
+ */
+struct ext4_dx_root_info {
+	__le32	reserved_zero;
+	__u8	hash_version;	/* DX_HASH_... */
+	__u8	info_length;	/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+/*
+ * Index entries, sorted by hash. The first one has no hash, as it covers
+ * all those below the second, so its place holds the count and limit.
+ */
+struct ext4_dx_entry {
+	__le32	hash;
+	__le32	block;		/* block in the directory */
+};
+
+struct ext4_dx_countlimit {
+	__le16	limit;		/* room for this many entries */
+	__le16	count;		/* number of entries */
+};
+
 /* Each block (leaves and indexes), even inode-stored has header. */
 struct ext4_extent_header {
 	__le16	eh_magic;	/* probably will support different formats */
@@ -109,6 +151,8 @@ struct ext_filesystem {
 	unsigned char **inode_bmaps;
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
+	/* Groups whose block or inode bitmap has changed since being read */
+	bool *bmap_dirty;
 
 	/* Journal Related */
 
@@ -144,6 +188,7 @@ int ext4fs_exists(const char *filename);
 int ext4fs_size(const char *filename, loff_t *size);
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
+int ext4fs_read_range(u64 pos, u64 len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
@@ -152,4 +197,6 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actread);
 int ext4_read_superblock(char *buffer);
 int ext4fs_uuid(char *uuid_str);
+int ext4fs_is_mounted(struct blk_desc *fs_dev_desc,
+		      disk_partition_t *fs_partition);
 #endif
@@ -200,11 +200,27 @@ struct ext2fs_node {
 	int inode_read;
 };
 
+/* Number of name lookups remembered while a filesystem is mounted */
+#define EXT2_DCACHE_SIZE		16
+
+/* A name found in a directory, see ext4fs_iterate_dir() */
+struct ext2_dcache_entry {
+	int dir_ino;		/* inode of the directory, 0 if unused */
+	int ino;		/* inode found */
+	int type;		/* FILETYPE_... */
+	char name[256];
+};
+
 /* Information about a "mounted" ext2 filesystem. */
 struct ext2_data {
 	struct ext2_sblock sblock;
 	struct ext2_inode *inode;
 	struct ext2fs_node diropen;
+	/* group descriptor table, read when first needed, or NULL */
+	char *gdt;
+	uint32_t gdt_groups;
+	struct ext2_dcache_entry dcache[EXT2_DCACHE_SIZE];
+	int dcache_next;	/* entry to replace next */
 };
 
 extern lbaint_t part_offset;
@@ -24,7 +24,7 @@
 			 sizeof(dir_entry))
 
 #define FATBUFBLOCKS	6
-#define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+#define FATBUFSIZE	(mydata->sect_size * mydata->fatbufblocks)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -114,6 +114,21 @@ typedef struct boot_sector {
 	__u16	reserved2[6];	/* Unused */
 } boot_sector;
 
+/* FAT32 filesystem info sector */
+typedef struct fsinfo_sector {
+	__u32	lead_sig;	/* FSINFO_LEAD_SIG */
+	__u8	reserved1[480];
+	__u32	struct_sig;	/* FSINFO_STRUCT_SIG */
+	__u32	free_count;	/* Number of free clusters, or -1 */
+	__u32	next_free;	/* Where to look for free clusters, or -1 */
+	__u8	reserved2[12];
+	__u32	trail_sig;	/* FSINFO_TRAIL_SIG */
+} fsinfo_sector;
+
+#define FSINFO_LEAD_SIG		0x41615252
+#define FSINFO_STRUCT_SIG	0x61417272
+#define FSINFO_TRAIL_SIG	0xaa550000
+
 typedef struct volume_info
 {
 	__u8 drive_number;	/* BIOS drive number */
@@ -171,6 +186,7 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	__u32	fatbufblocks;	/* Size of fatbuf in sectors */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 } fsdata;
@@ -157,6 +157,106 @@ int fdt_pci_dma_ranges(void *blob, int phb_off, struct pci_controller *hose);
 
 int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name);
 
+/*
+ * Batched fixups
+ *
+ * Each fdt_setprop() which changes the size of a property moves the rest of
+ * the blob. Between fdt_batch_begin() and fdt_batch_commit(), property
+ * changes made with fdt_batch_setprop() and fdt_batch_delprop(), and so by
+ * the fixup functions in this file, are only recorded. The blob is then
+ * written out once, by fdt_batch_commit().
+ *
+ * While a batch is open, the blob still reads as it was before the batch,
+ * node offsets stay valid, and it must not be changed by other means. Adding
+ * a node with fdt_find_or_add_subnode() is allowed; it writes out the
+ * changes so far first. If they do not fit then, they stay recorded and the
+ * blob can be grown before going on.
+ */
+#if CONFIG_IS_ENABLED(FDT_FIXUP_BATCH)
+/**
+ * fdt_batch_begin() - start recording property changes to a blob
+ *
+ * Only one blob can have a batch open at a time.
+ *
+ * @fdt: FDT blob
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_begin(void *fdt);
+
+/**
+ * fdt_batch_commit() - write out the recorded changes and end the batch
+ *
+ * This does nothing if no batch is open for @fdt.
+ *
+ * @fdt: FDT blob
+ * @return 0 if ok, or -FDT_ERR_... on error, e.g. -FDT_ERR_NOSPACE if the
+ *	changes do not fit in the blob's total size. The batch is ended and
+ *	the blob left as it was in that case.
+ */
+int fdt_batch_commit(void *fdt);
+
+/**
+ * fdt_batch_setprop() - set a property, within a batch if one is open
+ *
+ * This is fdt_setprop(), but only records the change if a batch is open
+ * for @fdt.
+ */
+int fdt_batch_setprop(void *fdt, int nodeoffset, const char *name,
+		      const void *val, int len);
+
+/**
+ * fdt_batch_delprop() - delete a property, within a batch if one is open
+ *
+ * This is fdt_delprop(), but only records the change if a batch is open
+ * for @fdt.
+ */
+int fdt_batch_delprop(void *fdt, int nodeoffset, const char *name);
+#else
+static inline int fdt_batch_begin(void *fdt)
+{
+	return 0;
+}
+
+static inline int fdt_batch_commit(void *fdt)
+{
+	return 0;
+}
+
+static inline int fdt_batch_setprop(void *fdt, int nodeoffset,
+				    const char *name, const void *val, int len)
+{
+	return fdt_setprop(fdt, nodeoffset, name, val, len);
+}
+
+static inline int fdt_batch_delprop(void *fdt, int nodeoffset,
+				    const char *name)
+{
+	return fdt_delprop(fdt, nodeoffset, name);
+}
+#endif
+
+static inline int fdt_batch_setprop_u32(void *fdt, int nodeoffset,
+					const char *name, u32 val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_batch_setprop(fdt, nodeoffset, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_u64(void *fdt, int nodeoffset,
+					const char *name, u64 val)
+{
+	fdt64_t tmp = cpu_to_fdt64(val);
+
+	return fdt_batch_setprop(fdt, nodeoffset, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_string(void *fdt, int nodeoffset,
+					   const char *name, const char *str)
+{
+	return fdt_batch_setprop(fdt, nodeoffset, name, str, strlen(str) + 1);
+}
+
 /**
  * Add board-specific data to the FDT before booting the OS.
  *
@@ -288,6 +388,25 @@ int fdt_setup_simplefb_node(void *fdt, int node, u64 base_address, u32 width,
 
 int fdt_overlay_apply_verbose(void *fdt, void *fdto);
 
+/**
+ * fdt_overlay_apply_list() - Apply several overlays to a device tree
+ *
+ * This gives the same result as calling fdt_overlay_apply() for each
+ * overlay in turn, but looks up the labels in /__symbols__ of the base
+ * tree once rather than for each reference. The overlays are copied before
+ * they are applied, so they are left as they were.
+ *
+ * @fdt: Device tree to apply the overlays to, with room for all of them
+ * @fdto: Overlays to apply, in order
+ * @count: Number of overlays in @fdto
+ * @times: If not NULL, set to the time taken to apply each overlay in
+ *	microseconds
+ * @return 0 if OK, -FDT_ERR_... on error, in which case @fdt has been
+ * damaged
+ */
+int fdt_overlay_apply_list(void *fdt, void * const fdto[], int count,
+			   ulong *times);
+
 /**
  * fdt_get_cells_len() - Get the length of a type of cell in top-level nodes
  *
@@ -654,6 +654,19 @@ int fdtdec_get_chosen_node(const void *blob, const char *name);
  */
 const char *fdtdec_get_compatible(enum fdt_compat_id id);
 
+/**
+ * fdtdec_node_offset_by_phandle() - find the node with a given phandle
+ *
+ * This is the same as fdt_node_offset_by_phandle(), but with
+ * CONFIG_FDTDEC_INDEX it uses an index of the control FDT instead of
+ * searching the whole blob each time.
+ *
+ * @blob: FDT blob
+ * @phandle: Phandle to look for
+ * @return node offset if found, -ve FDT_ERR_... on error
+ */
+int fdtdec_node_offset_by_phandle(const void *blob, u32 phandle);
+
 /* Look up a phandle and follow it to its node. Then return the offset
  * of that node.
  *
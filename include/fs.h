@@ -13,6 +13,8 @@
 #define FS_TYPE_SANDBOX	3
 #define FS_TYPE_UBIFS	4
 #define FS_TYPE_BTRFS	5
+#define FS_TYPE_SQUASHFS 6
+#define FS_TYPE_EROFS	7
 
 /*
  * Tell the fs layer which block device an partition to use for future
@@ -13,4 +13,65 @@
 int fs_devread(struct blk_desc *, disk_partition_t *, lbaint_t, int, int,
 	       char *);
 
+/**
+ * fs_read_range() - Read a byte range of a partition
+ *
+ * Whole sectors are read straight into @buf, so a filesystem can pass each
+ * run of contiguous file data in one call, whatever its length.
+ *
+ * @blk: Block device holding the partition
+ * @partition: Partition to read from
+ * @pos: Byte position of the data in the partition
+ * @len: Number of bytes to read
+ * @buf: Buffer to read into, need not be aligned
+ * @return 0 if OK, -EINVAL if the range is outside the partition, -EIO on a
+ * read error
+ */
+int fs_read_range(struct blk_desc *blk, disk_partition_t *partition, u64 pos,
+		  u64 len, void *buf);
+
+/* Most symlinks followed in one lookup */
+#define FS_MAX_SYMLINKS		8
+
+/* Longest symlink target followed */
+#define FS_MAX_TARGET		4096
+
+/**
+ * struct fs_walk_ops - Filesystem operations used to look up a path
+ *
+ * Each is passed the filesystem's own state for the lookup, usually its
+ * in-memory inode, as @inode.
+ *
+ * @root: Read the root directory into @inode
+ * @lookup: Find the entry @name, of @len bytes, in the directory @inode
+ *	and read it into @inode. Returns 0 if OK, -ve on error
+ * @is_link: Check whether @inode is a symlink, setting @sizep to the
+ *	length of its target if so
+ * @read_link: Read the target of the symlink @inode, @size bytes, into @buf.
+ *	Returns 0 if OK, -ve on error
+ */
+struct fs_walk_ops {
+	int (*root)(void *inode);
+	int (*lookup)(void *inode, const char *name, int len);
+	bool (*is_link)(const void *inode, u64 *sizep);
+	int (*read_link)(void *inode, char *buf, u64 size);
+};
+
+/**
+ * fs_walk_path() - Look up a path, following symlinks
+ *
+ * The path is looked up from the root directory, one component at a time.
+ * When a symlink is met, its target is put in its place in the path and
+ * the result looked up again from the root, so a relative target is found
+ * in the directory holding the link.
+ *
+ * @path: Path to look up, absolute or relative to the root
+ * @inode: Filesystem state for the lookup, left holding what was found
+ * @ops: Filesystem operations
+ * @return 0 if OK, -ELOOP if too many symlinks are followed, -ENAMETOOLONG
+ * if a symlink target is too long, -ENOMEM if out of memory, or an error
+ * from @ops
+ */
+int fs_walk_path(const char *path, void *inode, const struct fs_walk_ops *ops);
+
 #endif /* __U_BOOT_FS_INTERNAL_H__ */
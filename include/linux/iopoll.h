@@ -9,6 +9,7 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <time.h>
+#include <uthread.h>
 
 /**
  * readx_poll_timeout - Periodically poll an address until a condition is met or a timeout occurs
@@ -35,6 +36,7 @@
 			(val) = op(addr); \
 			break; \
 		} \
+		uthread_schedule(); \
 	} \
 	(cond) ? 0 : -ETIMEDOUT; \
 })
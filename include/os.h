@@ -351,4 +351,33 @@ int os_setjmp(ulong *jmp, int size);
  */
 void os_longjmp(ulong *jmp, int ret);
 
+/**
+ * os_context_create() - Create a host execution context
+ *
+ * This sets up a context which runs @func on the given stack when switched
+ * to. With no stack, the context is only used to save the current state, in
+ * os_context_switch().
+ *
+ * @stack: Stack to use, or NULL
+ * @size: Size of stack in bytes
+ * @func: Function to run, which must not return
+ * @return context, or NULL if out of memory
+ */
+void *os_context_create(void *stack, size_t size, void (*func)(void));
+
+/**
+ * os_context_switch() - Save the current context and switch to another
+ *
+ * @from: Context to save the current state in
+ * @to: Context to switch to
+ */
+void os_context_switch(void *from, void *to);
+
+/**
+ * os_context_free() - Free a context created by os_context_create()
+ *
+ * @ctx: Context to free, which must not be running
+ */
+void os_context_free(void *ctx);
+
 #endif
@@ -52,6 +52,13 @@ struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int deleted;	/* slots freed by hdelete, still probed */
+	unsigned int *sorted;	/* table indices of the entries, by key */
+/* Statistics, reported by "env info" */
+	unsigned long lookups;
+	unsigned long probes;
+	unsigned long inserts;
+	unsigned int resizes;
 /*
  * Callback function which will check whether the given change for variable
  * "__item" to "newval" may be applied or not, and possibly apply such change.
@@ -63,7 +70,11 @@ struct hsearch_data {
 		int flag);
 };
 
-/* Create a new hash table which will contain at most "__nel" elements.  */
+/*
+ * Create a new hash table with room for "__nel" elements. The table grows
+ * as needed when more are entered, which moves the entries: ENTRY pointers
+ * handed out by the functions below are only valid until the next ENTER.
+ */
 extern int hcreate_r(size_t __nel, struct hsearch_data *__htab);
 
 /* Destroy current internal hash table.  */
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Read-only SquashFS support
+ */
+
+#ifndef __U_BOOT_SQUASHFS_H__
+#define __U_BOOT_SQUASHFS_H__
+
+struct fs_dir_stream;
+struct fs_dirent;
+
+int sqfs_probe(struct blk_desc *, disk_partition_t *);
+int sqfs_is_mounted(struct blk_desc *, disk_partition_t *);
+int sqfs_exists(const char *);
+int sqfs_size(const char *, loff_t *);
+int sqfs_read(const char *, void *, loff_t, loff_t, loff_t *);
+int sqfs_opendir(const char *, struct fs_dir_stream **);
+int sqfs_readdir(struct fs_dir_stream *, struct fs_dirent **);
+void sqfs_closedir(struct fs_dir_stream *);
+void sqfs_close(void);
+
+#endif /* __U_BOOT_SQUASHFS_H__ */
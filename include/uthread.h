@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Cooperative threads
+ *
+ * Threads only switch when one of them calls uthread_schedule(), which is
+ * done while waiting, e.g. in udelay() and while the console is idle. The
+ * thread which started the others (normally the main U-Boot loop) runs one
+ * of them each time it yields, and each thread which yields goes back to it.
+ */
+
+#ifndef __UTHREAD_H
+#define __UTHREAD_H
+
+#include <linux/list.h>
+
+/**
+ * struct uthread - a cooperative thread
+ *
+ * @fn: Function run by the thread
+ * @arg: Argument passed to @fn
+ * @ctx: Saved context, managed by the architecture
+ * @stack: Stack for the thread
+ * @grp_id: Group the thread belongs to, see uthread_grp_new_id()
+ * @done: true once @fn has returned
+ * @list: Link in the list of threads which have not finished
+ */
+struct uthread {
+	void (*fn)(void *arg);
+	void *arg;
+	void *ctx;
+	void *stack;
+	uint grp_id;
+	bool done;
+	struct list_head list;
+};
+
+#if CONFIG_IS_ENABLED(UTHREAD)
+/**
+ * uthread_create() - Create a thread, which runs when others yield
+ *
+ * @uthr: Thread to set up, which must remain valid until the thread is done
+ * @fn: Function for the thread to run
+ * @arg: Argument to pass to @fn
+ * @stack_sz: Stack size in bytes, or 0 for CONFIG_UTHREAD_STACK_SIZE
+ * @grp_id: Group to add the thread to, or 0 for none
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
+		   size_t stack_sz, uint grp_id);
+
+/**
+ * uthread_schedule() - Let another thread run
+ *
+ * In a thread this goes back to the main thread. In the main thread this
+ * runs the next thread which has not finished, until it yields.
+ *
+ * @return true if another thread ran, false if there are none
+ */
+bool uthread_schedule(void);
+
+/**
+ * uthread_delay() - Let other threads run while waiting
+ *
+ * This is called by udelay(). If there are no other threads, it waits for
+ * @usec microseconds. Otherwise it lets another thread run and returns the
+ * time that took, which may be 0.
+ *
+ * @usec: Time to wait in microseconds
+ * @return time waited in microseconds, at most @usec
+ */
+ulong uthread_delay(ulong usec);
+
+/**
+ * uthread_grp_new_id() - Allocate a new group ID for threads
+ *
+ * @return new ID, never 0
+ */
+uint uthread_grp_new_id(void);
+
+/**
+ * uthread_grp_done() - Check whether all threads in a group have finished
+ *
+ * @grp_id: Group to check
+ * @return true if no thread in the group is still running
+ */
+bool uthread_grp_done(uint grp_id);
+
+/* Provided by the architecture */
+
+/**
+ * arch_uthread_init() - Set up the context of a thread
+ *
+ * @uthr: Thread to set up, with @stack allocated, or NULL for the stack of
+ *	the caller, whose context is then only saved by arch_uthread_switch()
+ * @stack_sz: Size of the stack in bytes
+ * @entry: Function to run on the stack, which never returns
+ * @return 0 if OK, -ve on error
+ */
+int arch_uthread_init(struct uthread *uthr, size_t stack_sz,
+		      void (*entry)(void));
+
+/**
+ * arch_uthread_switch() - Switch from one thread to another
+ *
+ * @from: Thread to save the current context in
+ * @to: Thread to switch to
+ */
+void arch_uthread_switch(struct uthread *from, struct uthread *to);
+
+/**
+ * arch_uthread_free() - Free the context of a thread which is not running
+ *
+ * @uthr: Thread to free
+ */
+void arch_uthread_free(struct uthread *uthr);
+#else
+static inline bool uthread_schedule(void)
+{
+	return false;
+}
+
+static inline ulong uthread_delay(ulong usec)
+{
+	__udelay(usec);
+
+	return usec;
+}
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <fdt_support.h>
 #include <linux/libfdt.h>
+#include <malloc.h>
 #include <serial.h>
 #include <asm/sections.h>
 #include <linux/ctype.h>
@@ -516,6 +517,185 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
 	return num_found;
 }
 
+#if CONFIG_IS_ENABLED(FDTDEC_INDEX)
+/* A phandle and the offset of its node */
+struct fdtdec_phandle_ent {
+	u32 phandle;
+	int offset;
+};
+
+/* An alias and the offset of the node it points to */
+struct fdtdec_alias_ent {
+	const char *name;
+	int offset;
+};
+
+/**
+ * struct fdtdec_index - index of the phandles and aliases in the control FDT
+ *
+ * A write to the blob which adds or removes anything changes the size of
+ * its structure or strings block, so these are used to notice that the
+ * index is out of date. Phandle lookups also check the node they find.
+ *
+ * @blob: Blob which is indexed, or NULL if none
+ * @size_struct: Size of the structure block when the index was built
+ * @size_strings: Size of the strings block when the index was built
+ * @phandles: Phandles in the blob, sorted by phandle
+ * @phandle_count: Number of entries in @phandles
+ * @aliases: Aliases in the blob which point to a node, in blob order
+ * @alias_count: Number of entries in @aliases
+ */
+struct fdtdec_index {
+	const void *blob;
+	u32 size_struct;
+	u32 size_strings;
+	struct fdtdec_phandle_ent *phandles;
+	int phandle_count;
+	struct fdtdec_alias_ent *aliases;
+	int alias_count;
+};
+
+static struct fdtdec_index fdtdec_index;
+
+static void fdtdec_index_free(struct fdtdec_index *idx)
+{
+	free(idx->phandles);
+	free(idx->aliases);
+	memset(idx, '\0', sizeof(*idx));
+}
+
+static int fdtdec_phandle_cmp(const void *a, const void *b)
+{
+	const struct fdtdec_phandle_ent *pa = a, *pb = b;
+
+	return pa->phandle < pb->phandle ? -1 : pa->phandle > pb->phandle;
+}
+
+static int fdtdec_index_build(struct fdtdec_index *idx, const void *blob)
+{
+	struct fdtdec_phandle_ent *ent;
+	int node, prop, aliases, size = 0;
+	u32 phandle;
+
+	for (node = fdt_next_node(blob, -1, NULL); node >= 0;
+	     node = fdt_next_node(blob, node, NULL)) {
+		phandle = fdt_get_phandle(blob, node);
+		if (!phandle)
+			continue;
+		if (idx->phandle_count == size) {
+			size = size ? size * 2 : 64;
+			ent = realloc(idx->phandles, size * sizeof(*ent));
+			if (!ent)
+				return -ENOMEM;
+			idx->phandles = ent;
+		}
+		ent = &idx->phandles[idx->phandle_count++];
+		ent->phandle = phandle;
+		ent->offset = node;
+	}
+	qsort(idx->phandles, idx->phandle_count, sizeof(*idx->phandles),
+	      fdtdec_phandle_cmp);
+
+	aliases = fdt_path_offset(blob, "/aliases");
+	size = 0;
+	fdt_for_each_property_offset(prop, blob, aliases)
+		size++;
+	if (size) {
+		idx->aliases = malloc(size * sizeof(*idx->aliases));
+		if (!idx->aliases)
+			return -ENOMEM;
+	}
+	fdt_for_each_property_offset(prop, blob, aliases) {
+		struct fdtdec_alias_ent *ae;
+		const char *name, *path;
+		int len;
+
+		path = fdt_getprop_by_offset(blob, prop, &name, &len);
+		if (!path || len < 2 || *path != '/' || path[len - 1])
+			continue;
+		node = fdt_path_offset(blob, path);
+		if (node < 0)
+			continue;
+		ae = &idx->aliases[idx->alias_count++];
+		ae->name = name;
+		ae->offset = node;
+	}
+	debug("%s: %d phandles, %d aliases\n", __func__, idx->phandle_count,
+	      idx->alias_count);
+
+	return 0;
+}
+
+/**
+ * fdtdec_get_index() - get the index of a blob, building it if needed
+ *
+ * Only the control FDT is indexed, once relocated, since other blobs are
+ * usually being written to and memory is short before relocation.
+ *
+ * @blob: Blob to look up
+ * @return the index, or NULL if none
+ */
+static struct fdtdec_index *fdtdec_get_index(const void *blob)
+{
+	struct fdtdec_index *idx = &fdtdec_index;
+
+	if (!blob || blob != gd->fdt_blob || !(gd->flags & GD_FLG_RELOC))
+		return NULL;
+	if (idx->blob == blob &&
+	    idx->size_struct == fdt_size_dt_struct(blob) &&
+	    idx->size_strings == fdt_size_dt_strings(blob))
+		return idx;
+
+	fdtdec_index_free(idx);
+	if (fdtdec_index_build(idx, blob)) {
+		fdtdec_index_free(idx);
+		return NULL;
+	}
+	idx->blob = blob;
+	idx->size_struct = fdt_size_dt_struct(blob);
+	idx->size_strings = fdt_size_dt_strings(blob);
+
+	return idx;
+}
+
+int fdtdec_node_offset_by_phandle(const void *blob, u32 phandle)
+{
+	struct fdtdec_phandle_ent *ent;
+	struct fdtdec_index *idx;
+	int lo, hi, mid;
+
+	if (!phandle || phandle == (u32)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	idx = fdtdec_get_index(blob);
+	if (!idx)
+		return fdt_node_offset_by_phandle(blob, phandle);
+
+	for (lo = 0, hi = idx->phandle_count; lo < hi;) {
+		mid = (lo + hi) / 2;
+		if (idx->phandles[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == idx->phandle_count || idx->phandles[lo].phandle != phandle)
+		return -FDT_ERR_NOTFOUND;
+	ent = &idx->phandles[lo];
+	if (fdt_get_phandle(blob, ent->offset) == phandle)
+		return ent->offset;
+
+	/* The blob was changed in place, so start again */
+	fdtdec_index_free(idx);
+
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+#else
+int fdtdec_node_offset_by_phandle(const void *blob, u32 phandle)
+{
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+#endif /* FDTDEC_INDEX */
+
 int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 			 int *seqp)
 {
@@ -524,6 +704,28 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 	int find_namelen;
 	int prop_offset;
 	int aliases;
+#if CONFIG_IS_ENABLED(FDTDEC_INDEX)
+	struct fdtdec_index *idx = fdtdec_get_index(blob);
+
+	if (idx) {
+		struct fdtdec_alias_ent *ae;
+		int val;
+
+		for (ae = idx->aliases; ae < idx->aliases + idx->alias_count;
+		     ae++) {
+			if (ae->offset != offset ||
+			    strncmp(ae->name, base, base_len))
+				continue;
+			val = trailing_strtol(ae->name);
+			if (val != -1) {
+				*seqp = val;
+				return 0;
+			}
+		}
+
+		return -ENOENT;
+	}
+#endif
 
 	find_name = fdt_get_name(blob, offset, &find_namelen);
 	debug("Looking for '%s' at %d, name %s\n", base, offset, find_name);
@@ -626,7 +828,7 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdtdec_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -757,8 +959,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdtdec_node_offset_by_phandle(blob,
+								     phandle);
 				if (!node) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
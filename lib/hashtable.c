@@ -108,6 +108,10 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	if (htab->table != NULL)
 		return 0;
 
+	/* The second hash function needs at least three slots */
+	if (nel < 3)
+		nel = 3;
+
 	/* Change nel to the first prime number not smaller as nel. */
 	nel |= 1;		/* make odd */
 	while (!isprime(nel))
@@ -115,12 +119,20 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->deleted = 0;
 
 	/* allocate memory and zero out */
 	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
 	if (htab->table == NULL)
 		return 0;
 
+	htab->sorted = malloc(htab->size * sizeof(*htab->sorted));
+	if (htab->sorted == NULL) {
+		free(htab->table);
+		htab->table = NULL;
+		return 0;
+	}
+
 	/* everything went alright */
 	return 1;
 }
@@ -155,9 +167,142 @@ void hdestroy_r(struct hsearch_data *htab)
 		}
 	}
 	free(htab->table);
+	free(htab->sorted);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->sorted = NULL;
+}
+
+/*
+ * Compute the first hash of a key: an index between 1 and size - 1.
+ * Perhaps use a better method.
+ */
+static unsigned int _hash(const char *key, unsigned int size)
+{
+	unsigned int count = strlen(key);
+	unsigned int hval = count;
+
+	while (count-- > 0) {
+		hval <<= 4;
+		hval += key[count];
+	}
+
+	/* simply take the modul but prevent zero */
+	hval %= size;
+	if (hval == 0)
+		++hval;
+
+	return hval;
+}
+
+/* Find the first empty slot for a hash value, in a table without deletions */
+static unsigned int _hfree_slot(_ENTRY *table, unsigned int size,
+				unsigned int hval)
+{
+	unsigned int hval2 = 1 + hval % (size - 2);
+	unsigned int idx = hval;
+
+	while (table[idx].used) {
+		if (idx <= hval2)
+			idx = size + idx - hval2;
+		else
+			idx -= hval2;
+	}
+
+	return idx;
+}
+
+/*
+ * Find the position of a key in the sorted index, or the position where it
+ * would have to be inserted if it is not there.
+ */
+static unsigned int _hsorted_pos(struct hsearch_data *htab, const char *key,
+				 int *found)
+{
+	unsigned int lo = 0, hi = htab->filled;
+
+	*found = 0;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(key, htab->table[htab->sorted[mid]].entry.key);
+
+		if (cmp == 0) {
+			*found = 1;
+			return mid;
+		}
+		if (cmp > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Rehash all entries into a new table of at least nel slots; this also gets
+ * rid of the slots of deleted entries. Entries are moved in key order so
+ * that the sorted index only needs its slot numbers replaced.
+ */
+static int _hresize(struct hsearch_data *htab, unsigned int nel)
+{
+	unsigned int *sorted;
+	_ENTRY *table;
+	unsigned int i;
+
+	nel |= 1;
+	while (!isprime(nel))
+		nel += 2;
+
+	table = calloc(nel + 1, sizeof(_ENTRY));
+	sorted = malloc(nel * sizeof(*sorted));
+	if (table == NULL || sorted == NULL) {
+		free(table);
+		free(sorted);
+		return 0;
+	}
+
+	debug("hresize: %u -> %u slots, %u entries, %u deleted\n",
+	      htab->size, nel, htab->filled, htab->deleted);
+
+	for (i = 0; i < htab->filled; ++i) {
+		_ENTRY *old = &htab->table[htab->sorted[i]];
+		unsigned int hval = _hash(old->entry.key, nel);
+		unsigned int idx = _hfree_slot(table, nel, hval);
+
+		table[idx].used = hval;
+		table[idx].entry = old->entry;
+		sorted[i] = idx;
+	}
+
+	free(htab->table);
+	free(htab->sorted);
+	htab->table = table;
+	htab->sorted = sorted;
+	htab->size = nel;
+	htab->deleted = 0;
+	++htab->resizes;
+
+	return 1;
+}
+
+/*
+ * A callback may have entered other variables and so resized the table;
+ * in that case look up the slot of the given key again.
+ */
+static unsigned int _hrefind(struct hsearch_data *htab, unsigned int resizes,
+			     const char *key, unsigned int idx)
+{
+	unsigned int pos;
+	int found;
+
+	if (htab->resizes == resizes)
+		return idx;
+
+	pos = _hsorted_pos(htab, key, &found);
+
+	return found ? htab->sorted[pos] : 0;
 }
 
 /*
@@ -241,14 +386,24 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 			}
 
 			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
+			if (htab->table[idx].entry.callback) {
+				unsigned int resizes = htab->resizes;
+
+				if (htab->table[idx].entry.callback(item.key,
+				    item.data, env_op_overwrite, flag)) {
+					debug("callback() rejected setting variable %s, skipping it!\n",
+					      item.key);
+					__set_errno(EINVAL);
+					*retval = NULL;
+					return 0;
+				}
+
+				idx = _hrefind(htab, resizes, item.key, idx);
+				if (!idx) {
+					__set_errno(ESRCH);
+					*retval = NULL;
+					return 0;
+				}
 			}
 
 			free(htab->table[idx].entry.data);
@@ -271,27 +426,15 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	      struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
+	unsigned int resizes;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
+	++htab->lookups;
 
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	/* First hash function */
+	hval = _hash(item.key, htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -335,6 +478,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 			if (idx == hval)
 				break;
 
+			++htab->probes;
+
+			if (htab->table[idx].used == -1
+			    && !first_deleted)
+				first_deleted = idx;
+
 			/* If entry is found use it. */
 			ret = _compare_and_overwrite_entry(item, action, retval,
 				htab, flag, hval, idx);
@@ -346,6 +495,29 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 
 	/* An empty bucket has been found. */
 	if (action == ENTER) {
+		unsigned int pos;
+		int found;
+
+		/*
+		 * Keep the table at most three quarters full, counting the
+		 * slots of deleted entries as they lengthen the probes just
+		 * the same. Double the size if the live entries alone take
+		 * more than half of it, otherwise only drop deleted slots.
+		 * If that fails we carry on until the table is really full.
+		 */
+		if ((htab->filled + htab->deleted + 1) * 4 > htab->size * 3) {
+			unsigned int nel = htab->size;
+
+			if ((htab->filled + 1) * 2 > htab->size)
+				nel = 2 * htab->size;
+			if (_hresize(htab, nel)) {
+				hval = _hash(item.key, htab->size);
+				idx = _hfree_slot(htab->table, htab->size,
+						  hval);
+				first_deleted = 0;
+			}
+		}
+
 		/*
 		 * If table is full and another entry should be
 		 * entered return with error.
@@ -363,17 +535,29 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		if (first_deleted)
 			idx = first_deleted;
 
-		htab->table[idx].used = hval;
 		htab->table[idx].entry.key = strdup(item.key);
 		htab->table[idx].entry.data = strdup(item.data);
 		if (!htab->table[idx].entry.key ||
 		    !htab->table[idx].entry.data) {
+			free((void *)htab->table[idx].entry.key);
+			free(htab->table[idx].entry.data);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
 
+		if (htab->table[idx].used == -1)
+			--htab->deleted;
+		htab->table[idx].used = hval;
+
+		/* Add it to the sorted index */
+		pos = _hsorted_pos(htab, item.key, &found);
+		memmove(&htab->sorted[pos + 1], &htab->sorted[pos],
+			(htab->filled - pos) * sizeof(*htab->sorted));
+		htab->sorted[pos] = idx;
+
 		++htab->filled;
+		++htab->inserts;
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -392,17 +576,28 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		}
 
 		/* If there is a callback, call it */
+		resizes = htab->resizes;
 		if (htab->table[idx].entry.callback &&
 		    htab->table[idx].entry.callback(item.key, item.data,
 		    env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			idx = _hrefind(htab, resizes, item.key, idx);
+			if (idx)
+				_hdelete(item.key, htab,
+					 &htab->table[idx].entry, idx);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
+		idx = _hrefind(htab, resizes, item.key, idx);
+		if (!idx) {
+			__set_errno(ESRCH);
+			*retval = NULL;
+			return 0;
+		}
+
 		/* return new entry */
 		*retval = &htab->table[idx].entry;
 		return 1;
@@ -427,6 +622,15 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx)
 {
+	unsigned int pos;
+	int found;
+
+	/* drop it from the sorted index */
+	pos = _hsorted_pos(htab, ep->key, &found);
+	if (found)
+		memmove(&htab->sorted[pos], &htab->sorted[pos + 1],
+			(htab->filled - pos - 1) * sizeof(*htab->sorted));
+
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
 	free((void *)ep->key);
@@ -436,6 +640,7 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	htab->table[idx].used = -1;
 
 	--htab->filled;
+	++htab->deleted;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -471,7 +676,13 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 		return 0;
 	}
 
-	_hdelete(key, htab, ep, idx);
+	/*
+	 * The callback may have changed the table, and even deleted or moved
+	 * this entry: look it up again
+	 */
+	idx = hsearch_r(e, FIND, &ep, htab, 0);
+	if (idx)
+		_hdelete(key, htab, ep, idx);
 
 	return 1;
 }
@@ -519,14 +730,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	ENTRY *e1 = *(ENTRY **) p1;
-	ENTRY *e2 = *(ENTRY **) p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -586,14 +789,29 @@ static int match_entry(ENTRY *ep, int flag,
 	return 0;
 }
 
+/* Return the entry at position i of the sorted index, if it is exported */
+static ENTRY *export_entry(struct hsearch_data *htab, unsigned int i, int flag,
+			   int argc, char * const argv[])
+{
+	ENTRY *ep = &htab->table[htab->sorted[i]].entry;
+
+	if ((argc > 0) && !match_entry(ep, flag, argc, argv))
+		return NULL;
+
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return NULL;
+
+	return ep;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
+	ENTRY *ep;
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	unsigned int i;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -605,54 +823,31 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	      htab, htab->size, htab->filled, (ulong)size);
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * walk the entries in key order and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
-
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
-
-			list[n++] = ep;
+	for (i = 0, totlen = 0; i < htab->filled; ++i) {
+		ep = export_entry(htab, i, flag, argc, argv);
+		if (!ep)
+			continue;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -680,17 +875,21 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	}
 	/*
 	 * Pass 2:
-	 * export sorted list of result data
+	 * export the same entries, again in key order
 	 */
-	for (i = 0, p = res; i < n; ++i) {
+	for (i = 0, p = res; i < htab->filled; ++i) {
 		const char *s;
 
-		s = list[i]->key;
+		ep = export_entry(htab, i, flag, argc, argv);
+		if (!ep)
+			continue;
+
+		s = ep->key;
 		while (*s)
 			*p++ = *s++;
 		*p++ = '=';
 
-		s = list[i]->data;
+		s = ep->data;
 
 		while (*s) {
 			if ((*s == sep) || (*s == '\\'))
@@ -827,7 +1026,8 @@ int himport_r(struct hsearch_data *htab,
 	 * environment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. This is
+	 * only the initial size: the table grows when it fills up.
 	 */
 
 	if (!htab->table) {
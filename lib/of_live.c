@@ -15,6 +15,9 @@
 #include <dm/of_access.h>
 #include <linux/err.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
+#if !CONFIG_IS_ENABLED(OF_LIVE_LAZY)
 static void *unflatten_dt_alloc(void **mem, unsigned long size,
 				unsigned long align)
 {
@@ -313,6 +316,194 @@ static int unflatten_device_tree(const void *blob,
 
 	return 0;
 }
+#else
+/* The flat tree which the live tree is built from */
+static const void *of_live_blob;
+
+/**
+ * of_live_new_node() - create a node from the flat tree, but not its contents
+ *
+ * This sets up everything but the properties and the subnodes, which are
+ * left for of_live_populate() and of_live_populate_children(). The full path
+ * and the name are allocated along with the node.
+ *
+ * @dad: Parent node, or NULL for the root node
+ * @offset: Offset of the node in the flat tree
+ * @return the new node, or NULL if out of memory
+ */
+static struct device_node *of_live_new_node(struct device_node *dad,
+					    int offset)
+{
+	const void *blob = of_live_blob;
+	const char *pathp, *name = NULL, *type = "<NULL>", *at;
+	struct device_node *np;
+	phandle handle = 0;
+	int l, poff, plen, nlen;
+	char *fn;
+
+	pathp = fdt_get_name(blob, offset, &l);
+	if (!pathp)
+		return NULL;
+
+	/* Pick out the properties needed now in one pass, as in unflattening */
+	fdt_for_each_property_offset(poff, blob, offset) {
+		const char *pname;
+		const fdt32_t *p;
+		int sz;
+
+		p = fdt_getprop_by_offset(blob, poff, &pname, &sz);
+		if (!p)
+			break;
+		if (!strcmp(pname, "name"))
+			name = (const char *)p;
+		else if (!strcmp(pname, "device_type"))
+			type = (const char *)p;
+		else if (!handle && sz == sizeof(*p) &&
+			 (!strcmp(pname, "phandle") ||
+			  !strcmp(pname, "linux,phandle")))
+			handle = fdt32_to_cpu(*p);
+	}
+
+	/* The root node is "/" and its children have no parent prefix */
+	plen = dad && dad->parent ? strlen(dad->full_name) : 0;
+	at = strrchr(pathp, '@');
+	nlen = name ? 0 : (at ? at - pathp : l) + 1;
+
+	np = calloc(1, sizeof(*np) + plen + l + 2 + nlen);
+	if (!np)
+		return NULL;
+
+	fn = (char *)(np + 1);
+	np->full_name = fn;
+	memcpy(fn, dad ? dad->full_name : "", plen);
+	fn[plen] = '/';
+	memcpy(fn + plen + 1, pathp, l + 1);
+
+	/* Without a "name" property, use the unit name without address */
+	if (!name) {
+		fn += plen + l + 2;
+		memcpy(fn, pathp, nlen - 1);
+		fn[nlen - 1] = '\0';
+		name = fn;
+	}
+	np->name = name;
+	np->type = type;
+	np->phandle = handle;
+	np->parent = dad;
+	np->offset = offset;
+
+	return np;
+}
+
+void of_live_populate(struct device_node *np)
+{
+	const void *blob = of_live_blob;
+	struct property *pp, **prev_pp = &np->properties;
+	int offset, count = 0;
+	bool has_name = false;
+
+	np->populated = true;
+
+	/* One spare for the "name" property, as unflatten_dt_node() adds */
+	fdt_for_each_property_offset(offset, blob, np->offset)
+		count++;
+	pp = calloc(count + 1, sizeof(*pp));
+	if (!pp) {
+		debug("%s: out of memory\n", __func__);
+		return;
+	}
+
+	fdt_for_each_property_offset(offset, blob, np->offset) {
+		const char *pname;
+		const void *p;
+		int sz;
+
+		p = fdt_getprop_by_offset(blob, offset, &pname, &sz);
+		if (!p)
+			break;
+		if (!strcmp(pname, "name"))
+			has_name = true;
+		pp->name = (char *)pname;
+		pp->length = sz;
+		pp->value = (void *)p;
+		*prev_pp = pp;
+		prev_pp = &pp++->next;
+	}
+	if (!has_name) {
+		pp->name = "name";
+		pp->length = strlen(np->name) + 1;
+		pp->value = (void *)np->name;
+		*prev_pp = pp;
+	}
+}
+
+void of_live_populate_children(struct device_node *np)
+{
+	struct device_node *child, **prev_np = &np->child;
+	int offset;
+
+	np->children_populated = true;
+
+	fdt_for_each_subnode(offset, of_live_blob, np->offset) {
+		child = of_live_new_node(np, offset);
+		if (!child) {
+			debug("%s: out of memory\n", __func__);
+			break;
+		}
+		*prev_np = child;
+		prev_np = &child->sibling;
+	}
+}
+
+struct device_node *of_live_find_node_by_phandle(phandle handle)
+{
+	struct device_node *np = gd->of_root;
+	int offset;
+
+	offset = fdt_node_offset_by_phandle(of_live_blob, handle);
+	if (offset < 0)
+		return NULL;
+
+	/*
+	 * Subtrees are contiguous in the flat tree, so the node is in the
+	 * subtree of the last child which starts at or before it.
+	 */
+	while (np && np->offset != offset) {
+		struct device_node *child, *next = NULL;
+
+		of_node_populate_children(np);
+		for (child = np->child; child && child->offset <= offset;
+		     child = child->sibling)
+			next = child;
+		np = next;
+	}
+
+	return np;
+}
+
+/**
+ * unflatten_device_tree() - create the root node of a tree built on demand
+ *
+ * @blob: The blob to expand
+ * @mynodes: Returns the root node
+ * @return 0 if OK, -ve on error
+ */
+static int unflatten_device_tree(const void *blob,
+				 struct device_node **mynodes)
+{
+	if (!blob || fdt_check_header(blob)) {
+		debug("Invalid device tree blob header\n");
+		return -EINVAL;
+	}
+
+	of_live_blob = blob;
+	*mynodes = of_live_new_node(NULL, 0);
+	if (!*mynodes)
+		return -ENOMEM;
+
+	return 0;
+}
+#endif /* OF_LIVE_LAZY */
 
 int of_live_build(const void *fdt_blob, struct device_node **rootp)
 {
@@ -19,6 +19,7 @@
 #include <linux/string.h>
 #include <linux/ctype.h>
 #include <malloc.h>
+#include <asm/byteorder.h>
 
 
 /**
@@ -468,26 +469,42 @@ char *strswab(const char *s)
  */
 void * memset(void * s,int c,size_t count)
 {
-	unsigned long *sl = (unsigned long *) s;
-	char *s8;
+	char *s8 = (char *)s;
 
 #if !CONFIG_IS_ENABLED(TINY_MEMSET)
+	unsigned long *sl;
 	unsigned long cl = 0;
 	int i;
 
-	/* do it one word at a time (32 bits or 64 bits) while possible */
-	if ( ((ulong)s & (sizeof(*sl) - 1)) == 0) {
+	/*
+	 * align the destination, then do it several words at a time (32 bits
+	 * or 64 bits each) while possible
+	 */
+	if (count >= 2 * sizeof(*sl)) {
+		while ((ulong)s8 & (sizeof(*sl) - 1)) {
+			*s8++ = c;
+			count--;
+		}
 		for (i = 0; i < sizeof(*sl); i++) {
 			cl <<= 8;
 			cl |= c & 0xff;
 		}
+		sl = (unsigned long *)s8;
+		while (count >= 4 * sizeof(*sl)) {
+			sl[0] = cl;
+			sl[1] = cl;
+			sl[2] = cl;
+			sl[3] = cl;
+			sl += 4;
+			count -= 4 * sizeof(*sl);
+		}
 		while (count >= sizeof(*sl)) {
 			*sl++ = cl;
 			count -= sizeof(*sl);
 		}
+		s8 = (char *)sl;
 	}
 #endif	/* fill 8 bits at a time */
-	s8 = (char *)sl;
 	while (count--)
 		*s8++ = c;
 
@@ -495,6 +512,117 @@ void * memset(void * s,int c,size_t count)
 }
 #endif
 
+#if !CONFIG_IS_ENABLED(TINY_MEMCPY) && \
+	(!defined(__HAVE_ARCH_MEMCPY) || !defined(__HAVE_ARCH_MEMMOVE))
+#define WORD_SIZE	sizeof(unsigned long)
+#define WORD_MASK	(WORD_SIZE - 1)
+#define WORD_BITS	(WORD_SIZE * 8)
+
+/*
+ * Combine the tail of word @lo with the head of the following word @hi, as
+ * loaded from a source which is misaligned by @shift bits
+ */
+#ifdef __BIG_ENDIAN
+#define MERGE(lo, hi, shift) \
+	(((lo) << (shift)) | ((hi) >> (WORD_BITS - (shift))))
+#else
+#define MERGE(lo, hi, shift) \
+	(((lo) >> (shift)) | ((hi) << (WORD_BITS - (shift))))
+#endif
+#endif
+
+#if !CONFIG_IS_ENABLED(TINY_MEMCPY) && !defined(__HAVE_ARCH_MEMCPY)
+/*
+ * Copy @words words forwards to the aligned @dl from @s8, which may have any
+ * alignment. A misaligned source is read a whole aligned word at a time and
+ * shifted into place, so no byte outside the aligned words holding the
+ * source is touched.
+ */
+static void copy_words_fwd(unsigned long *dl, const char *s8, size_t words)
+{
+	unsigned int shift = ((ulong)s8 & WORD_MASK) * 8;
+	const unsigned long *sl;
+	unsigned long lo, hi;
+
+	if (!shift) {
+		sl = (const unsigned long *)s8;
+		while (words >= 4) {
+			unsigned long w0 = sl[0], w1 = sl[1];
+			unsigned long w2 = sl[2], w3 = sl[3];
+
+			dl[0] = w0;
+			dl[1] = w1;
+			dl[2] = w2;
+			dl[3] = w3;
+			dl += 4;
+			sl += 4;
+			words -= 4;
+		}
+		while (words--)
+			*dl++ = *sl++;
+		return;
+	}
+
+	sl = (const unsigned long *)((ulong)s8 & ~WORD_MASK);
+	lo = *sl++;
+	while (words >= 2) {
+		unsigned long mid = sl[0];
+
+		hi = sl[1];
+		dl[0] = MERGE(lo, mid, shift);
+		dl[1] = MERGE(mid, hi, shift);
+		lo = hi;
+		dl += 2;
+		sl += 2;
+		words -= 2;
+	}
+	if (words) {
+		hi = *sl;
+		*dl = MERGE(lo, hi, shift);
+	}
+}
+#endif
+
+#if !CONFIG_IS_ENABLED(TINY_MEMCPY) && !defined(__HAVE_ARCH_MEMMOVE)
+/*
+ * Copy @words words backwards to the aligned end of destination @dl from the
+ * end of source @s8, which may have any alignment
+ */
+static void copy_words_bwd(unsigned long *dl, const char *s8, size_t words)
+{
+	unsigned int shift = ((ulong)s8 & WORD_MASK) * 8;
+	const unsigned long *sl;
+	unsigned long lo, hi;
+
+	if (!shift) {
+		sl = (const unsigned long *)s8;
+		while (words >= 4) {
+			unsigned long w0 = sl[-1], w1 = sl[-2];
+			unsigned long w2 = sl[-3], w3 = sl[-4];
+
+			dl[-1] = w0;
+			dl[-2] = w1;
+			dl[-3] = w2;
+			dl[-4] = w3;
+			dl -= 4;
+			sl -= 4;
+			words -= 4;
+		}
+		while (words--)
+			*--dl = *--sl;
+		return;
+	}
+
+	sl = (const unsigned long *)((ulong)s8 & ~WORD_MASK);
+	hi = *sl;
+	while (words--) {
+		lo = *--sl;
+		*--dl = MERGE(lo, hi, shift);
+		hi = lo;
+	}
+}
+#endif
+
 #ifndef __HAVE_ARCH_MEMCPY
 /**
  * memcpy - Copy one area of memory to another
@@ -504,15 +632,36 @@ void * memset(void * s,int c,size_t count)
  *
  * You should not use this function to access IO space, use memcpy_toio()
  * or memcpy_fromio() instead.
+ *
+ * The copy is always done forwards, which memmove() relies on.
  */
 void * memcpy(void *dest, const void *src, size_t count)
 {
+	char *d8 = (char *)dest;
+	const char *s8 = (const char *)src;
+#if CONFIG_IS_ENABLED(TINY_MEMCPY)
 	unsigned long *dl = (unsigned long *)dest, *sl = (unsigned long *)src;
-	char *d8, *s8;
+#endif
 
 	if (src == dest)
 		return dest;
 
+#if !CONFIG_IS_ENABLED(TINY_MEMCPY)
+	/*
+	 * align the destination, then copy a word at a time whatever the
+	 * alignment of the source is
+	 */
+	if (count >= 2 * WORD_SIZE) {
+		while ((ulong)d8 & WORD_MASK) {
+			*d8++ = *s8++;
+			count--;
+		}
+		copy_words_fwd((unsigned long *)d8, s8, count / WORD_SIZE);
+		d8 += count & ~WORD_MASK;
+		s8 += count & ~WORD_MASK;
+		count &= WORD_MASK;
+	}
+#else
 	/* while all data is aligned (common case), copy a word at a time */
 	if ( (((ulong)dest | (ulong)src) & (sizeof(*dl) - 1)) == 0) {
 		while (count >= sizeof(*dl)) {
@@ -520,9 +669,10 @@ void * memcpy(void *dest, const void *src, size_t count)
 			count -= sizeof(*dl);
 		}
 	}
-	/* copy the reset one byte at a time */
 	d8 = (char *)dl;
 	s8 = (char *)sl;
+#endif
+	/* copy the rest one byte at a time */
 	while (count--)
 		*d8++ = *s8++;
 
@@ -543,14 +693,26 @@ void * memmove(void * dest,const void *src,size_t count)
 {
 	char *tmp, *s;
 
-	if (dest <= src) {
-		memcpy(dest, src, count);
-	} else {
-		tmp = (char *) dest + count;
-		s = (char *) src + count;
-		while (count--)
+	if (dest <= src || (char *)dest >= (char *)src + count)
+		return memcpy(dest, src, count);
+
+	/* the areas overlap with dest above src: copy backwards */
+	tmp = (char *) dest + count;
+	s = (char *) src + count;
+#if !CONFIG_IS_ENABLED(TINY_MEMCPY)
+	if (count >= 2 * WORD_SIZE) {
+		while ((ulong)tmp & WORD_MASK) {
 			*--tmp = *--s;
+			count--;
 		}
+		copy_words_bwd((unsigned long *)tmp, s, count / WORD_SIZE);
+		tmp -= count & ~WORD_MASK;
+		s -= count & ~WORD_MASK;
+		count &= WORD_MASK;
+	}
+#endif
+	while (count--)
+		*--tmp = *--s;
 
 	return dest;
 }
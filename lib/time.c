@@ -8,6 +8,7 @@
 #include <dm.h>
 #include <errno.h>
 #include <timer.h>
+#include <uthread.h>
 #include <watchdog.h>
 #include <div64.h>
 #include <asm/io.h>
@@ -166,7 +167,7 @@ void udelay(unsigned long usec)
 	do {
 		WATCHDOG_RESET();
 		kv = usec > CONFIG_WD_PERIOD ? CONFIG_WD_PERIOD : usec;
-		__udelay (kv);
+		kv = uthread_delay(kv);
 		usec -= kv;
 	} while(usec);
 }
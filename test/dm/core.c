@@ -870,3 +870,103 @@ static int dm_test_uclass_names(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_uclass_names, DM_TESTF_SCAN_PDATA);
+
+#define INDEX_DEV_COUNT	200
+
+/* Find a device by walking the uclass, as lookups did before the index */
+static struct udevice *find_linear(struct uclass *uc, const char *name,
+				   int seq, ulong *checked)
+{
+	struct udevice *dev;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		(*checked)++;
+		if (name ? !strcmp(dev->name, name) : dev->seq == seq)
+			return dev;
+	}
+
+	return NULL;
+}
+
+/* Check that indexed lookups find the same devices as walking the list */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *child[INDEX_DEV_COUNT], *dev;
+	ulong linear_us, index_us, checked = 0;
+	struct uclass *uc;
+	char name[20];
+	ulong start;
+	int i;
+
+	ut_assertok(create_children(uts, dms->root, INDEX_DEV_COUNT, 0,
+				    child));
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		snprintf(name, sizeof(name), "index-%d", i);
+		ut_assertok(device_set_name(child[i], name));
+		ut_assertok(device_probe(child[i]));
+	}
+	ut_assertok(uclass_get(UCLASS_TEST, &uc));
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		ut_asserteq_ptr(child[i],
+				find_linear(uc, child[i]->name, 0, &checked));
+		ut_asserteq_ptr(child[i],
+				find_linear(uc, NULL, child[i]->seq, &checked));
+	}
+	linear_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_DEV_COUNT; i++) {
+		ut_assertok(uclass_find_device_by_name(UCLASS_TEST,
+						       child[i]->name, &dev));
+		ut_asserteq_ptr(child[i], dev);
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST,
+						      child[i]->seq, false,
+						      &dev));
+		ut_asserteq_ptr(child[i], dev);
+	}
+	index_us = timer_get_us() - start;
+	printf("%d lookups: %lu us checking %lu devices, %lu us indexed\n",
+	       INDEX_DEV_COUNT * 2, linear_us, checked, index_us);
+
+	/* A prefix still finds the first match, but an exact one wins */
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-1", &dev));
+	ut_asserteq_ptr(child[1], dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-19", &dev));
+	ut_asserteq_ptr(child[19], dev);
+
+	/* Changes to the name and sequence number are followed */
+	ut_assertok(device_set_name(child[5], "renamed"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "renamed", &dev));
+	ut_asserteq_ptr(child[5], dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-5", &dev));
+	ut_asserteq_ptr(child[50], dev);
+	i = child[150]->seq;
+	ut_assertok(device_remove(child[150], DM_REMOVE_NORMAL));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, i, false,
+						       &dev));
+	ut_assertok(device_unbind(child[150]));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST, "index-150",
+							&dev));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-8", &dev));
+	ut_asserteq_ptr(child[8], dev);
+
+	/* Devices bound from the device tree are found by their node */
+	ut_assertok(uclass_get(UCLASS_TEST_FDT, &uc));
+	i = 0;
+	uclass_foreach_dev(dev, uc) {
+		struct udevice *found;
+
+		ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST_FDT,
+							 dev_ofnode(dev),
+							 &found));
+		ut_asserteq_ptr(dev, found);
+		i++;
+	}
+	ut_assert(i > 1);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, DM_TESTF_SCAN_FDT);
@@ -27,16 +27,24 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 {
 	struct udevice *dev;
 	struct blk_desc *dev_desc;
-	char cmp[1024];
+	char write[1024], read[1024];
+	int i;
 
 	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
 	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
 
-	/* Read a few blocks and look for the string we expect */
+	/* Write a few blocks and check that the same data reads back */
 	ut_asserteq(512, dev_desc->blksz);
-	memset(cmp, '\0', sizeof(cmp));
-	ut_asserteq(2, blk_dread(dev_desc, 0, 2, cmp));
-	ut_assertok(strcmp(cmp, "this is a test"));
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i;
+	ut_asserteq(2, blk_dwrite(dev_desc, 0, 2, write));
+	ut_asserteq(2, blk_dread(dev_desc, 0, 2, read));
+	ut_assertok(memcmp(write, read, sizeof(write)));
+
+	/* Single blocks too, past the end of what was written */
+	ut_asserteq(1, blk_dwrite(dev_desc, 5, 1, write + 512));
+	ut_asserteq(1, blk_dread(dev_desc, 5, 1, read));
+	ut_assertok(memcmp(write + 512, read, 512));
 
 	return 0;
 }
@@ -2,9 +2,13 @@
 
 #include <common.h>
 #include <dm.h>
+#include <fdtdec.h>
+#include <malloc.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static int dm_test_ofnode_compatible(struct unit_test_state *uts)
 {
 	ofnode root_node = ofnode_path("/");
@@ -15,3 +19,70 @@ static int dm_test_ofnode_compatible(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_ofnode_compatible, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static int dm_test_ofnode_by_phandle(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	u32 phandle;
+	ofnode ofn;
+	int node;
+
+	/* Every phandle must give the node that a search of the blob gives */
+	for (node = fdt_next_node(blob, -1, NULL); node >= 0;
+	     node = fdt_next_node(blob, node, NULL)) {
+		phandle = fdt_get_phandle(blob, node);
+		if (!phandle)
+			continue;
+		ut_asserteq(node, fdtdec_node_offset_by_phandle(blob, phandle));
+
+		ofn = ofnode_get_by_phandle(phandle);
+		ut_assert(ofnode_valid(ofn));
+		ut_asserteq_str(fdt_get_name(blob, node, NULL),
+				ofnode_get_name(ofn));
+	}
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_node_offset_by_phandle(blob, 0x7fffffff));
+	ut_asserteq(-FDT_ERR_BADPHANDLE, fdtdec_node_offset_by_phandle(blob, 0));
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_by_phandle, DM_TESTF_SCAN_FDT);
+
+/* A changed control FDT must not give stale results */
+static int dm_test_ofnode_by_phandle_write(struct unit_test_state *uts)
+{
+	const void *old_blob = gd->fdt_blob;
+	int size = fdt_totalsize(old_blob) + 256;
+	u32 phandle = 0;
+	char path[256];
+	int node;
+	void *blob;
+
+	blob = malloc(size);
+	ut_assertnonnull(blob);
+	ut_assertok(fdt_open_into(old_blob, blob, size));
+	gd->fdt_blob = blob;
+
+	/* Build the index by looking up the first node with a phandle */
+	for (node = fdt_next_node(blob, -1, NULL); node >= 0 && !phandle;
+	     node = fdt_next_node(blob, node, NULL))
+		phandle = fdt_get_phandle(blob, node);
+	ut_assert(phandle);
+	node = fdtdec_node_offset_by_phandle(blob, phandle);
+	ut_assert(node > 0);
+	ut_assertok(fdt_get_path(blob, node, path, sizeof(path)));
+
+	/* Add a node in front of all others, which moves them */
+	node = fdt_add_subnode(blob, 0, "new-node");
+	ut_assert(node > 0);
+	ut_assertok(fdt_setprop_u32(blob, node, "phandle", 0x7fffffff));
+	ut_asserteq(node, fdtdec_node_offset_by_phandle(blob, 0x7fffffff));
+	ut_asserteq(fdt_path_offset(blob, path),
+		    fdtdec_node_offset_by_phandle(blob, phandle));
+
+	gd->fdt_blob = old_blob;
+	free(blob);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_by_phandle_write, 0);
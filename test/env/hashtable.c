@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the hash table in lib/hashtable.c
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+#define NUM_KEYS	300
+
+static void make_key(char *buf, int i)
+{
+	/* Spread the keys so that they are not entered in order */
+	sprintf(buf, "var%03d", (i * 7) % NUM_KEYS);
+}
+
+/* Enter many more variables than the table was created for */
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	char key[16];
+	ENTRY e, *ep;
+	int i;
+
+	memset(&htab, '\0', sizeof(htab));
+	ut_assert(hcreate_r(5, &htab));
+	ut_asserteq(5, htab.size);
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		make_key(key, i);
+		e.key = key;
+		e.data = key;
+		ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+		ut_assertnonnull(ep);
+	}
+	ut_asserteq(NUM_KEYS, htab.filled);
+	ut_asserteq(NUM_KEYS, htab.inserts);
+	ut_assert(htab.resizes > 0);
+	ut_assert(htab.filled * 4 <= htab.size * 3);
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		make_key(key, i);
+		e.key = key;
+		e.data = NULL;
+		ut_assert(hsearch_r(e, FIND, &ep, &htab, 0));
+		ut_asserteq_str(key, ep->data);
+	}
+
+	/* Deleted slots are reclaimed rather than filling up the table */
+	for (i = 0; i < 10 * NUM_KEYS; i++) {
+		e.key = "tmp";
+		e.data = "1";
+		ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+		ut_assert(hdelete_r("tmp", &htab, 0));
+	}
+	ut_asserteq(NUM_KEYS, htab.filled);
+	ut_assert(htab.filled + htab.deleted < htab.size);
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_grow, 0);
+
+/* Export must list the variables sorted by name, also after deletions */
+static int env_test_htab_export(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	char key[16], *res = NULL, *p;
+	ENTRY e, *ep;
+	int i;
+
+	memset(&htab, '\0', sizeof(htab));
+	ut_assert(hcreate_r(5, &htab));
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		make_key(key, i);
+		e.key = key;
+		e.data = "x";
+		ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+	}
+	for (i = 0; i < NUM_KEYS; i += 2) {
+		sprintf(key, "var%03d", i);
+		ut_assert(hdelete_r(key, &htab, 0));
+	}
+
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	for (i = 1, p = res; i < NUM_KEYS; i += 2) {
+		sprintf(key, "var%03d=x\n", i);
+		ut_assertok(strncmp(key, p, strlen(key)));
+		p += strlen(key);
+	}
+	ut_asserteq('\0', *p);
+
+	free(res);
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_export, 0);
+
+static struct hsearch_data *grow_htab;
+
+/* Enter enough variables to resize the table while one is being deleted */
+static int grow_on_delete(const char *name, const char *value,
+			  enum env_op op, int flags)
+{
+	char key[16];
+	ENTRY e, *ep;
+	int i;
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		make_key(key, i);
+		e.key = key;
+		e.data = "y";
+		if (!hsearch_r(e, ENTER, &ep, grow_htab, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* A delete callback which changes the table must not delete the wrong slot */
+static int env_test_htab_delete_callback(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	unsigned int resizes;
+	char key[16];
+	ENTRY e, *ep;
+	int i;
+
+	memset(&htab, '\0', sizeof(htab));
+	ut_assert(hcreate_r(5, &htab));
+	grow_htab = &htab;
+
+	e.key = "victim";
+	e.data = "x";
+	ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+	ep->callback = grow_on_delete;
+
+	resizes = htab.resizes;
+	ut_assert(hdelete_r("victim", &htab, 0));
+	ut_assert(htab.resizes > resizes);
+
+	e.key = "victim";
+	ut_assert(!hsearch_r(e, FIND, &ep, &htab, 0));
+	ut_asserteq(NUM_KEYS, htab.filled);
+	for (i = 0; i < NUM_KEYS; i++) {
+		make_key(key, i);
+		e.key = key;
+		ut_assert(hsearch_r(e, FIND, &ep, &htab, 0));
+		ut_asserteq_str("y", ep->data);
+	}
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_delete_callback, 0);
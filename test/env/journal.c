@@ -0,0 +1,440 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the environment journal in env/journal.c
+ *
+ * The environment is stored in a buffer which behaves like NOR flash: a
+ * write may only clear bits, so records must go to erased space. On sandbox
+ * it is also stored on the SPI flash and MMC devices, through their drivers.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <command.h>
+#include <dm.h>
+#include <environment.h>
+#include <malloc.h>
+#include <search.h>
+#include <spi_flash.h>
+#include <test/env.h>
+#include <test/ut.h>
+#ifdef CONFIG_SANDBOX
+#include <asm/state.h>
+#endif
+
+static const char test_env[] = "arch=sandbox\0bootdelay=3\0serial=115200\0";
+
+static uchar *test_store;
+static int test_overwrites;
+
+static int test_write(ulong offset, ulong len, const void *buf)
+{
+	const uchar *p = buf;
+	ulong i;
+
+	if (offset + len > CONFIG_ENV_SIZE)
+		return -EINVAL;
+
+	for (i = 0; i < len; i++) {
+		if (test_store[offset + i] != 0xff)
+			test_overwrites++;
+		test_store[offset + i] &= p[i];
+	}
+
+	return 0;
+}
+
+/* Replace the environment with test_env and save it in full */
+static int test_setup(struct unit_test_state *uts, char **saved)
+{
+	*saved = malloc(ENV_SIZE);
+	ut_assertnonnull(*saved);
+	ut_assert(hexport_r(&env_htab, '\0', 0, saved, ENV_SIZE, 0,
+			    NULL) > 0);
+	ut_assert(himport_r(&env_htab, test_env, sizeof(test_env), '\0', 0, 0,
+			    0, NULL));
+
+	test_store = malloc(CONFIG_ENV_SIZE);
+	ut_assertnonnull(test_store);
+	memset(test_store, 0xff, CONFIG_ENV_SIZE);
+	ut_assertok(env_export((env_t *)test_store));
+	test_overwrites = 0;
+
+	return 0;
+}
+
+static int test_restore(struct unit_test_state *uts, char *saved)
+{
+	env_journal_reset();
+	free(test_store);
+	ut_assert(himport_r(&env_htab, saved, ENV_SIZE, '\0', 0, 0, 0, NULL));
+	free(saved);
+
+	return 0;
+}
+
+/* Load the environment back from the store */
+static int test_load(struct unit_test_state *uts)
+{
+	ut_assert(himport_r(&env_htab, "", 0, '\0', 0, 0, 0, NULL));
+	ut_assertok(env_import((char *)test_store, 1));
+
+	return 0;
+}
+
+static int env_test_journal_append(struct unit_test_state *uts)
+{
+	env_t *ep;
+	uchar *copy;
+	char *saved;
+	uint32_t crc;
+
+	ut_assertok(test_setup(uts, &saved));
+	ep = (env_t *)test_store;
+	crc = ep->crc;
+
+	/* A freshly saved environment is a normal one */
+	ut_asserteq(crc, crc32(0, ep->data, ENV_SIZE));
+
+	ut_assertok(env_set("bootdelay", "0"));
+	ut_assertok(env_set("serial", NULL));
+	ut_assertok(env_set("bootcount", "1"));
+	ut_assertok(env_journal_save(test_write));
+	ut_asserteq(crc, ep->crc);
+	ut_assert(crc != crc32(0, ep->data, ENV_SIZE));
+
+	/* Nothing is written without changes */
+	copy = malloc(CONFIG_ENV_SIZE);
+	ut_assertnonnull(copy);
+	memcpy(copy, test_store, CONFIG_ENV_SIZE);
+	ut_assertok(env_journal_save(test_write));
+	ut_assertok(memcmp(copy, test_store, CONFIG_ENV_SIZE));
+	free(copy);
+
+	ut_assertok(env_set("bootcount", "2"));
+	ut_assertok(env_journal_save(test_write));
+
+	/* Both records are applied on import, and more can be added */
+	ut_assertok(test_load(uts));
+	ut_asserteq_str("sandbox", env_get("arch"));
+	ut_asserteq_str("0", env_get("bootdelay"));
+	ut_assertnull(env_get("serial"));
+	ut_asserteq_str("2", env_get("bootcount"));
+
+	ut_assertok(env_set("bootcount", "3"));
+	ut_assertok(env_journal_save(test_write));
+	ut_assertok(test_load(uts));
+	ut_asserteq_str("3", env_get("bootcount"));
+
+	ut_asserteq(0, test_overwrites);
+	ut_assertok(test_restore(uts, saved));
+
+	return 0;
+}
+ENV_TEST(env_test_journal_append, 0);
+
+static int env_test_journal_full(struct unit_test_state *uts)
+{
+	char *saved, val[32];
+	int i, ret;
+
+	ut_assertok(test_setup(uts, &saved));
+
+	for (i = 0; ; i++) {
+		snprintf(val, sizeof(val), "%d", i);
+		ut_assertok(env_set("bootcount", val));
+		ret = env_journal_save(test_write);
+		if (ret)
+			break;
+	}
+	ut_asserteq(-ENOSPC, ret);
+	ut_assert(i > 100);
+	ut_asserteq(0, test_overwrites);
+
+	/* The last change was not appended */
+	ut_assertok(test_load(uts));
+	snprintf(val, sizeof(val), "%d", i - 1);
+	ut_asserteq_str(val, env_get("bootcount"));
+
+	/* A full save starts over */
+	ut_assertok(env_set("bootcount", "1000"));
+	ut_asserteq(-ENOSPC, env_journal_save(test_write));
+	memset(test_store, 0xff, CONFIG_ENV_SIZE);
+	ut_assertok(env_export((env_t *)test_store));
+	ut_assertok(env_set("bootcount", "1001"));
+	ut_assertok(env_journal_save(test_write));
+	ut_assertok(test_load(uts));
+	ut_asserteq_str("1001", env_get("bootcount"));
+
+	ut_assertok(test_restore(uts, saved));
+
+	return 0;
+}
+ENV_TEST(env_test_journal_full, 0);
+
+/* Environments saved without a journal, and torn records */
+static int env_test_journal_compat(struct unit_test_state *uts)
+{
+	env_t *ep;
+	char *saved;
+
+	ut_assertok(test_setup(uts, &saved));
+	ep = (env_t *)test_store;
+
+	/* Older versions pad with zeroes, which cannot take records */
+	memset(ep->data + sizeof(test_env), '\0',
+	       ENV_SIZE - sizeof(test_env));
+	ep->crc = crc32(0, ep->data, ENV_SIZE);
+	ut_assertok(test_load(uts));
+	ut_asserteq_str("3", env_get("bootdelay"));
+	ut_assertok(env_set("bootdelay", "1"));
+	ut_asserteq(-ENOSPC, env_journal_save(test_write));
+
+	/* A record with a bad CRC is dropped, with the rest of the journal */
+	memset(test_store, 0xff, CONFIG_ENV_SIZE);
+	ut_assertok(env_export(ep));
+	ut_assertok(env_set("bootdelay", "2"));
+	ut_assertok(env_journal_save(test_write));
+	ut_assertok(env_set("bootdelay", "5"));
+	ut_assertok(env_journal_save(test_write));
+	/* the data of the first record follows its 12-byte header */
+	ep->data[ALIGN(sizeof(test_env), 4) + 12] ^= 1;
+
+	ut_assertok(test_load(uts));
+	ut_asserteq_str("1", env_get("bootdelay"));
+	ut_asserteq(-ENOSPC, env_journal_save(test_write));
+
+	ut_assertok(test_restore(uts, saved));
+
+	return 0;
+}
+ENV_TEST(env_test_journal_compat, 0);
+
+#ifdef CONFIG_SANDBOX
+/* Where the environment goes on the devices */
+#define TEST_SF_OFFSET		0x100000
+#define TEST_MMC_OFFSET		0x10000
+
+/**
+ * struct test_dev - A device holding the environment
+ *
+ * @read: Read @len bytes at byte @offset of the stored env_t into @buf
+ * @write: Write @len bytes from @buf at byte @offset of the stored env_t
+ * @erase: Erase the environment before it is written in full
+ */
+struct test_dev {
+	int (*read)(ulong offset, ulong len, void *buf);
+	int (*write)(ulong offset, ulong len, const void *buf);
+	int (*erase)(void);
+};
+
+static struct spi_flash *test_flash;
+static struct blk_desc *test_mmc;
+
+/* Bytes of the next write which reach storage before the power fails */
+static long test_cut = -1;
+
+/* Return how much of a write reaches storage */
+static ulong test_cut_len(ulong len)
+{
+	return test_cut >= 0 ? min_t(ulong, len, test_cut) : len;
+}
+
+static int test_sf_read(ulong offset, ulong len, void *buf)
+{
+	return spi_flash_read(test_flash, TEST_SF_OFFSET + offset, len, buf);
+}
+
+/* Program the flash, counting bytes which were not erased */
+static int test_sf_write(ulong offset, ulong len, const void *buf)
+{
+	uchar *old;
+	ulong i;
+	int ret;
+
+	old = malloc(len);
+	if (!old)
+		return -ENOMEM;
+	ret = test_sf_read(offset, len, old);
+	for (i = 0; !ret && i < len; i++) {
+		if (old[i] != 0xff)
+			test_overwrites++;
+	}
+	free(old);
+	if (!ret)
+		ret = spi_flash_write(test_flash, TEST_SF_OFFSET + offset,
+				      test_cut_len(len), buf);
+
+	return ret ? ret : test_cut >= 0 ? -EIO : 0;
+}
+
+static int test_sf_erase(void)
+{
+	ulong size = roundup(CONFIG_ENV_SIZE, test_flash->erase_size);
+
+	return spi_flash_erase(test_flash, TEST_SF_OFFSET, size);
+}
+
+/* Read or write a byte range of the card, through whole blocks */
+static int test_mmc_access(ulong offset, ulong len, void *dst,
+			   const void *src)
+{
+	ulong blksz = test_mmc->blksz;
+	ulong pos = TEST_MMC_OFFSET + offset;
+	ulong start = rounddown(pos, blksz);
+	ulong count = (roundup(pos + len, blksz) - start) / blksz;
+	char *tmp;
+	int ret = -EIO;
+
+	tmp = malloc(count * blksz);
+	if (!tmp)
+		return -ENOMEM;
+	if (blk_dread(test_mmc, start / blksz, count, tmp) != count)
+		goto out;
+	if (dst) {
+		memcpy(dst, tmp + pos - start, len);
+	} else {
+		memcpy(tmp + pos - start, src, test_cut_len(len));
+		if (blk_dwrite(test_mmc, start / blksz, count, tmp) != count)
+			goto out;
+		if (test_cut >= 0)
+			goto out;
+	}
+	ret = 0;
+out:
+	free(tmp);
+	return ret;
+}
+
+static int test_mmc_read(ulong offset, ulong len, void *buf)
+{
+	return test_mmc_access(offset, len, buf, NULL);
+}
+
+static int test_mmc_write(ulong offset, ulong len, const void *buf)
+{
+	return test_mmc_access(offset, len, NULL, buf);
+}
+
+/* MMC needs no erase: a full save writes the erased journal area */
+static int test_mmc_erase(void)
+{
+	return 0;
+}
+
+/* Save the environment in full, as the backends do */
+static int test_dev_save(struct unit_test_state *uts,
+			 const struct test_dev *dev)
+{
+	memset(test_store, 0xff, CONFIG_ENV_SIZE);
+	ut_assertok(env_export((env_t *)test_store));
+	ut_assertok(dev->erase());
+	ut_assertok(dev->write(0, CONFIG_ENV_SIZE, test_store));
+
+	return 0;
+}
+
+/* Load the environment from the device, as after a reset */
+static int test_dev_load(struct unit_test_state *uts,
+			 const struct test_dev *dev)
+{
+	memset(test_store, '\0', CONFIG_ENV_SIZE);
+	ut_assertok(dev->read(0, CONFIG_ENV_SIZE, test_store));
+
+	return test_load(uts);
+}
+
+static int test_dev_journal(struct unit_test_state *uts,
+			    const struct test_dev *dev)
+{
+	char *saved;
+
+	ut_assertok(test_setup(uts, &saved));
+	ut_assertok(test_dev_save(uts, dev));
+	test_overwrites = 0;
+
+	ut_assertok(env_set("bootcount", "1"));
+	ut_assertok(env_journal_save(dev->write));
+	ut_assertok(env_set("bootcount", "2"));
+	ut_assertok(env_set("serial", NULL));
+	ut_assertok(env_journal_save(dev->write));
+
+	/* The records are replayed after a reset, and more can be added */
+	ut_assertok(test_dev_load(uts, dev));
+	ut_asserteq_str("sandbox", env_get("arch"));
+	ut_asserteq_str("2", env_get("bootcount"));
+	ut_assertnull(env_get("serial"));
+	ut_assertok(env_set("bootdelay", "0"));
+	ut_assertok(env_journal_save(dev->write));
+	ut_assertok(test_dev_load(uts, dev));
+	ut_asserteq_str("0", env_get("bootdelay"));
+
+	/* The power fails in the middle of a record, which is then dropped */
+	ut_assertok(env_set("bootcount", "3"));
+	ut_assertok(env_set("bootdelay", "5"));
+	test_cut = 20;
+	ut_asserteq(-EIO, env_journal_save(dev->write));
+	test_cut = -1;
+	ut_assertok(test_dev_load(uts, dev));
+	ut_asserteq_str("2", env_get("bootcount"));
+	ut_asserteq_str("0", env_get("bootdelay"));
+	ut_assertnull(env_get("serial"));
+
+	/* The torn record is in the way, so the next save is in full */
+	ut_assertok(env_set("bootcount", "3"));
+	ut_asserteq(-ENOSPC, env_journal_save(dev->write));
+	ut_assertok(test_dev_save(uts, dev));
+	ut_assertok(env_set("bootcount", "4"));
+	ut_assertok(env_journal_save(dev->write));
+	ut_assertok(test_dev_load(uts, dev));
+	ut_asserteq_str("4", env_get("bootcount"));
+	ut_asserteq_str("0", env_get("bootdelay"));
+
+	ut_asserteq(0, test_overwrites);
+	ut_assertok(test_restore(uts, saved));
+
+	return 0;
+}
+
+/* The journal on the sandbox SPI flash, backed by spi.bin */
+static int env_test_journal_sf(struct unit_test_state *uts)
+{
+	static const struct test_dev dev = {
+		.read	= test_sf_read,
+		.write	= test_sf_write,
+		.erase	= test_sf_erase,
+	};
+	struct udevice *flash;
+	int ret;
+
+	ut_assertok(uclass_get_device(UCLASS_SPI_FLASH, 0, &flash));
+	test_flash = dev_get_uclass_priv(flash);
+	ret = test_dev_journal(uts, &dev);
+	test_flash = NULL;
+
+	/* Do not leave the emulator behind for tests which rebuild devices */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return ret;
+}
+ENV_TEST(env_test_journal_sf, 0);
+
+/* The journal on sandbox MMC, read and written in whole blocks */
+static int env_test_journal_mmc(struct unit_test_state *uts)
+{
+	static const struct test_dev dev = {
+		.read	= test_mmc_read,
+		.write	= test_mmc_write,
+		.erase	= test_mmc_erase,
+	};
+	struct udevice *mmc;
+	int ret;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &mmc));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &test_mmc));
+	ret = test_dev_journal(uts, &dev);
+	test_mmc = NULL;
+
+	return ret;
+}
+ENV_TEST(env_test_journal_mmc, 0);
+#endif /* CONFIG_SANDBOX */
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the batched fixups in common/fdt_support.c
+ *
+ * The same changes are made to two copies of a tree, directly and in a
+ * batch, and the results compared.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define FDT_SIZE	4096
+
+static int make_tree(struct unit_test_state *uts, void *fdt, int size)
+{
+	int soc, node;
+
+	ut_assertok(fdt_create_empty_tree(fdt, size));
+	ut_assert(fdt_add_subnode(fdt, 0, "chosen") >= 0);
+	soc = fdt_add_subnode(fdt, 0, "soc");
+	ut_assert(soc >= 0);
+
+	node = fdt_add_subnode(fdt, soc, "serial@0");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fdt, node, "compatible", "ns16550"));
+	ut_assertok(fdt_setprop_string(fdt, node, "status", "okay"));
+	ut_assertok(fdt_setprop_u32(fdt, node, "reg-shift", 2));
+
+	node = fdt_add_subnode(fdt, soc, "serial@1");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_u32(fdt, node, "reg-shift", 2));
+	ut_assertok(fdt_setprop_string(fdt, node, "compatible", "ns16550"));
+
+	return 0;
+}
+
+/* Make the changes, which are the same whether batched or not */
+static int make_changes(struct unit_test_state *uts, void *fdt)
+{
+	int node = fdt_path_offset(fdt, "/soc/serial@1");
+
+	ut_assert(node >= 0);
+	do_fixup_by_path_string(fdt, "/chosen", "bootargs", "console=ttyS0");
+	do_fixup_by_compat_u32(fdt, "ns16550", "clock-frequency", 1843200, 1);
+	do_fixup_by_compat_u32(fdt, "ns16550", "reg-shift", 0, 0);
+	ut_assertok(fdt_set_node_status(fdt, node, FDT_STATUS_DISABLED, 0));
+	ut_assertok(fdt_batch_setprop_string(fdt, node, "status", "fail"));
+	ut_assertok(fdt_batch_setprop_string(fdt, node, "label", "temp"));
+	ut_assertok(fdt_batch_delprop(fdt, node, "label"));
+	ut_assertok(fdt_batch_delprop(fdt, node, "reg-shift"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_batch_delprop(fdt, node, "label"));
+
+	node = fdt_path_offset(fdt, "/soc");
+	ut_assertok(fdt_batch_setprop_u32(fdt, node, "#address-cells", 1));
+
+	return 0;
+}
+
+/* Check that two trees have the same nodes and properties */
+static int check_same(struct unit_test_state *uts, const void *a,
+		      const void *b)
+{
+	int na, nb, prop, lena, lenb;
+	const char *name;
+	const void *va, *vb;
+
+	ut_assertok(fdt_check_header(a));
+	for (na = 0, nb = 0; na >= 0;
+	     na = fdt_next_node(a, na, NULL), nb = fdt_next_node(b, nb, NULL)) {
+		ut_assert(nb >= 0);
+		ut_asserteq_str(fdt_get_name(a, na, NULL),
+				fdt_get_name(b, nb, NULL));
+		lena = 0;
+		fdt_for_each_property_offset(prop, a, na) {
+			va = fdt_getprop_by_offset(a, prop, &name, &lena);
+			vb = fdt_getprop(b, nb, name, &lenb);
+			ut_assertnonnull(vb);
+			ut_asserteq(lena, lenb);
+			ut_assertok(memcmp(va, vb, lena));
+		}
+		lena = 0;
+		lenb = 0;
+		fdt_for_each_property_offset(prop, a, na)
+			lena++;
+		fdt_for_each_property_offset(prop, b, nb)
+			lenb++;
+		ut_asserteq(lena, lenb);
+	}
+	ut_assert(nb < 0);
+
+	return 0;
+}
+
+static int lib_fdt_batch(struct unit_test_state *uts)
+{
+	void *ref, *fdt;
+	const char *value;
+	int node;
+
+	ref = malloc(FDT_SIZE);
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(ref);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_tree(uts, ref, FDT_SIZE));
+	memcpy(fdt, ref, FDT_SIZE);
+
+	ut_assertok(make_changes(uts, ref));
+
+	ut_assertok(fdt_batch_begin(fdt));
+	ut_assertok(make_changes(uts, fdt));
+
+	/* Nothing changes until the batch is committed */
+	node = fdt_path_offset(fdt, "/soc/serial@1");
+	value = fdt_getprop(fdt, node, "reg-shift", NULL);
+	ut_assertnonnull(value);
+	ut_assertnull(fdt_getprop(fdt, 0, "bootargs", NULL));
+
+	ut_assertok(fdt_batch_commit(fdt));
+	ut_assertok(check_same(uts, ref, fdt));
+	ut_assertok(check_same(uts, fdt, ref));
+
+	/* Adding a node writes out the batch first */
+	ut_assertok(fdt_batch_begin(fdt));
+	ut_assertok(fdt_batch_setprop_u32(fdt, 0, "test-value", 1));
+	node = fdt_find_or_add_subnode(fdt, 0, "memory");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_batch_setprop_string(fdt, node, "device_type",
+					     "memory"));
+	ut_assertnonnull(fdt_getprop(fdt, 0, "test-value", NULL));
+	ut_assertok(fdt_batch_commit(fdt));
+	node = fdt_path_offset(fdt, "/memory");
+	value = fdt_getprop(fdt, node, "device_type", NULL);
+	ut_assertnonnull(value);
+	ut_asserteq_str("memory", value);
+
+	free(fdt);
+	free(ref);
+
+	return 0;
+}
+LIB_TEST(lib_fdt_batch, 0);
+
+/* Changes which do not fit leave the tree as it was */
+static int lib_fdt_batch_nospace(struct unit_test_state *uts)
+{
+	char big[256];
+	void *fdt, *copy;
+	int size, len;
+
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_tree(uts, fdt, FDT_SIZE));
+	ut_assertok(fdt_pack(fdt));
+	size = fdt_totalsize(fdt) + 64;
+	fdt_set_totalsize(fdt, size);
+	copy = malloc(size);
+	ut_assertnonnull(copy);
+	memcpy(copy, fdt, size);
+
+	memset(big, 'x', sizeof(big));
+	ut_assertok(fdt_batch_begin(fdt));
+	ut_assertok(fdt_batch_setprop(fdt, 0, "big", big, sizeof(big)));
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_batch_commit(fdt));
+	ut_assertok(memcmp(copy, fdt, size));
+
+	/* The batch has ended */
+	ut_asserteq(-FDT_ERR_NOSPACE,
+		    fdt_batch_setprop(fdt, 0, "big", big, sizeof(big)));
+
+	/* Changes are kept when writing them out early fails */
+	memcpy(copy, fdt, size);
+	ut_assertok(fdt_batch_begin(fdt));
+	ut_assertok(fdt_batch_setprop(fdt, 0, "big", big, sizeof(big)));
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_find_or_add_subnode(fdt, 0, "new"));
+	ut_assertok(memcmp(copy, fdt, size));
+	fdt_set_totalsize(fdt, FDT_SIZE);
+	ut_assert(fdt_find_or_add_subnode(fdt, 0, "new") >= 0);
+	ut_assertok(fdt_batch_commit(fdt));
+	ut_assertnonnull(fdt_getprop(fdt, 0, "big", &len));
+	ut_asserteq(sizeof(big), len);
+
+	free(copy);
+	free(fdt);
+
+	return 0;
+}
+LIB_TEST(lib_fdt_batch_nospace, 0);
+
+/* Running out of memory writes out the batch and then makes the change */
+static int lib_fdt_batch_nomem(struct unit_test_state *uts)
+{
+	void *fdt, *big, **hog, **next;
+	const void *prop;
+	int node, size, len;
+
+	/* Room for a property which cannot be recorded */
+	size = FDT_SIZE * 4;
+	fdt = malloc(size);
+	big = calloc(1, FDT_SIZE * 2);
+	ut_assertnonnull(fdt);
+	ut_assertnonnull(big);
+	ut_assertok(make_tree(uts, fdt, size));
+
+	ut_assertok(fdt_batch_begin(fdt));
+	ut_assertok(fdt_batch_setprop_string(fdt, 0, "model", "test"));
+
+	/*
+	 * Use up the heap, leaving enough for writing out the batch but not
+	 * for recording the value. The edit above moves the nodes after it.
+	 */
+	hog = NULL;
+	while ((next = malloc(FDT_SIZE))) {
+		*next = hog;
+		hog = next;
+	}
+	next = *hog;
+	free(hog);
+	hog = next;
+
+	node = fdt_path_offset(fdt, "/soc/serial@1");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_batch_setprop(fdt, node, "big", big, FDT_SIZE * 2));
+
+	while (hog) {
+		next = *hog;
+		free(hog);
+		hog = next;
+	}
+
+	ut_assertok(fdt_batch_commit(fdt));
+	ut_asserteq_str("test", fdt_getprop(fdt, 0, "model", NULL));
+	node = fdt_path_offset(fdt, "/soc/serial@1");
+	ut_assert(node >= 0);
+	ut_assertnonnull(fdt_getprop(fdt, node, "big", &len));
+	ut_asserteq(FDT_SIZE * 2, len);
+	prop = fdt_getprop(fdt, node, "compatible", NULL);
+	ut_assertnonnull(prop);
+	ut_asserteq_str("ns16550", prop);
+	node = fdt_path_offset(fdt, "/soc/serial@0");
+	ut_assertnull(fdt_getprop(fdt, node, "big", NULL));
+
+	free(big);
+	free(fdt);
+
+	return 0;
+}
+LIB_TEST(lib_fdt_batch_nomem, 0);
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the memory functions in lib/string.c
+ *
+ * Each function is checked against a byte-by-byte reference for all
+ * combinations of small sizes and of source and destination alignment, and
+ * its throughput is reported for a few sizes and alignments.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <linux/math64.h>
+
+/* Large enough for every alignment and length combination below */
+#define BUF_SIZE	256
+#define MAX_ALIGN	(2 * sizeof(long))
+#define MAX_LEN		(BUF_SIZE - 4 * MAX_ALIGN)
+
+/* Sizes used for the throughput figures */
+static const int speed_sizes[] = { 64, 4096, 65536, 262144 };
+
+static void fill_pattern(u8 *buf, int len, u8 seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = seed + i * 7;
+}
+
+/* Reference copy, independent of the functions under test */
+static void copy_bytes(u8 *dst, const u8 *src, int len)
+{
+	while (len--)
+		*dst++ = *src++;
+}
+
+static int lib_memset(struct unit_test_state *uts)
+{
+	u8 buf[BUF_SIZE], ref[BUF_SIZE];
+	int off, len, i;
+
+	for (off = 0; off < MAX_ALIGN; off++) {
+		for (len = 0; len < MAX_LEN; len++) {
+			fill_pattern(buf, BUF_SIZE, off);
+			copy_bytes(ref, buf, BUF_SIZE);
+			for (i = 0; i < len; i++)
+				ref[off + i] = 0xa5;
+
+			ut_asserteq_ptr(buf + off,
+					memset(buf + off, 0xa5, len));
+			ut_assertf(!memcmp(buf, ref, BUF_SIZE),
+				   "off=%d len=%d\n", off, len);
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_memset, 0);
+
+static int lib_memcpy(struct unit_test_state *uts)
+{
+	u8 src[BUF_SIZE], dst[BUF_SIZE], ref[BUF_SIZE];
+	int soff, doff, len;
+
+	fill_pattern(src, BUF_SIZE, 1);
+	for (soff = 0; soff < MAX_ALIGN; soff++) {
+		for (doff = 0; doff < MAX_ALIGN; doff++) {
+			for (len = 0; len < MAX_LEN; len++) {
+				fill_pattern(dst, BUF_SIZE, 0x80);
+				copy_bytes(ref, dst, BUF_SIZE);
+				copy_bytes(ref + doff, src + soff, len);
+
+				ut_asserteq_ptr(dst + doff,
+						memcpy(dst + doff, src + soff,
+						       len));
+				ut_assertf(!memcmp(dst, ref, BUF_SIZE),
+					   "soff=%d doff=%d len=%d\n",
+					   soff, doff, len);
+			}
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_memcpy, 0);
+
+static int lib_memmove(struct unit_test_state *uts)
+{
+	u8 buf[BUF_SIZE], ref[BUF_SIZE], tmp[BUF_SIZE];
+	int soff, doff, len;
+
+	/* Overlapping moves in both directions, by up to two words */
+	for (soff = MAX_ALIGN; soff < 3 * MAX_ALIGN; soff++) {
+		for (doff = soff - MAX_ALIGN; doff <= soff + MAX_ALIGN;
+		     doff++) {
+			for (len = 0; len < MAX_LEN; len++) {
+				fill_pattern(buf, BUF_SIZE, soff);
+				copy_bytes(ref, buf, BUF_SIZE);
+				copy_bytes(tmp, buf + soff, len);
+				copy_bytes(ref + doff, tmp, len);
+
+				ut_asserteq_ptr(buf + doff,
+						memmove(buf + doff, buf + soff,
+							len));
+				ut_assertf(!memcmp(buf, ref, BUF_SIZE),
+					   "soff=%d doff=%d len=%d\n",
+					   soff, doff, len);
+			}
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_memmove, 0);
+
+/* Run @func on @len bytes for at least 10ms and return the rate in MB/s */
+static ulong mem_speed(int func, u8 *dst, u8 *src, int len)
+{
+	ulong start, elapsed;
+	u64 bytes = 0;
+
+	start = timer_get_us();
+	do {
+		switch (func) {
+		case 0:
+			memcpy(dst, src, len);
+			break;
+		case 1:
+			memmove(dst, src, len);
+			break;
+		default:
+			memset(dst, 0x5a, len);
+			break;
+		}
+		bytes += len;
+		elapsed = timer_get_us() - start;
+	} while (elapsed < 10000);
+
+	return div_u64(bytes, elapsed);
+}
+
+static int lib_mem_speed(struct unit_test_state *uts)
+{
+	static const char * const names[] = { "memcpy", "memmove", "memset" };
+	static const int aligns[][2] = { { 0, 0 }, { 0, 1 }, { 3, 0 } };
+	int max = speed_sizes[ARRAY_SIZE(speed_sizes) - 1];
+	int func, size, align;
+	u8 *src, *dst;
+
+	/* memmove() is measured moving src up by a word, i.e. backwards */
+	src = malloc(max + 2 * MAX_ALIGN);
+	dst = malloc(max + MAX_ALIGN);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	memset(src, 0xa5, max + 2 * MAX_ALIGN);
+
+	printf("%-8s %8s  dst/src  MB/s\n", "", "size");
+	for (func = 0; func < ARRAY_SIZE(names); func++) {
+		for (size = 0; size < ARRAY_SIZE(speed_sizes); size++) {
+			for (align = 0; align < ARRAY_SIZE(aligns); align++) {
+				int doff = aligns[align][0];
+				int soff = aligns[align][1];
+				u8 *to = func == 1 ? src + MAX_ALIGN : dst;
+
+				printf("%-8s %8d  %d/%d  %8lu\n", names[func],
+				       speed_sizes[size], doff, soff,
+				       mem_speed(func, to + doff, src + soff,
+						 speed_sizes[size]));
+			}
+		}
+	}
+
+	free(dst);
+	free(src);
+
+	return 0;
+}
+LIB_TEST(lib_mem_speed, 0);
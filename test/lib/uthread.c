@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the cooperative threads in common/uthread.c
+ */
+
+#include <common.h>
+#include <command.h>
+#include <uthread.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define NUM_STEPS	5
+
+/* Order in which the threads ran, as thread numbers */
+static int test_order[2 * NUM_STEPS];
+static int test_count;
+
+static void test_step(void *arg)
+{
+	int id = (long)arg;
+	int i;
+
+	for (i = 0; i < NUM_STEPS; i++) {
+		test_order[test_count++] = id;
+		uthread_schedule();
+	}
+}
+
+/* Threads take turns each time they yield */
+static int lib_uthread_schedule(struct unit_test_state *uts)
+{
+	struct uthread thr[2];
+	uint grp_id;
+	int i;
+
+	ut_assert(!uthread_schedule());
+
+	test_count = 0;
+	grp_id = uthread_grp_new_id();
+	ut_assert(grp_id != uthread_grp_new_id());
+	ut_assertok(uthread_create(&thr[0], test_step, (void *)1, 0, grp_id));
+	ut_assertok(uthread_create(&thr[1], test_step, (void *)2, 0x4000,
+				   grp_id));
+	ut_assert(!uthread_grp_done(grp_id));
+
+	while (!uthread_grp_done(grp_id))
+		ut_assert(uthread_schedule());
+	ut_asserteq(2 * NUM_STEPS, test_count);
+	for (i = 0; i < test_count; i++)
+		ut_asserteq(i % 2 + 1, test_order[i]);
+
+	/* Finished threads are freed */
+	ut_assertnull(thr[0].stack);
+	ut_assertnull(thr[1].stack);
+	ut_assert(!uthread_schedule());
+
+	return 0;
+}
+LIB_TEST(lib_uthread_schedule, 0);
+
+#define DELAY_US	50000
+#define DELAY_DONE	10
+
+static void test_delay(void *arg)
+{
+	int id = (long)arg;
+
+	test_order[test_count++] = id;
+	udelay(DELAY_US);
+	test_order[test_count++] = id + DELAY_DONE;
+}
+
+/* Delays in different threads overlap */
+static int lib_uthread_delay(struct unit_test_state *uts)
+{
+	struct uthread thr[2];
+	ulong start;
+	uint grp_id;
+
+	test_count = 0;
+	grp_id = uthread_grp_new_id();
+	ut_assertok(uthread_create(&thr[0], test_delay, (void *)1, 0, grp_id));
+	ut_assertok(uthread_create(&thr[1], test_delay, (void *)2, 0, grp_id));
+	while (!uthread_grp_done(grp_id))
+		uthread_schedule();
+
+	/* The second thread started while the first one was waiting */
+	ut_asserteq(4, test_count);
+	ut_asserteq(1, test_order[0]);
+	ut_asserteq(2, test_order[1]);
+	ut_assert(test_order[2] > DELAY_DONE);
+	ut_assert(test_order[3] > DELAY_DONE);
+
+	/* The main thread waits in full when there are no threads */
+	start = timer_get_us();
+	ut_asserteq(DELAY_US, uthread_delay(DELAY_US));
+	ut_assert(timer_get_us() - start >= DELAY_US);
+
+	return 0;
+}
+LIB_TEST(lib_uthread_delay, 0);
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <fdt_support.h>
 #include <malloc.h>
 
 #include <linux/sizes.h>
@@ -22,6 +23,9 @@ extern u32 __dtb_test_fdt_base_begin;
 extern u32 __dtb_test_fdt_overlay_begin;
 extern u32 __dtb_test_fdt_overlay_stacked_begin;
 
+/* The base tree with the overlays applied, for the tests to check */
+static void *fdt;
+
 static int ut_fdt_getprop_u32_by_index(void *fdt, const char *path,
 				    const char *name, int index,
 				    u32 *out)
@@ -66,7 +70,6 @@ static int fdt_getprop_str(void *fdt, const char *path, const char *name,
 
 static int fdt_overlay_change_int_property(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	u32 val = 0;
 
 	ut_assertok(ut_fdt_getprop_u32(fdt, "/test-node", "test-int-property",
@@ -79,7 +82,6 @@ OVERLAY_TEST(fdt_overlay_change_int_property, 0);
 
 static int fdt_overlay_change_str_property(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	const char *val = NULL;
 
 	ut_assertok(fdt_getprop_str(fdt, "/test-node", "test-str-property",
@@ -92,7 +94,6 @@ OVERLAY_TEST(fdt_overlay_change_str_property, 0);
 
 static int fdt_overlay_add_str_property(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	const char *val = NULL;
 
 	ut_assertok(fdt_getprop_str(fdt, "/test-node", "test-str-property-2",
@@ -105,7 +106,6 @@ OVERLAY_TEST(fdt_overlay_add_str_property, 0);
 
 static int fdt_overlay_add_node_by_phandle(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	int off;
 
 	off = fdt_path_offset(fdt, "/test-node/new-node");
@@ -119,7 +119,6 @@ OVERLAY_TEST(fdt_overlay_add_node_by_phandle, 0);
 
 static int fdt_overlay_add_node_by_path(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	int off;
 
 	off = fdt_path_offset(fdt, "/new-node");
@@ -133,7 +132,6 @@ OVERLAY_TEST(fdt_overlay_add_node_by_path, 0);
 
 static int fdt_overlay_add_subnode_property(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	int off;
 
 	off = fdt_path_offset(fdt, "/test-node/sub-test-node");
@@ -149,7 +147,6 @@ OVERLAY_TEST(fdt_overlay_add_subnode_property, 0);
 static int fdt_overlay_local_phandle(struct unit_test_state *uts)
 {
 	uint32_t local_phandle;
-	void *fdt = uts->priv;
 	u32 val = 0;
 	int off;
 
@@ -174,7 +171,6 @@ OVERLAY_TEST(fdt_overlay_local_phandle, 0);
 static int fdt_overlay_local_phandles(struct unit_test_state *uts)
 {
 	uint32_t local_phandle, test_phandle;
-	void *fdt = uts->priv;
 	u32 val = 0;
 	int off;
 
@@ -204,7 +200,6 @@ OVERLAY_TEST(fdt_overlay_local_phandles, 0);
 
 static int fdt_overlay_stacked(struct unit_test_state *uts)
 {
-	void *fdt = uts->priv;
 	u32 val = 0;
 
 	ut_assertok(ut_fdt_getprop_u32(fdt, "/new-local-node",
@@ -215,6 +210,46 @@ static int fdt_overlay_stacked(struct unit_test_state *uts)
 }
 OVERLAY_TEST(fdt_overlay_stacked, 0);
 
+/* Applying the overlays together gives the same tree as one at a time */
+static int fdt_overlay_apply_list_same(struct unit_test_state *uts)
+{
+	void *overlays[] = {
+		&__dtb_test_fdt_overlay_begin,
+		&__dtb_test_fdt_overlay_stacked_begin,
+	};
+	void *copy, *ref;
+	ulong times[2];
+
+	copy = malloc(FDT_COPY_SIZE);
+	ref = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(copy);
+	ut_assertnonnull(ref);
+	ut_assertok(fdt_open_into(&__dtb_test_fdt_base_begin, copy,
+				  FDT_COPY_SIZE));
+	ut_assertok(fdt_overlay_apply_list(copy, overlays, 2, times));
+	ut_assertok(fdt_pack(copy));
+
+	/* The overlays are left as they were */
+	ut_assertok(fdt_check_header(overlays[0]));
+	ut_assertok(fdt_check_header(overlays[1]));
+
+	memcpy(ref, fdt, FDT_COPY_SIZE);
+	ut_assertok(fdt_pack(ref));
+	ut_asserteq(fdt_totalsize(ref), fdt_totalsize(copy));
+	ut_assertok(memcmp(ref, copy, fdt_totalsize(ref)));
+
+	/* References to labels which do not exist are an error */
+	ut_assertok(fdt_create_empty_tree(copy, FDT_COPY_SIZE));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_overlay_apply_list(copy, overlays, 1, NULL));
+
+	free(ref);
+	free(copy);
+
+	return CMD_RET_SUCCESS;
+}
+OVERLAY_TEST(fdt_overlay_apply_list_same, 0);
+
 int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
@@ -237,7 +272,7 @@ int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	fdt_base_copy = malloc(FDT_COPY_SIZE);
 	if (!fdt_base_copy)
 		goto err1;
-	uts->priv = fdt_base_copy;
+	fdt = fdt_base_copy;
 
 	fdt_overlay_copy = malloc(FDT_COPY_SIZE);
 	if (!fdt_overlay_copy)
@@ -0,0 +1,130 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Helpers for testing read-only filesystem images through the generic
+# filesystem commands.
+
+import os
+import u_boot_utils
+import zlib
+
+"""
+A test builds a small directory tree on the host with make_image(), packing it
+with the filesystem's own tool, and then check_image() checks that the files
+read back through ls, size and load match the originals.
+"""
+
+def text(n, seed):
+    """Return n bytes of compressible text, different for each seed."""
+
+    lines = b''.join(b'%d line %06d\n' % (seed, i) for i in range(n // 10))
+    return lines[:n]
+
+def make_tree(path, files):
+    """Create the files packed into a test image.
+
+    Besides the given files, this adds a sub-directory with enough entries
+    for its listing to span several blocks, and some symlinks.
+
+    Args:
+        path: Directory to create them in.
+        files: A dict of file name (relative to path) to contents. This must
+            include 'big.bin', of several blocks, and 'small.txt'.
+
+    Returns:
+        A dict of all file names (relative to path) to contents.
+    """
+
+    files = dict(files)
+    files['sub/deep/leaf.txt'] = b'deep leaf\n'
+    for i in range(300):
+        files['sub/file_%04d_with_a_long_name' % i] = text(50 + i, i)
+
+    for name, data in files.items():
+        fname = os.path.join(path, name)
+        if not os.path.exists(os.path.dirname(fname)):
+            os.makedirs(os.path.dirname(fname))
+        with open(fname, 'wb') as fd:
+            fd.write(data)
+    os.symlink('sub/file_0007_with_a_long_name', os.path.join(path, 'link'))
+    os.symlink('../small.txt', os.path.join(path, 'sub/uplink'))
+    os.symlink('sub/deep', os.path.join(path, 'dirlink'))
+
+    return files
+
+def make_image(u_boot_console, name, files, mkfs):
+    """Pack a test tree into a filesystem image.
+
+    Args:
+        u_boot_console: A U-Boot console.
+        name: Name of the image, used for its file and source directory.
+        files: A dict of file name to contents, as for make_tree().
+        mkfs: Function taking the source directory and image path and
+            returning the command which packs one into the other.
+
+    Returns:
+        The path of the image, and a dict of file name to contents.
+    """
+
+    src = os.path.join(u_boot_console.config.result_dir, name + '_src')
+    img = os.path.join(u_boot_console.config.result_dir, name + '.img')
+    u_boot_utils.run_and_log(u_boot_console, ('rm', '-rf', src, img))
+    os.makedirs(src)
+    files = make_tree(src, files)
+    u_boot_utils.run_and_log(u_boot_console, mkfs(src, img))
+
+    return img, files
+
+def check_crc(u_boot_console, addr, data):
+    output = u_boot_console.run_command('crc32 %x $filesize' % addr)
+    assert '%08x' % (zlib.crc32(data) & 0xffffffff) in output
+
+def check_image(u_boot_console, img, files, block_size, sub_count):
+    """Check that the files in an image read back as they were made.
+
+    Args:
+        u_boot_console: A U-Boot console.
+        img: Path of the image, as returned by make_image().
+        files: A dict of file name to contents, as returned by make_image().
+        block_size: Block size of the image, used to read part of a file
+            starting and ending inside blocks.
+        sub_count: Summary line expected when listing the sub-directory.
+    """
+
+    addr = u_boot_utils.find_ram_base(u_boot_console)
+
+    u_boot_console.run_command('host bind 0 %s' % img)
+    output = u_boot_console.run_command('ls host 0 /')
+    assert 'big.bin' in output
+    assert 'sub/' in output
+    output = u_boot_console.run_command('ls host 0 /sub')
+    assert sub_count in output
+    output = u_boot_console.run_command('ls host 0 /dirlink')
+    assert 'leaf.txt' in output
+
+    names = [name for name in sorted(files) if '/' not in name]
+    names += ['sub/deep/leaf.txt', 'sub/file_0000_with_a_long_name',
+              'sub/file_0299_with_a_long_name']
+    for name in names:
+        data = files[name]
+        u_boot_console.run_command('size host 0 /%s' % name)
+        output = u_boot_console.run_command('printenv filesize')
+        assert output == 'filesize=%x' % len(data)
+
+        u_boot_console.run_command('load host 0 %x /%s' % (addr, name))
+        check_crc(u_boot_console, addr, data)
+
+    # Part of a file, starting and ending inside blocks
+    data = files['big.bin'][block_size + 100:5 * block_size + 200]
+    u_boot_console.run_command('load host 0 %x /big.bin %x %x' %
+                               (addr, len(data), block_size + 100))
+    check_crc(u_boot_console, addr, data)
+
+    # Through symlinks
+    for name, target in [('link', 'sub/file_0007_with_a_long_name'),
+                         ('sub/uplink', 'small.txt'),
+                         ('dirlink/leaf.txt', 'sub/deep/leaf.txt')]:
+        u_boot_console.run_command('load host 0 %x /%s' % (addr, name))
+        check_crc(u_boot_console, addr, files[target])
+
+    output = u_boot_console.run_command('load host 0 %x /missing' % addr)
+    assert 'not found' in output
@@ -0,0 +1,62 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test reading EROFS images through the generic filesystem commands.
+
+import fs_image
+import pytest
+import random
+
+"""
+These tests build a small directory tree on the host, pack it with mkfs.erofs,
+uncompressed and lz4 compressed, and check that the files read back through
+ls, size and load match the originals.
+"""
+
+BLOCK_SIZE = 4096
+
+def make_image(u_boot_console, comp):
+    """Pack the test tree into an EROFS image.
+
+    Args:
+        u_boot_console: A U-Boot console.
+        comp: mkfs.erofs compressor name, or None to leave files uncompressed.
+
+    Returns:
+        The path of the image, and a dict of file name to contents.
+    """
+
+    rnd = random.Random(1)
+    text = fs_image.text
+    files = {
+        # Several clusters, some incompressible, with an odd tail
+        'big.bin': b''.join(bytes(rnd.getrandbits(8) for _ in range(4096)) +
+                            text(3 * BLOCK_SIZE, i) for i in range(20)) +
+                   text(1000, 99),
+        # Whole blocks only, not kept inline
+        'exact.bin': text(4 * BLOCK_SIZE, 1),
+        # Long runs of zeroes compress into long extents
+        'zero.bin': text(BLOCK_SIZE, 2) + bytes(64 * BLOCK_SIZE) +
+                    text(BLOCK_SIZE + 123, 3),
+        'small.txt': b'hello erofs\n',
+    }
+
+    def mkfs(src, img):
+        cmd = ['mkfs.erofs']
+        if comp:
+            cmd.append('-z' + comp)
+        return cmd + [img, src]
+
+    return fs_image.make_image(u_boot_console, 'erofs_%s' % (comp or 'none'),
+                               files, mkfs)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fs_erofs')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.requiredtool('mkfs.erofs')
+@pytest.mark.parametrize('comp', [None, 'lz4', 'lz4hc'])
+def test_erofs(u_boot_console, comp):
+    """Test reading files and directories from an EROFS image."""
+
+    img, files = make_image(u_boot_console, comp)
+    fs_image.check_image(u_boot_console, img, files, BLOCK_SIZE,
+                         '301 file(s), 3 dir(s)')
@@ -0,0 +1,132 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test writing files to an ext4 filesystem with ext4write.
+
+import os
+import pytest
+import random
+import re
+import u_boot_utils
+import zlib
+
+"""
+This test builds an ext4 image on the host whose free space is cut into
+short runs, so that files written by U-Boot need more extents than the inode
+holds and an index level above them. It writes a new file, overwrites it and
+truncates it to zero, reading it back each time, and has e2fsck check the
+filesystem after every step.
+"""
+
+BLOCK_SIZE = 1024
+# Short files, every other one deleted to leave holes in the free space
+FILL_COUNT = 600
+FILL_BLOCKS = 3
+
+def make_image(u_boot_console):
+    """Build an ext4 image with fragmented free space.
+
+    Args:
+        u_boot_console: A U-Boot console.
+
+    Returns:
+        The path of the image.
+    """
+
+    tmpdir = u_boot_console.config.result_dir
+    src = os.path.join(tmpdir, 'ext4_write_src')
+    img = os.path.join(tmpdir, 'ext4_write.img')
+    pad = os.path.join(tmpdir, 'ext4_write_pad')
+    u_boot_utils.run_and_log(u_boot_console, ('rm', '-rf', src, img, pad))
+    os.makedirs(os.path.join(src, 'fill'))
+    for i in range(FILL_COUNT):
+        with open(os.path.join(src, 'fill', '%04d' % i), 'wb') as fd:
+            fd.write(b'%04d' % i * (FILL_BLOCKS * BLOCK_SIZE // 4))
+    # U-Boot does not update metadata checksums when writing
+    u_boot_utils.run_and_log(u_boot_console,
+        ('mkfs.ext4', '-q', '-O', '^metadata_csum', '-b', str(BLOCK_SIZE),
+         '-d', src, img, '8M'))
+
+    # Use up the free space after the short files, then free every other one
+    output = u_boot_utils.run_and_log(u_boot_console,
+                                      ('dumpe2fs', '-h', img))
+    free = int(re.search(r'Free blocks:\s+(\d+)', output).group(1))
+    with open(pad, 'wb') as fd:
+        fd.write(b'\0' * ((free - 20) * BLOCK_SIZE))
+    cmds = ['write %s pad' % pad]
+    cmds += ['rm /fill/%04d' % i for i in range(0, FILL_COUNT, 2)]
+    cmdfile = pad + '.cmds'
+    with open(cmdfile, 'w') as fd:
+        fd.write('\n'.join(cmds) + '\n')
+    u_boot_utils.run_and_log(u_boot_console,
+                             ('debugfs', '-w', '-f', cmdfile, img))
+    fsck(u_boot_console, img)
+
+    return img
+
+def fsck(u_boot_console, img):
+    u_boot_utils.run_and_log(u_boot_console, ('e2fsck', '-fn', img))
+
+def extent_depth(u_boot_console, img, name):
+    """Return the depth of the extent tree of a file."""
+
+    output = u_boot_utils.run_and_log(u_boot_console,
+                                      ('debugfs', '-R', 'ex %s' % name, img))
+    levels = re.findall(r'^\s*(\d+)/\s*(\d+)', output, re.M)
+    assert levels, 'no extents for %s' % name
+
+    return int(levels[0][1])
+
+def write_file(u_boot_console, img, addr, name, data):
+    """Write a file with ext4write, then read it back and check the image."""
+
+    fname = os.path.join(u_boot_console.config.result_dir, 'ext4_write.bin')
+    with open(fname, 'wb') as fd:
+        fd.write(data)
+    if data:
+        u_boot_console.run_command('sb load hostfs - %x %s' % (addr, fname))
+    output = u_boot_console.run_command('ext4write host 0 %x %s %x' %
+                                        (addr, name, len(data)))
+    assert '%d bytes written' % len(data) in output
+
+    u_boot_console.run_command('size host 0 %s' % name)
+    output = u_boot_console.run_command('printenv filesize')
+    assert output == 'filesize=%x' % len(data)
+    if data:
+        u_boot_console.run_command('load host 0 %x %s' % (addr, name))
+        output = u_boot_console.run_command('crc32 %x $filesize' % addr)
+        assert '%08x' % (zlib.crc32(data) & 0xffffffff) in output
+    fsck(u_boot_console, img)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ext4_write')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.requiredtool('mkfs.ext4')
+@pytest.mark.requiredtool('debugfs')
+@pytest.mark.requiredtool('e2fsck')
+def test_ext4_write(u_boot_console):
+    """Test writing, overwriting and truncating a heavily fragmented file."""
+
+    rnd = random.Random(1)
+    def random_bytes(n):
+        return bytes(bytearray(rnd.getrandbits(8) for _ in range(n)))
+
+    img = make_image(u_boot_console)
+    addr = u_boot_utils.find_ram_base(u_boot_console)
+    u_boot_console.run_command('host bind 0 %s' % img)
+
+    # Larger than the inode and one extent block can map in the holes
+    data = random_bytes(400 * BLOCK_SIZE + 123)
+    write_file(u_boot_console, img, addr, '/big.bin', data)
+    assert extent_depth(u_boot_console, img, '/big.bin') >= 1
+
+    # Overwrite with a file of a different size
+    data = random_bytes(250 * BLOCK_SIZE + 45)
+    write_file(u_boot_console, img, addr, '/big.bin', data)
+
+    # Truncate to nothing, releasing all blocks and the index
+    write_file(u_boot_console, img, addr, '/big.bin', b'')
+
+    # The space is reusable afterwards
+    data = random_bytes(400 * BLOCK_SIZE)
+    write_file(u_boot_console, img, addr, '/again.bin', data)
+    assert extent_depth(u_boot_console, img, '/again.bin') >= 1
@@ -0,0 +1,130 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test writing files to FAT filesystems with fatwrite.
+
+import os
+import pytest
+import struct
+import u_boot_utils
+import zlib
+
+"""
+These tests format an image on the host with mkfs.vfat and write to it with
+fatwrite: a new file, an overwrite which extends a file, a file which only
+fits in fragmented free space, and one which fills the volume. Each file is
+read back, and after every write fsck.vfat checks the image and the test
+makes sure that the FAT copies and the FSInfo free cluster count agree.
+"""
+
+# mkfs.vfat arguments and size in KiB, giving clusters of 512 bytes for
+# FAT32 and 2 KiB for FAT16
+FAT_CONFIGS = {
+    'fat16': (['-F', '16', '-s', '4'], 16 * 1024),
+    'fat32': (['-F', '32', '-s', '1'], 36 * 1024),
+}
+
+def read_fat_info(img):
+    """Check the FAT copies and FSInfo sector of a FAT image.
+
+    Args:
+        img: Path of the image.
+
+    Returns:
+        The cluster size and number of free clusters.
+    """
+
+    with open(img, 'rb') as fd:
+        data = fd.read()
+    (sect_size, clust_size, reserved, fats, root_entries, total16, _,
+     fat_length16) = struct.unpack_from('<HBHBHHBH', data, 11)
+    total = total16 or struct.unpack_from('<I', data, 32)[0]
+    fat32 = not fat_length16
+    fat_length = struct.unpack_from('<I', data, 36)[0] if fat32 else \
+        fat_length16
+    first_data = reserved + fats * fat_length + \
+        (root_entries * 32 + sect_size - 1) // sect_size
+    clusters = (total - first_data) // clust_size
+
+    fat_bytes = fat_length * sect_size
+    copies = [data[(reserved + i * fat_length) * sect_size:]
+              [:fat_bytes] for i in range(fats)]
+    for copy in copies[1:]:
+        assert copy == copies[0], 'FAT copies differ'
+    if fat32:
+        entries = struct.unpack_from('<%dI' % (clusters + 2), copies[0])
+        entries = [entry & 0x0fffffff for entry in entries]
+    else:
+        entries = struct.unpack_from('<%dH' % (clusters + 2), copies[0])
+    free = entries[2:].count(0)
+
+    if fat32:
+        info = struct.unpack_from('<H', data, 48)[0] * sect_size
+        assert struct.unpack_from('<I', data, info)[0] == 0x41615252
+        assert struct.unpack_from('<I', data, info + 488)[0] == free
+
+    return sect_size * clust_size, free
+
+def check_image(u_boot_console, img):
+    u_boot_utils.run_and_log(u_boot_console, ('fsck.vfat', '-n', img))
+
+    return read_fat_info(img)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fat')
+@pytest.mark.buildconfigspec('fat_write')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.requiredtool('mkfs.vfat')
+@pytest.mark.requiredtool('fsck.vfat')
+@pytest.mark.parametrize('fat_type', sorted(FAT_CONFIGS))
+def test_fat_write(u_boot_console, fat_type):
+    """Test writing files and filling up a FAT filesystem."""
+
+    tmpdir = u_boot_console.config.result_dir
+    img = os.path.join(tmpdir, 'fat_write_%s.img' % fat_type)
+    fname = os.path.join(tmpdir, 'fat_write.bin')
+    args, size = FAT_CONFIGS[fat_type]
+    u_boot_utils.run_and_log(u_boot_console, ['rm', '-f', img])
+    u_boot_utils.run_and_log(u_boot_console,
+                             ['mkfs.vfat'] + args + ['-C', img, str(size)])
+    clust, free = check_image(u_boot_console, img)
+    addr = u_boot_utils.find_ram_base(u_boot_console)
+    u_boot_console.run_command('host bind 0 %s' % img)
+
+    def write(name, length):
+        data = os.urandom(length)
+        with open(fname, 'wb') as fd:
+            fd.write(data)
+        u_boot_console.run_command('sb load hostfs - %x %s' % (addr, fname))
+        output = u_boot_console.run_command('fatwrite host 0:0 %x %s %x' %
+                                            (addr, name, length))
+        assert '%d bytes written' % length in output
+
+        u_boot_console.run_command('load host 0:0 %x %s' % (addr, name))
+        output = u_boot_console.run_command('crc32 %x $filesize' % addr)
+        assert '%08x' % (zlib.crc32(data) & 0xffffffff) in output
+
+        return check_image(u_boot_console, img)[1]
+
+    # A new file, then overwritten with a longer one
+    free = write('new.bin', 10 * clust + 100)
+    free = write('new.bin', 30 * clust + 200)
+
+    # Short files, then a file taking all but a few clusters after them
+    for i in range(40):
+        free = write('fill%02d.bin' % i, 3 * clust)
+    free = write('pad.bin', (free - 4) * clust)
+    # Shrinking every other short file leaves holes of two clusters
+    for i in range(0, 40, 2):
+        free = write('fill%02d.bin' % i, clust)
+    assert free == 4 + 20 * 2
+
+    # A file which only fits in the holes
+    free = write('frag.bin', 30 * clust + 1)
+
+    # One filling the volume exactly, then one which does not fit
+    free = write('full.bin', free * clust)
+    assert free == 0
+    output = u_boot_console.run_command('fatwrite host 0:0 %x over.bin %x' %
+                                        (addr, clust))
+    assert 'overflow' in output
+    assert check_image(u_boot_console, img)[1] == 0
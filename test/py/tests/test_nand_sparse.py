@@ -0,0 +1,205 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test tools/mkubiimage and the "nand write.sparse" command.
+
+import os
+import pytest
+import random
+import struct
+import test_net
+import u_boot_utils
+import zlib
+
+"""
+test_mkubiimage runs on sandbox and checks the images built by mkubiimage on
+the host.
+
+test_nand_write_sparse needs a board with NAND and a network connection. It
+relies on boardenv_* containing the area of NAND it may erase and a sparse
+image built by mkubiimage on the TFTP server, for example:
+
+env__nand_sparse_config = {
+    # Area of NAND to erase and program
+    'offset': 0x400000,
+    'size': 0x800000,
+    # Sparse image, e.g. from mkubiimage -p 128KiB -m 2048 -v ... ubi.simg
+    'fn': 'ubi.simg',
+    # Length and CRC32 of the plain image, from mkubiimage -r with the
+    # same arguments
+    'len': 0x80000,
+    'crc32': 'c2244b26',
+}
+"""
+
+PEB_SIZE = 128 * 1024
+PAGE_SIZE = 2048
+
+SPARSE_MAGIC = 0xed26ff3a
+CHUNK_RAW = 0xcac1
+CHUNK_DONT_CARE = 0xcac3
+
+UBI_EC_MAGIC = 0x55424923
+UBI_VID_MAGIC = 0x55424921
+UBI_LAYOUT_VOLUME_ID = 0x7fffefff
+UBI_VID_DYNAMIC = 1
+UBI_VID_STATIC = 2
+
+def ubi_crc32(data):
+    """UBI checksums are CRC32 without the final inversion."""
+
+    return zlib.crc32(data) & 0xffffffff ^ 0xffffffff
+
+def unsparse(data):
+    """Expand an Android sparse image, with 0xff in "don't care" chunks.
+
+    Args:
+        data: Contents of the sparse image.
+
+    Returns:
+        The expanded image, and the number of blocks in raw chunks.
+    """
+
+    (magic, major, minor, hdr_sz, chunk_hdr_sz, blk_sz, total_blks,
+     total_chunks, _) = struct.unpack_from('<IHHHHIIII', data)
+    assert magic == SPARSE_MAGIC
+    assert blk_sz == PAGE_SIZE
+
+    out = bytearray()
+    raw_blks = 0
+    pos = hdr_sz
+    for _ in range(total_chunks):
+        ctype, _, blks, total_sz = struct.unpack_from('<HHII', data, pos)
+        pos += chunk_hdr_sz
+        if ctype == CHUNK_RAW:
+            assert total_sz == chunk_hdr_sz + blks * blk_sz
+            for i in range(blks):
+                page = data[pos + i * blk_sz:pos + (i + 1) * blk_sz]
+                assert page != b'\xff' * blk_sz, 'erased page not skipped'
+            out += data[pos:pos + blks * blk_sz]
+            pos += blks * blk_sz
+            raw_blks += blks
+        else:
+            assert ctype == CHUNK_DONT_CARE
+            assert total_sz == chunk_hdr_sz
+            out += b'\xff' * (blks * blk_sz)
+    assert pos == len(data)
+    assert len(out) == total_blks * blk_sz
+
+    return bytes(out), raw_blks
+
+def check_peb(peb, vol_id, lnum):
+    """Check the EC and VID headers of a PEB and return its data."""
+
+    magic, version, ec, vid_hdr_offs, data_offs = struct.unpack_from(
+        '>IB3xQII', peb)
+    assert magic == UBI_EC_MAGIC
+    assert struct.unpack_from('>I', peb, 60)[0] == ubi_crc32(peb[:60])
+
+    vid = peb[vid_hdr_offs:vid_hdr_offs + 64]
+    (magic, version, vol_type, _, _, vid_vol_id, vid_lnum, data_size,
+     used_ebs, _, data_crc) = struct.unpack_from('>IBBBBII4xIIII', vid)
+    assert magic == UBI_VID_MAGIC
+    assert struct.unpack_from('>I', vid, 60)[0] == ubi_crc32(vid[:60])
+    assert (vid_vol_id, vid_lnum) == (vol_id, lnum)
+
+    return peb[data_offs:], vol_type, data_size, data_crc
+
+def run_mkubiimage(u_boot_console, args, fname):
+    mkubiimage = u_boot_console.config.build_dir + '/tools/mkubiimage'
+    u_boot_utils.run_and_log(u_boot_console, [mkubiimage, '-p', str(PEB_SIZE),
+                                              '-m', str(PAGE_SIZE)] + args +
+                             [fname])
+    with open(fname, 'rb') as fd:
+        return fd.read()
+
+@pytest.mark.boardspec('sandbox')
+def test_mkubiimage(u_boot_console):
+    """Test that mkubiimage lays out the volumes and skips erased pages."""
+
+    rnd = random.Random(1)
+    tmpdir = u_boot_console.config.result_dir
+    # A dynamic volume with erased pages in the middle of its data, and a
+    # static one ending inside an eraseblock
+    def random_bytes(n):
+        return bytes(bytearray(rnd.getrandbits(8) for _ in range(n)))
+    vols = [
+        ('rootfs', UBI_VID_DYNAMIC,
+         random_bytes(150000) + b'\xff' * 100000 + random_bytes(50000)),
+        ('kernel', UBI_VID_STATIC, random_bytes(100000)),
+    ]
+    args = []
+    for name, vol_type, data in vols:
+        fname = os.path.join(tmpdir, 'ubi_%s.bin' % name)
+        with open(fname, 'wb') as fd:
+            fd.write(data)
+        args += ['-v', 'name=%s,image=%s,type=%s' %
+                 (name, fname, 'static' if vol_type == UBI_VID_STATIC
+                  else 'dynamic')]
+
+    plain = run_mkubiimage(u_boot_console, args + ['-r'],
+                           os.path.join(tmpdir, 'ubi.img'))
+    sparse = run_mkubiimage(u_boot_console, args,
+                            os.path.join(tmpdir, 'ubi.simg'))
+    expanded, raw_blks = unsparse(sparse)
+    assert expanded == plain
+    assert raw_blks < len(plain) // PAGE_SIZE // 2
+
+    # Layout volume, twice, then the volumes in order
+    pebs = [plain[i:i + PEB_SIZE] for i in range(0, len(plain), PEB_SIZE)]
+    assert len(plain) == len(pebs) * PEB_SIZE
+    for lnum in range(2):
+        vtbl, _, _, _ = check_peb(pebs[lnum], UBI_LAYOUT_VOLUME_ID, lnum)
+        leb_size = len(vtbl)
+        for vol_id, (name, vol_type, data) in enumerate(vols):
+            rec = vtbl[vol_id * 172:(vol_id + 1) * 172]
+            assert struct.unpack_from('>I', rec, 168)[0] == \
+                ubi_crc32(rec[:168])
+            reserved, _, _, rec_type, _, name_len = struct.unpack_from(
+                '>IIIBBH', rec)
+            assert reserved == (len(data) + leb_size - 1) // leb_size
+            assert rec_type == vol_type
+            assert rec[16:16 + name_len] == name.encode()
+
+    peb = 2
+    for vol_id, (name, vol_type, data) in enumerate(vols):
+        for lnum in range(0, (len(data) + leb_size - 1) // leb_size):
+            chunk = data[lnum * leb_size:(lnum + 1) * leb_size]
+            leb, _, data_size, data_crc = check_peb(pebs[peb], vol_id, lnum)
+            assert leb[:len(chunk)] == chunk
+            assert leb[len(chunk):] == b'\xff' * (leb_size - len(chunk))
+            if vol_type == UBI_VID_STATIC:
+                assert data_size == len(chunk)
+                assert data_crc == ubi_crc32(chunk)
+            peb += 1
+    assert peb == len(pebs)
+
+@pytest.mark.buildconfigspec('cmd_nand_sparse')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.buildconfigspec('cmd_net')
+def test_nand_write_sparse(u_boot_console):
+    """Test programming a sparse UBI image with "nand write.sparse"."""
+
+    f = u_boot_console.config.env.get('env__nand_sparse_config', None)
+    if not f:
+        pytest.skip('No NAND area to test')
+
+    test_net.test_net_dhcp(u_boot_console)
+    test_net.test_net_setup_static(u_boot_console)
+
+    addr = u_boot_utils.find_ram_base(u_boot_console)
+    output = u_boot_console.run_command('tftpboot %x %s' % (addr, f['fn']))
+    assert 'Bytes transferred = ' in output
+
+    output = u_boot_console.run_command('nand erase %x %x' %
+                                        (f['offset'], f['size']))
+    assert 'OK' in output
+    output = u_boot_console.run_command('nand write.sparse %x %x' %
+                                        (addr, f['offset']))
+    assert 'OK' in output
+
+    # Pages left out of the image must read back erased
+    output = u_boot_console.run_command('nand read %x %x %x' %
+                                        (addr, f['offset'], f['len']))
+    assert 'OK' in output
+    output = u_boot_console.run_command('crc32 %x %x' % (addr, f['len']))
+    assert f['crc32'] in output
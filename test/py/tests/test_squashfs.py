@@ -0,0 +1,61 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test reading SquashFS images through the generic filesystem commands.
+
+import fs_image
+import pytest
+import random
+
+"""
+These tests build a small directory tree on the host, pack it with mksquashfs
+using each compressor U-Boot can read, and check that the files read back
+through ls, size and load match the originals.
+"""
+
+BLOCK_SIZE = 16384
+
+def make_image(u_boot_console, comp):
+    """Pack the test tree into a SquashFS image, once per compressor.
+
+    Args:
+        u_boot_console: A U-Boot console.
+        comp: mksquashfs compressor name.
+
+    Returns:
+        The path of the image, and a dict of file name to contents.
+    """
+
+    rnd = random.Random(1)
+    text = fs_image.text
+    files = {
+        # Several blocks, some incompressible, with a tail in a fragment
+        'big.bin': b''.join(bytes(rnd.getrandbits(8) for _ in range(4096)) +
+                            text(BLOCK_SIZE - 4096, i) for i in range(20)) +
+                   text(1000, 99),
+        # Whole blocks only
+        'exact.bin': text(4 * BLOCK_SIZE, 1),
+        # Zero blocks are stored as sparse
+        'sparse.bin': text(BLOCK_SIZE, 2) + bytes(3 * BLOCK_SIZE) +
+                      text(BLOCK_SIZE + 123, 3),
+        'small.txt': b'hello squashfs\n',
+    }
+
+    return fs_image.make_image(u_boot_console, 'squashfs_%s' % comp, files,
+        lambda src, img: ('mksquashfs', src, img, '-noappend', '-all-root',
+                          '-no-xattrs', '-b', str(BLOCK_SIZE), '-comp', comp))
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.requiredtool('mksquashfs')
+@pytest.mark.parametrize('comp', ['gzip', 'lzo', 'lz4'])
+def test_squashfs(u_boot_console, comp):
+    """Test reading files and directories from a SquashFS image."""
+
+    config = {'lzo': 'config_lzo', 'lz4': 'config_lz4'}.get(comp)
+    if config and u_boot_console.config.buildconfig.get(config, 'n') != 'y':
+        pytest.skip('%s decompression is not enabled' % comp)
+
+    img, files = make_image(u_boot_console, comp)
+    fs_image.check_image(u_boot_console, img, files, BLOCK_SIZE,
+                         '301 file(s), 1 dir(s)')
@@ -0,0 +1,611 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Build a UBI image ready to be programmed into a NAND partition
+ *
+ * The image is laid out the same way as ubinize does it: the layout volume
+ * occupies the first two physical eraseblocks, followed by the eraseblocks
+ * of each volume in the order given on the command line. By default the
+ * result is written as an Android sparse image with the NAND page as block
+ * size, in which every page containing only 0xff is a "don't care" chunk.
+ * "nand write.sparse" then programs only the pages holding data, and the
+ * free space of UBIFS volumes stays erased as UBIFS expects.
+ *
+ * ECC is not part of the image: it is generated by the NAND controller
+ * when the image is written through the regular (non-raw) write path.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "compiler.h"
+#include <u-boot/crc.h>
+#include <sparse_format.h>
+#include <version.h>
+
+#define __packed	__attribute__((packed))
+#include "../drivers/mtd/ubi/ubi-media.h"
+
+struct volume {
+	const char *name;
+	const char *image;
+	int id;
+	int type;
+	int autoresize;
+	uint64_t size;
+
+	uint8_t *data;
+	size_t len;
+	int used_ebs;
+	int reserved_pebs;
+};
+
+struct ubi_params {
+	int peb_size;
+	int page_size;
+	int subpage_size;
+	int vid_hdr_offs;
+	int data_offs;
+	int leb_size;
+	uint64_t ec;
+	uint32_t image_seq;
+	uint64_t sqnum;
+	uint8_t *peb;
+};
+
+struct sparse_out {
+	FILE *f;
+	int raw;
+	uint32_t blk_sz;
+	uint32_t total_blks;
+	uint32_t total_chunks;
+	uint16_t chunk_type;
+	uint32_t chunk_blks;
+	long chunk_pos;
+};
+
+static void usage(const char *exec_name)
+{
+	fprintf(stderr, "%s [-h] [-r] -p <PEB size> -m <page size> [-s <sub-page size>] [-O <VID header offset>] [-e <erase counter>] [-Q <image sequence>] -v <volume> [-v <volume> ...] <output>\n"
+	       "\n"
+	       "This tool builds a UBI image for a NAND partition and writes it as an Android sparse image in which all-0xff pages are skipped, ready for 'nand write.sparse'.\n"
+	       "\n"
+	       "\tA volume is described by comma separated properties:\n"
+	       "\t\tname=<name>       volume name (required)\n"
+	       "\t\timage=<file>      volume contents\n"
+	       "\t\tid=<id>           volume id (default: next free id)\n"
+	       "\t\ttype=dynamic|static (default: dynamic)\n"
+	       "\t\tsize=<bytes>      volume size (default: size of the image)\n"
+	       "\t\tautoresize        grow the volume to fill the device on attach\n"
+	       "\t-r : write a plain image padded with 0xff instead of a sparse image\n"
+	       "\t-V : print version information and exit\n"
+	       "\n"
+	       "Sizes accept a KiB, MiB or GiB suffix.\n",
+	       exec_name);
+}
+
+static uint64_t parse_size(const char *s)
+{
+	unsigned long long val;
+	char *end;
+
+	errno = 0;
+	val = strtoull(s, &end, 0);
+	if (errno || end == s)
+		goto err;
+
+	if (!strcmp(end, "KiB"))
+		val <<= 10;
+	else if (!strcmp(end, "MiB"))
+		val <<= 20;
+	else if (!strcmp(end, "GiB"))
+		val <<= 30;
+	else if (*end)
+		goto err;
+
+	return val;
+
+err:
+	fprintf(stderr, "Bad size: %s\n", s);
+	exit(EXIT_FAILURE);
+}
+
+static int parse_volume(struct volume *vol, char *desc)
+{
+	char *prop, *val;
+
+	memset(vol, 0, sizeof(*vol));
+	vol->id = -1;
+	vol->type = UBI_VID_DYNAMIC;
+
+	while ((prop = strsep(&desc, ","))) {
+		val = strchr(prop, '=');
+		if (val)
+			*val++ = '\0';
+
+		if (!strcmp(prop, "autoresize") && !val) {
+			vol->autoresize = 1;
+		} else if (!val) {
+			break;
+		} else if (!strcmp(prop, "name")) {
+			vol->name = val;
+		} else if (!strcmp(prop, "image")) {
+			vol->image = val;
+		} else if (!strcmp(prop, "id")) {
+			vol->id = parse_size(val);
+		} else if (!strcmp(prop, "size")) {
+			vol->size = parse_size(val);
+		} else if (!strcmp(prop, "type")) {
+			if (!strcmp(val, "dynamic"))
+				vol->type = UBI_VID_DYNAMIC;
+			else if (!strcmp(val, "static"))
+				vol->type = UBI_VID_STATIC;
+			else
+				break;
+		} else {
+			break;
+		}
+	}
+
+	if (prop) {
+		fprintf(stderr, "Bad volume property '%s'\n", prop);
+		return -1;
+	}
+
+	if (!vol->name || strlen(vol->name) > UBI_VOL_NAME_MAX) {
+		fprintf(stderr, "Missing or too long volume name\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int load_volume(struct volume *vol, int leb_size)
+{
+	struct stat st;
+	int fd;
+
+	if (vol->image) {
+		fd = open(vol->image, O_RDONLY);
+		if (fd < 0 || fstat(fd, &st)) {
+			fprintf(stderr, "Can't open %s: %s\n", vol->image,
+				strerror(errno));
+			return -1;
+		}
+
+		vol->len = st.st_size;
+		vol->data = malloc(vol->len + 1);
+		if (!vol->data ||
+		    read(fd, vol->data, vol->len) != (ssize_t)vol->len) {
+			fprintf(stderr, "Can't read %s\n", vol->image);
+			close(fd);
+			return -1;
+		}
+		close(fd);
+	}
+
+	if (!vol->size)
+		vol->size = vol->len;
+	if (vol->len > vol->size) {
+		fprintf(stderr, "Image of volume '%s' exceeds its size\n",
+			vol->name);
+		return -1;
+	}
+
+	vol->used_ebs = (vol->len + leb_size - 1) / leb_size;
+	vol->reserved_pebs = (vol->size + leb_size - 1) / leb_size;
+	if (!vol->reserved_pebs) {
+		fprintf(stderr, "Volume '%s' has no size\n", vol->name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int is_erased(const uint8_t *buf, size_t len)
+{
+	while (len--)
+		if (*buf++ != 0xff)
+			return 0;
+
+	return 1;
+}
+
+static int sparse_close_chunk(struct sparse_out *out)
+{
+	chunk_header_t chunk;
+	uint32_t total_sz = sizeof(chunk);
+	long end;
+
+	if (!out->chunk_type)
+		return 0;
+
+	if (out->chunk_type == CHUNK_TYPE_RAW)
+		total_sz += out->chunk_blks * out->blk_sz;
+
+	chunk.chunk_type = cpu_to_le16(out->chunk_type);
+	chunk.reserved1 = 0;
+	chunk.chunk_sz = cpu_to_le32(out->chunk_blks);
+	chunk.total_sz = cpu_to_le32(total_sz);
+
+	end = ftell(out->f);
+	if (fseek(out->f, out->chunk_pos, SEEK_SET) ||
+	    fwrite(&chunk, sizeof(chunk), 1, out->f) != 1 ||
+	    fseek(out->f, end, SEEK_SET))
+		return -1;
+
+	out->total_chunks++;
+	out->chunk_type = 0;
+
+	return 0;
+}
+
+static int sparse_write_page(struct sparse_out *out, const uint8_t *page)
+{
+	uint16_t type;
+	chunk_header_t chunk;
+
+	if (out->raw)
+		return fwrite(page, out->blk_sz, 1, out->f) == 1 ? 0 : -1;
+
+	type = is_erased(page, out->blk_sz) ? CHUNK_TYPE_DONT_CARE :
+					      CHUNK_TYPE_RAW;
+	if (type != out->chunk_type) {
+		if (sparse_close_chunk(out))
+			return -1;
+
+		/* Reserve room for the header, filled in on close */
+		memset(&chunk, 0, sizeof(chunk));
+		out->chunk_pos = ftell(out->f);
+		if (fwrite(&chunk, sizeof(chunk), 1, out->f) != 1)
+			return -1;
+		out->chunk_type = type;
+		out->chunk_blks = 0;
+	}
+
+	if (type == CHUNK_TYPE_RAW &&
+	    fwrite(page, out->blk_sz, 1, out->f) != 1)
+		return -1;
+
+	out->chunk_blks++;
+	out->total_blks++;
+
+	return 0;
+}
+
+static int sparse_start(struct sparse_out *out)
+{
+	sparse_header_t hdr;
+
+	if (out->raw)
+		return 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+
+	return fwrite(&hdr, sizeof(hdr), 1, out->f) == 1 ? 0 : -1;
+}
+
+static int sparse_finish(struct sparse_out *out)
+{
+	sparse_header_t hdr;
+
+	if (out->raw)
+		return 0;
+
+	if (sparse_close_chunk(out))
+		return -1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	hdr.major_version = cpu_to_le16(1);
+	hdr.minor_version = cpu_to_le16(0);
+	hdr.file_hdr_sz = cpu_to_le16(sizeof(sparse_header_t));
+	hdr.chunk_hdr_sz = cpu_to_le16(sizeof(chunk_header_t));
+	hdr.blk_sz = cpu_to_le32(out->blk_sz);
+	hdr.total_blks = cpu_to_le32(out->total_blks);
+	hdr.total_chunks = cpu_to_le32(out->total_chunks);
+
+	if (fseek(out->f, 0, SEEK_SET) ||
+	    fwrite(&hdr, sizeof(hdr), 1, out->f) != 1)
+		return -1;
+
+	return 0;
+}
+
+static uint32_t ubi_crc32(const void *buf, size_t len)
+{
+	return crc32_no_comp(UBI_CRC32_INIT, buf, len);
+}
+
+/*
+ * Fill in the headers of the current PEB buffer and emit it page by page.
+ * The data of the LEB must already be in place at the data offset.
+ */
+static int write_peb(struct ubi_params *p, struct sparse_out *out,
+		     struct ubi_vid_hdr *vid)
+{
+	struct ubi_ec_hdr *ec = (struct ubi_ec_hdr *)p->peb;
+	int i;
+
+	memset(ec, 0, UBI_EC_HDR_SIZE);
+	ec->magic = cpu_to_be32(UBI_EC_HDR_MAGIC);
+	ec->version = UBI_VERSION;
+	ec->ec = cpu_to_be64(p->ec);
+	ec->vid_hdr_offset = cpu_to_be32(p->vid_hdr_offs);
+	ec->data_offset = cpu_to_be32(p->data_offs);
+	ec->image_seq = cpu_to_be32(p->image_seq);
+	ec->hdr_crc = cpu_to_be32(ubi_crc32(ec, UBI_EC_HDR_SIZE_CRC));
+
+	vid->magic = cpu_to_be32(UBI_VID_HDR_MAGIC);
+	vid->version = UBI_VERSION;
+	vid->sqnum = cpu_to_be64(p->sqnum);
+	p->sqnum++;
+	vid->hdr_crc = cpu_to_be32(ubi_crc32(vid, UBI_VID_HDR_SIZE_CRC));
+	memcpy(p->peb + p->vid_hdr_offs, vid, UBI_VID_HDR_SIZE);
+
+	for (i = 0; i < p->peb_size; i += p->page_size)
+		if (sparse_write_page(out, p->peb + i))
+			return -1;
+
+	return 0;
+}
+
+static int write_layout_volume(struct ubi_params *p, struct sparse_out *out,
+			       struct volume *vols, int nvols)
+{
+	struct ubi_vtbl_record *vtbl;
+	struct ubi_vid_hdr vid;
+	int vtbl_slots, i, lnum;
+
+	vtbl_slots = p->leb_size / UBI_VTBL_RECORD_SIZE;
+	if (vtbl_slots > UBI_MAX_VOLUMES)
+		vtbl_slots = UBI_MAX_VOLUMES;
+
+	vtbl = calloc(vtbl_slots, UBI_VTBL_RECORD_SIZE);
+	if (!vtbl)
+		return -1;
+
+	for (i = 0; i < nvols; i++) {
+		struct ubi_vtbl_record *rec;
+
+		if (vols[i].id >= vtbl_slots) {
+			fprintf(stderr, "Volume id %d out of range\n",
+				vols[i].id);
+			free(vtbl);
+			return -1;
+		}
+
+		rec = &vtbl[vols[i].id];
+		rec->reserved_pebs = cpu_to_be32(vols[i].reserved_pebs);
+		rec->alignment = cpu_to_be32(1);
+		rec->vol_type = vols[i].type;
+		rec->name_len = cpu_to_be16(strlen(vols[i].name));
+		strcpy((char *)rec->name, vols[i].name);
+		if (vols[i].autoresize)
+			rec->flags = UBI_VTBL_AUTORESIZE_FLG;
+	}
+
+	for (i = 0; i < vtbl_slots; i++)
+		vtbl[i].crc = cpu_to_be32(ubi_crc32(&vtbl[i],
+						    UBI_VTBL_RECORD_SIZE_CRC));
+
+	for (lnum = 0; lnum < UBI_LAYOUT_VOLUME_EBS; lnum++) {
+		memset(p->peb, 0xff, p->peb_size);
+		memcpy(p->peb + p->data_offs, vtbl,
+		       vtbl_slots * UBI_VTBL_RECORD_SIZE);
+
+		memset(&vid, 0, sizeof(vid));
+		vid.vol_type = UBI_LAYOUT_VOLUME_TYPE;
+		vid.compat = UBI_LAYOUT_VOLUME_COMPAT;
+		vid.vol_id = cpu_to_be32(UBI_LAYOUT_VOLUME_ID);
+		vid.lnum = cpu_to_be32(lnum);
+
+		if (write_peb(p, out, &vid)) {
+			free(vtbl);
+			return -1;
+		}
+	}
+
+	free(vtbl);
+
+	return 0;
+}
+
+static int write_volume(struct ubi_params *p, struct sparse_out *out,
+			struct volume *vol)
+{
+	struct ubi_vid_hdr vid;
+	size_t off, len;
+	int lnum;
+
+	for (lnum = 0; lnum < vol->used_ebs; lnum++) {
+		off = (size_t)lnum * p->leb_size;
+		len = vol->len - off;
+		if (len > p->leb_size)
+			len = p->leb_size;
+
+		memset(p->peb, 0xff, p->peb_size);
+		memcpy(p->peb + p->data_offs, vol->data + off, len);
+
+		memset(&vid, 0, sizeof(vid));
+		vid.vol_type = vol->type;
+		vid.vol_id = cpu_to_be32(vol->id);
+		vid.lnum = cpu_to_be32(lnum);
+		if (vol->type == UBI_VID_STATIC) {
+			vid.data_size = cpu_to_be32(len);
+			vid.used_ebs = cpu_to_be32(vol->used_ebs);
+			vid.data_crc = cpu_to_be32(ubi_crc32(vol->data + off,
+							     len));
+		}
+
+		if (write_peb(p, out, &vid))
+			return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct ubi_params p;
+	struct sparse_out out;
+	struct volume *vols = NULL;
+	const char *out_filename;
+	int nvols = 0, autoresize = 0;
+	int option, i, j;
+	const char *prg;
+
+	prg = basename(argv[0]);
+
+	memset(&p, 0, sizeof(p));
+	memset(&out, 0, sizeof(out));
+
+	/* Turn off getopt()'s internal error message */
+	opterr = 0;
+
+	while ((option = getopt(argc, argv, ":p:m:s:O:e:Q:v:rhV")) != -1) {
+		switch (option) {
+		case 'p':
+			p.peb_size = parse_size(optarg);
+			break;
+		case 'm':
+			p.page_size = parse_size(optarg);
+			break;
+		case 's':
+			p.subpage_size = parse_size(optarg);
+			break;
+		case 'O':
+			p.vid_hdr_offs = parse_size(optarg);
+			break;
+		case 'e':
+			p.ec = parse_size(optarg);
+			break;
+		case 'Q':
+			p.image_seq = parse_size(optarg);
+			break;
+		case 'v':
+			vols = realloc(vols, (nvols + 1) * sizeof(*vols));
+			if (!vols || parse_volume(&vols[nvols], optarg))
+				return EXIT_FAILURE;
+			nvols++;
+			break;
+		case 'r':
+			out.raw = 1;
+			break;
+		case 'h':
+			usage(prg);
+			return EXIT_SUCCESS;
+		case 'V':
+			printf("%s version %s\n", prg, PLAIN_VERSION);
+			return EXIT_SUCCESS;
+		case ':':
+			fprintf(stderr, "Missing argument for option -%c\n",
+				optopt);
+			usage(prg);
+			return EXIT_FAILURE;
+		default:
+			fprintf(stderr, "Wrong option -%c\n", optopt);
+			usage(prg);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1 || !p.peb_size || !p.page_size || !nvols) {
+		usage(prg);
+		return EXIT_FAILURE;
+	}
+	out_filename = argv[optind];
+
+	if (!p.subpage_size)
+		p.subpage_size = p.page_size;
+	if (!p.vid_hdr_offs)
+		p.vid_hdr_offs = (UBI_EC_HDR_SIZE + p.subpage_size - 1) /
+				 p.subpage_size * p.subpage_size;
+	p.data_offs = (p.vid_hdr_offs + UBI_VID_HDR_SIZE + p.page_size - 1) /
+		      p.page_size * p.page_size;
+	p.leb_size = p.peb_size - p.data_offs;
+
+	if (p.peb_size % p.page_size || p.page_size % p.subpage_size ||
+	    p.vid_hdr_offs % 8 || p.vid_hdr_offs < UBI_EC_HDR_SIZE ||
+	    p.leb_size <= 0) {
+		fprintf(stderr, "Inconsistent flash geometry\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Give volumes without an id the lowest free one */
+	for (i = 0; i < nvols; i++) {
+		if (vols[i].id >= 0)
+			continue;
+		vols[i].id = 0;
+		for (j = 0; j < nvols; j++) {
+			if (j != i && vols[j].id == vols[i].id) {
+				vols[i].id++;
+				j = -1;
+			}
+		}
+	}
+
+	for (i = 0; i < nvols; i++) {
+		if (vols[i].id >= UBI_MAX_VOLUMES) {
+			fprintf(stderr, "Volume id %d out of range\n",
+				vols[i].id);
+			return EXIT_FAILURE;
+		}
+		for (j = 0; j < i; j++) {
+			if (vols[j].id == vols[i].id ||
+			    !strcmp(vols[j].name, vols[i].name)) {
+				fprintf(stderr, "Duplicate volume '%s'\n",
+					vols[i].name);
+				return EXIT_FAILURE;
+			}
+		}
+		if (vols[i].autoresize && autoresize++) {
+			fprintf(stderr, "Only one volume can be autoresized\n");
+			return EXIT_FAILURE;
+		}
+		if (load_volume(&vols[i], p.leb_size))
+			return EXIT_FAILURE;
+	}
+
+	p.peb = malloc(p.peb_size);
+	if (!p.peb)
+		return EXIT_FAILURE;
+
+	out.blk_sz = p.page_size;
+	out.f = fopen(out_filename, "wb");
+	if (!out.f) {
+		fprintf(stderr, "Can't open %s: %s\n", out_filename,
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (sparse_start(&out) ||
+	    write_layout_volume(&p, &out, vols, nvols))
+		goto err;
+
+	for (i = 0; i < nvols; i++)
+		if (write_volume(&p, &out, &vols[i]))
+			goto err;
+
+	if (sparse_finish(&out) || fclose(out.f)) {
+		out.f = NULL;
+		goto err;
+	}
+
+	return EXIT_SUCCESS;
+
+err:
+	fprintf(stderr, "Can't write %s: %s\n", out_filename, strerror(errno));
+	if (out.f)
+		fclose(out.f);
+	unlink(out_filename);
+
+	return EXIT_FAILURE;
+}